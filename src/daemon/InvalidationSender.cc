@@ -18,9 +18,13 @@
  */
 
 #include"InvalidationSender.hh"
+#include<mediascanner/MediaChange.hh>
+#include<mediascanner/MediaStore.hh>
+#include<algorithm>
 #include<string>
 #include<cstdlib>
 #include<cstdio>
+#include<stdexcept>
 #include <glib.h>
 #include <gio/gio.h>
 
@@ -30,6 +34,9 @@ using namespace std;
 static const char SCOPES_DBUS_IFACE[] = "com.canonical.unity.scopes";
 static const char SCOPES_DBUS_PATH[] = "/com/canonical/unity/scopes";
 static const char SCOPES_INVALIDATE_RESULTS[] = "InvalidateResults";
+static const char MEDIASCANNER_DBUS_IFACE[] = "com.canonical.MediaScanner2";
+static const char MEDIASCANNER_DBUS_PATH[] = "/com/canonical/MediaScanner2";
+static const char MEDIASCANNER_MEDIA_CHANGED[] = "MediaChanged";
 
 namespace mediascanner {
 
@@ -51,6 +58,22 @@ void InvalidationSender::setDelay(int delay) {
     this->delay = delay;
 }
 
+void InvalidationSender::setMinInterval(int interval) {
+    this->min_interval = interval;
+}
+
+int InvalidationSender::getMinInterval() const {
+    return min_interval;
+}
+
+void InvalidationSender::setBeforeSend(std::function<void()> before_send) {
+    this->before_send = before_send;
+}
+
+void InvalidationSender::setStore(const MediaStore *store) {
+    this->store = store;
+}
+
 void InvalidationSender::invalidate() {
     if (!bus) {
         return;
@@ -58,18 +81,62 @@ void InvalidationSender::invalidate() {
     if (timeout_id != 0) {
         return;
     }
-    if (delay > 0) {
-        timeout_id = g_timeout_add_seconds(delay, &InvalidationSender::callback, static_cast<void*>(this));
+    int64_t wait_ms = delay * 1000;
+    if (last_sent != 0) {
+        const int64_t since_ms = (g_get_monotonic_time() - last_sent) / 1000;
+        wait_ms = max(wait_ms, min_interval * 1000 - since_ms);
+    }
+    if (wait_ms > 0) {
+        timeout_id = g_timeout_add(static_cast<guint>(wait_ms),
+                                   &InvalidationSender::callback, static_cast<void*>(this));
     } else {
         InvalidationSender::callback(this);
     }
 }
 
+void InvalidationSender::flush() {
+    if (!bus) {
+        return;
+    }
+    if (timeout_id != 0) {
+        g_source_remove(timeout_id);
+        timeout_id = 0;
+    }
+    InvalidationSender::callback(this);
+}
+
 int InvalidationSender::callback(void *data) {
     auto invalidator = static_cast<InvalidationSender*>(data);
     GError *error = nullptr;
 
-    if (!g_dbus_connection_emit_signal(
+    if (invalidator->before_send) {
+        try {
+            invalidator->before_send();
+        } catch (const std::exception &e) {
+            fprintf(stderr, "Error preparing invalidation: %s\n", e.what());
+        }
+    }
+
+    bool audio = true, video = true;
+    int64_t sequence = -1;
+    if (invalidator->store) {
+        try {
+            sequence = invalidator->store->getChangeSequence();
+            if (invalidator->last_sequence >= 0) {
+                audio = video = false;
+                for (const auto type : invalidator->store->getChangedTypesSince(invalidator->last_sequence)) {
+                    audio = audio || type == AudioMedia;
+                    video = video || type == VideoMedia;
+                }
+            }
+        } catch (const std::exception &) {
+            // The journal was trimmed: invalidate everything.
+            audio = video = true;
+        }
+        invalidator->last_sequence = sequence;
+    }
+
+    if (audio && !g_dbus_connection_emit_signal(
             invalidator->bus.get(), nullptr,
             SCOPES_DBUS_PATH, SCOPES_DBUS_IFACE, SCOPES_INVALIDATE_RESULTS,
             g_variant_new("(s)", "mediascanner-music"), &error)) {
@@ -77,7 +144,7 @@ int InvalidationSender::callback(void *data) {
         g_error_free(error);
         error = nullptr;
     }
-    if (!g_dbus_connection_emit_signal(
+    if (video && !g_dbus_connection_emit_signal(
             invalidator->bus.get(), nullptr,
             SCOPES_DBUS_PATH, SCOPES_DBUS_IFACE, SCOPES_INVALIDATE_RESULTS,
             g_variant_new("(s)", "mediascanner-video"), &error)) {
@@ -85,8 +152,19 @@ int InvalidationSender::callback(void *data) {
         g_error_free(error);
         error = nullptr;
     }
+    // Clients that follow the change journal can ask for the changes
+    // up to this sequence number rather than requerying.
+    if (sequence >= 0 && !g_dbus_connection_emit_signal(
+            invalidator->bus.get(), nullptr,
+            MEDIASCANNER_DBUS_PATH, MEDIASCANNER_DBUS_IFACE, MEDIASCANNER_MEDIA_CHANGED,
+            g_variant_new("(x)", static_cast<gint64>(sequence)), &error)) {
+        fprintf(stderr, "Could not send media changed signal: %s\n", error->message);
+        g_error_free(error);
+        error = nullptr;
+    }
 
     invalidator->timeout_id = 0;
+    invalidator->last_sent = g_get_monotonic_time();
     return G_SOURCE_REMOVE;
 }
 
@@ -20,12 +20,16 @@
 #ifndef INVALIDATIONSENDER_HH
 #define INVALIDATIONSENDER_HH
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 
 typedef struct _GDBusConnection GDBusConnection;
 
 namespace mediascanner {
 
+class MediaStore;
+
 /**
  * A class that sends a broadcast signal that the state of media
  * files has changed.
@@ -39,8 +43,24 @@ public:
     InvalidationSender& operator=(const InvalidationSender &o) = delete;
 
     void invalidate();
+    // Send an invalidation straight away, without waiting for the
+    // delay or the minimum interval, as when a scan is done.
+    void flush();
     void setBus(GDBusConnection *bus);
     void setDelay(int delay);
+    // The least time in seconds between two invalidations.  Calls to
+    // invalidate() in between are merged into one sent once the
+    // interval is up.
+    void setMinInterval(int interval);
+    int getMinInterval() const;
+    // Called before each invalidation is sent, so clients see
+    // up to date data when they requery.
+    void setBeforeSend(std::function<void()> before_send);
+    // The store whose change journal says what changed since the
+    // last invalidation.  If set, only the scopes for the media types
+    // that changed are invalidated, and a MediaChanged signal carries
+    // the sequence number of the latest change.
+    void setStore(const MediaStore *store);
 
 private:
     static int callback(void *data);
@@ -48,6 +68,12 @@ private:
     std::unique_ptr<GDBusConnection, void(*)(void*)> bus;
     unsigned int timeout_id = 0;
     int delay = 0;
+    int min_interval = 0;
+    // Monotonic time in microseconds of the last invalidation.
+    int64_t last_sent = 0;
+    std::function<void()> before_send;
+    const MediaStore *store = nullptr;
+    int64_t last_sequence = -1;
 };
 
 }
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of version 3 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MaintenanceScheduler.hh"
+#include "VolumeManager.hh"
+#include <mediascanner/MediaStore.hh>
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <glib.h>
+
+using namespace std;
+
+// How long nothing must have changed before maintenance starts.
+static const int64_t QUIET_PERIOD = 5 * 60 * G_USEC_PER_SEC;
+// How long to wait between rounds of maintenance.
+static const int64_t INTERVAL = 24 * 60 * 60 * G_USEC_PER_SEC;
+// How long each slice runs for, and the pause between slices.
+static const int SLICE_BUDGET_MS = 50;
+static const unsigned int SLICE_GAP_MS = 200;
+
+namespace mediascanner {
+
+MaintenanceScheduler::MaintenanceScheduler(MediaStore &store, const VolumeManager &volumes)
+    : store(store), volumes(volumes), last_activity(g_get_monotonic_time()) {
+    schedule(QUIET_PERIOD / 1000);
+}
+
+MaintenanceScheduler::~MaintenanceScheduler() {
+    if (timeout_id != 0) {
+        g_source_remove(timeout_id);
+    }
+}
+
+void MaintenanceScheduler::activity() {
+    last_activity = g_get_monotonic_time();
+    // A round part way through picks up where it left off.
+    schedule(QUIET_PERIOD / 1000);
+}
+
+void MaintenanceScheduler::schedule(unsigned int delay_ms) {
+    if (timeout_id != 0) {
+        g_source_remove(timeout_id);
+    }
+    timeout_id = g_timeout_add(delay_ms, &MaintenanceScheduler::callback, static_cast<void*>(this));
+}
+
+int MaintenanceScheduler::callback(void *data) {
+    auto scheduler = static_cast<MaintenanceScheduler*>(data);
+    scheduler->timeout_id = 0;
+
+    const int64_t now = g_get_monotonic_time();
+    const int64_t quiet = now - scheduler->last_activity;
+    if (!scheduler->volumes.idle() || quiet < QUIET_PERIOD) {
+        scheduler->schedule((QUIET_PERIOD - std::min(quiet, QUIET_PERIOD / 2)) / 1000);
+        return G_SOURCE_REMOVE;
+    }
+    if (!scheduler->running && scheduler->last_completed != 0 &&
+        now - scheduler->last_completed < INTERVAL) {
+        scheduler->schedule((INTERVAL - (now - scheduler->last_completed)) / 1000);
+        return G_SOURCE_REMOVE;
+    }
+
+    bool done;
+    try {
+        scheduler->running = true;
+        done = scheduler->store.runMaintenance(SLICE_BUDGET_MS);
+    } catch (const std::exception &e) {
+        fprintf(stderr, "Error during database maintenance: %s\n", e.what());
+        done = true;
+    }
+    if (!done) {
+        scheduler->schedule(SLICE_GAP_MS);
+        return G_SOURCE_REMOVE;
+    }
+
+    scheduler->running = false;
+    scheduler->last_completed = g_get_monotonic_time();
+    try {
+        // Readers benefit from the merged index and new statistics.
+        scheduler->store.publishSnapshot();
+        DatabaseStats stats = scheduler->store.getDatabaseStats();
+        printf("Database maintenance done: %lld bytes, %lld free pages, %lld search index segments.\n",
+               (long long)stats.size, (long long)stats.freelist_pages,
+               (long long)stats.fts_segments);
+    } catch (const std::exception &e) {
+        fprintf(stderr, "Error after database maintenance: %s\n", e.what());
+    }
+    scheduler->schedule(INTERVAL / 1000);
+    return G_SOURCE_REMOVE;
+}
+
+}
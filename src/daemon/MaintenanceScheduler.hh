@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of version 3 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAINTENANCESCHEDULER_HH
+#define MAINTENANCESCHEDULER_HH
+
+#include <cstdint>
+
+namespace mediascanner {
+
+class MediaStore;
+class VolumeManager;
+
+/**
+ * Runs MediaStore::runMaintenance() about once a day, once no volume
+ * is being scanned and nothing has changed for a while.  Each slice
+ * of work is short and followed by a return to the main loop, so
+ * invalidations and file system events are not held up.
+ */
+
+class MaintenanceScheduler final {
+public:
+    MaintenanceScheduler(MediaStore &store, const VolumeManager &volumes);
+    ~MaintenanceScheduler();
+    MaintenanceScheduler(const MaintenanceScheduler &o) = delete;
+    MaintenanceScheduler& operator=(const MaintenanceScheduler &o) = delete;
+
+    // Note that the media changed, putting maintenance off until
+    // things are quiet again.
+    void activity();
+
+private:
+    static int callback(void *data);
+    void schedule(unsigned int delay_ms);
+
+    MediaStore &store;
+    const VolumeManager &volumes;
+    unsigned int timeout_id = 0;
+    // Monotonic times in microseconds.
+    int64_t last_activity;
+    int64_t last_completed = 0;
+    // Whether a round of maintenance is part way through.
+    bool running = false;
+};
+
+}
+
+#endif
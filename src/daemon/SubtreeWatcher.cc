@@ -178,10 +178,10 @@ bool SubtreeWatcher::fileAdded(const string &abspath) {
             p->store.insert(p->extractor.fallback_extract(d));
         } else if (d.etag != p->store.getETag(d.filename)) {
             // Only extract and insert the file if the ETag has changed.
-            p->store.insert_broken_file(abspath, d.etag);
-            // If detection dies, insertion into broken files persists
-            // and the next time this file is encountered, it is skipped.
-            // Insert cleans broken status of the file.
+            // If detection dies, the file is marked as broken when the
+            // store is next opened, and the next time this file is
+            // encountered, it is skipped.
+            p->store.beginExtraction(abspath, d.etag);
             MediaFile media;
             try {
                 media = p->extractor.extract(d);
@@ -190,10 +190,12 @@ bool SubtreeWatcher::fileAdded(const string &abspath) {
                         d.filename.c_str(), e.what());
                 media = p->extractor.fallback_extract(d);
             }
+            p->store.endExtraction(abspath);
             p->store.insert(std::move(media));
             changed = true;
         }
     } catch(const exception &e) {
+        p->store.endExtraction(abspath);
         fprintf(stderr, "Error when adding new file: %s\n", e.what());
     }
     return changed;
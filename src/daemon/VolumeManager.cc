@@ -26,15 +26,21 @@
 #include "InvalidationSender.hh"
 #include "Scanner.hh"
 #include "SubtreeWatcher.hh"
+#include "../mediascanner/internal/KnownFiles.hh"
 #include "../mediascanner/internal/utils.hh"
 
 #include <glib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstdio>
 #include <map>
 #include <deque>
 #include <stdexcept>
+#include <vector>
 
 using namespace std;
 
@@ -76,6 +82,7 @@ struct VolumeManagerPrivate {
     void addVolume(const string& path);
     void removeVolume(const string& path);
     void readFiles(const string& subdir, const MediaType type);
+    void pruneOutsideVolumes();
 };
 
 VolumeManager::VolumeManager(MediaStore& store, MetadataExtractor& extractor,
@@ -129,6 +136,7 @@ void VolumeManagerPrivate::queueUpdate(VolumeEventType type,
 gboolean VolumeManagerPrivate::processEvent(void *user_data) noexcept {
     auto *p = reinterpret_cast<VolumeManagerPrivate*>(user_data);
 
+    bool added = false;
     while (!p->pending.empty()) {
         auto event = move(p->pending.front());
         p->pending.pop_front();
@@ -136,13 +144,17 @@ gboolean VolumeManagerPrivate::processEvent(void *user_data) noexcept {
         switch (event.type) {
         case VolumeEventType::added:
             p->addVolume(event.path);
+            added = true;
             break;
         case VolumeEventType::removed:
             p->removeVolume(event.path);
             break;
         }
     }
-    p->invalidator.invalidate();
+    if (added) {
+        p->pruneOutsideVolumes();
+    }
+    p->invalidator.flush();
     p->idle_id = 0;
     return G_SOURCE_REMOVE;
 }
@@ -167,7 +179,6 @@ void VolumeManagerPrivate::addVolume(const string& path) {
     }
     unique_ptr<SubtreeWatcher> sw(new SubtreeWatcher(store, extractor, invalidator));
     store.restoreItems(path);
-    store.pruneDeleted();
     readFiles(path, AllMedia);
     sw->addDir(path);
     volumes[path] = move(sw);
@@ -181,10 +192,58 @@ void VolumeManagerPrivate::removeVolume(const string& path) {
     volumes.erase(path);
 }
 
+// readFiles() removes what it no longer finds in a volume, and the
+// volume's watcher what is deleted later, so only check the media
+// outside the volumes against the disk.
+void VolumeManagerPrivate::pruneOutsideVolumes() {
+    vector<string> walked;
+    for (const auto &volume : volumes) {
+        walked.push_back(volume.first);
+    }
+    try {
+        store.pruneDeleted(walked);
+    } catch (const exception &e) {
+        fprintf(stderr, "Error pruning deleted files: %s\n", e.what());
+    }
+}
+
+static bool is_same_file(const string &path, const struct stat &st) {
+    struct stat now;
+    return stat(path.c_str(), &now) == 0 &&
+        now.st_dev == st.st_dev && now.st_ino == st.st_ino;
+}
+
 void VolumeManagerPrivate::readFiles(const string &subdir, const MediaType type) {
     Scanner s(&extractor, subdir, type);
+    // Load what the store knows about the files up front, rather than
+    // asking about each file as it is found.
+    KnownFiles known = getKnownFiles(store, subdir);
+    struct stat subdir_st;
+    if (stat(subdir.c_str(), &subdir_st) != 0) {
+        return;
+    }
     MediaStoreTransaction txn = store.beginTransaction();
-    const int update_interval = 10; // How often to send invalidations.
+    // How often to publish what was found and send invalidations:
+    // no more often than the invalidator would.
+    const int update_interval = max(10, invalidator.getMinInterval());
+    const size_t batch_size = 100; // How many files to insert at once.
+    vector<MediaFile> batch;
+    auto flush = [&]() {
+        try {
+            store.insertBatch(batch);
+        } catch(const exception &e) {
+            // Fall back to inserting one by one so a single bad
+            // file does not lose the rest of the batch.
+            for (const auto &media : batch) {
+                try {
+                    store.insert(media);
+                } catch(const exception &e) {
+                    fprintf(stderr, "Error when indexing: %s\n", e.what());
+                }
+            }
+        }
+        batch.clear();
+    };
     struct timespec previous_update, current_time;
     clock_gettime(CLOCK_MONOTONIC, &previous_update);
     previous_update.tv_sec -= update_interval/2; // Send the first update sooner for better visual appeal.
@@ -196,21 +255,31 @@ void VolumeManagerPrivate::readFiles(const string &subdir, const MediaType type)
                 g_main_context_iteration(g_main_context_default(), FALSE);
             }
             if(current_time.tv_sec - previous_update.tv_sec >= update_interval) {
-                txn.commit();
-                invalidator.invalidate();
+                flush();
+                // The snapshot must be published between the commit
+                // and the next transaction, not when the invalidation
+                // goes out.
+                txn.commitAndPublish();
+                invalidator.flush();
                 previous_update = current_time;
             }
-            // If the file is broken or unchanged, use fallback.
-            if (store.is_broken_file(d.filename, d.etag)) {
+            if (batch.size() >= batch_size) {
+                flush();
+            }
+            // If the file is broken, use fallback.  Skip it if unchanged.
+            switch (known.check(d.filename, d.etag)) {
+            case KnownFiles::Broken:
                 fprintf(stderr, "Using fallback data for unscannable file %s.\n", d.filename.c_str());
-                store.insert(extractor.fallback_extract(d));
+                batch.push_back(extractor.fallback_extract(d));
                 continue;
-            }
-            if(d.etag == store.getETag(d.filename))
+            case KnownFiles::Unchanged:
                 continue;
+            default:
+                break;
+            }
 
             try {
-                store.insert_broken_file(d.filename, d.etag);
+                store.beginExtraction(d.filename, d.etag);
                 MediaFile media;
                 try {
                     media = extractor.extract(d);
@@ -219,14 +288,29 @@ void VolumeManagerPrivate::readFiles(const string &subdir, const MediaType type)
                             d.filename.c_str(), e.what());
                     media = extractor.fallback_extract(d);
                 }
-                store.insert(std::move(media));
+                store.endExtraction(d.filename);
+                batch.push_back(std::move(media));
             } catch(const exception &e) {
+                store.endExtraction(d.filename);
                 fprintf(stderr, "Error when indexing: %s\n", e.what());
             }
         } catch(const StopIteration &stop) {
             break;
         }
     }
+    flush();
+    // The scanner quietly skips what it cannot read, so of the files
+    // it did not find only remove those that are really gone.  If the
+    // volume went away during the scan, leave them all for the next.
+    if (type == AllMedia && is_same_file(subdir, subdir_st)) {
+        vector<string> gone;
+        for (auto &filename : known.getUnseen()) {
+            if (access(filename.c_str(), F_OK) != 0 && errno == ENOENT) {
+                gone.push_back(move(filename));
+            }
+        }
+        store.removeBatch(gone);
+    }
     txn.commit();
 }
 
@@ -37,6 +37,7 @@
 #include "MountWatcher.hh"
 #include "InvalidationSender.hh"
 #include "VolumeManager.hh"
+#include "MaintenanceScheduler.hh"
 
 using namespace std;
 
@@ -59,6 +60,12 @@ bool is_same_directory(const char *dir1, const char *dir2) {
 
 static const char BUS_NAME[] = "com.canonical.MediaScanner2.Daemon";
 static const unsigned int INVALIDATE_DELAY = 1;
+// Each invalidation publishes a copy of the database, so while a
+// scan goes on send them at most this often, in seconds.
+static const unsigned int INVALIDATE_INTERVAL = 30;
+// Keep a week of changes, up to a limit.
+static const size_t MAX_CHANGES = 10000;
+static const int MAX_CHANGE_AGE = 7 * 24 * 60 * 60;
 
 
 class ScannerDaemon final {
@@ -83,6 +90,7 @@ private:
     unique_ptr<MetadataExtractor> extractor;
     InvalidationSender invalidator;
     unique_ptr<VolumeManager> volumes;
+    unique_ptr<MaintenanceScheduler> maintenance;
     unique_ptr<GMainLoop,void(*)(GMainLoop*)> main_loop;
     unique_ptr<GDBusConnection,void(*)(void*)> session_bus;
     unsigned int bus_name_id = 0;
@@ -93,8 +101,19 @@ ScannerDaemon::ScannerDaemon() :
     session_bus(nullptr, g_object_unref) {
     setupBus();
     store.reset(new MediaStore(MS_READ_WRITE, "/media/"));
+    // Readers use the published snapshot, so refresh it before
+    // telling them to requery.
+    invalidator.setBeforeSend([this]() {
+            store->trimChanges(MAX_CHANGES, MAX_CHANGE_AGE);
+            store->publishSnapshot();
+            if (maintenance) {
+                maintenance->activity();
+            }
+        });
+    invalidator.setStore(store.get());
     extractor.reset(new MetadataExtractor(session_bus.get()));
     volumes.reset(new VolumeManager(*store, *extractor, invalidator));
+    maintenance.reset(new MaintenanceScheduler(*store, *volumes));
 
     setupMountWatcher();
 
@@ -155,6 +174,7 @@ void ScannerDaemon::setupBus() {
     }
     invalidator.setBus(session_bus.get());
     invalidator.setDelay(INVALIDATE_DELAY);
+    invalidator.setMinInterval(INVALIDATE_INTERVAL);
 
     bus_name_id = g_bus_own_name_on_connection(
         session_bus.get(), BUS_NAME, static_cast<GBusNameOwnerFlags>(
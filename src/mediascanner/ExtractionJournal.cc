@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal/ExtractionJournal.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace mediascanner {
+
+namespace {
+
+// Room for a file name of PATH_MAX and its etag.  Extractions are
+// one at a time, so a few slots are plenty.
+const size_t SLOT_SIZE = 8192;
+const size_t NUM_SLOTS = 8;
+
+}
+
+struct ExtractionJournal::Slot {
+    // Set once the rest of the slot is written, and cleared to free
+    // it.
+    uint32_t in_use;
+    uint32_t filename_length;
+    uint32_t etag_length;
+    char data[SLOT_SIZE - 3 * sizeof(uint32_t)];
+};
+
+ExtractionJournal::ExtractionJournal(const std::string &path) {
+    static_assert(sizeof(Slot) == SLOT_SIZE, "unexpected padding in Slot");
+    const size_t size = NUM_SLOTS * SLOT_SIZE;
+    if (path.empty()) {
+        slots = new Slot[NUM_SLOTS]();
+        return;
+    }
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd < 0 || ftruncate(fd, size) < 0) {
+        string msg("Could not open extraction journal: ");
+        msg += strerror(errno);
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw runtime_error(msg);
+    }
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        string msg("Could not map extraction journal: ");
+        msg += strerror(errno);
+        throw runtime_error(msg);
+    }
+    slots = static_cast<Slot*>(mem);
+    mapped = true;
+}
+
+ExtractionJournal::~ExtractionJournal() {
+    if (mapped) {
+        munmap(slots, NUM_SLOTS * SLOT_SIZE);
+    } else {
+        delete[] slots;
+    }
+}
+
+bool ExtractionJournal::begin(const std::string &filename, const std::string &etag) {
+    if (filename.size() + etag.size() > sizeof(Slot::data)) {
+        return false;
+    }
+    lock_guard<std::mutex> lock(slotsMutex);
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        Slot &slot = slots[i];
+        if (slot.in_use) {
+            continue;
+        }
+        slot.filename_length = filename.size();
+        slot.etag_length = etag.size();
+        memcpy(slot.data, filename.data(), filename.size());
+        memcpy(slot.data + filename.size(), etag.data(), etag.size());
+        // Only the process dying can interrupt, so it is enough that
+        // the compiler does not mark the slot before filling it.
+        atomic_signal_fence(memory_order_release);
+        slot.in_use = 1;
+        return true;
+    }
+    return false;
+}
+
+void ExtractionJournal::end(const std::string &filename) {
+    lock_guard<std::mutex> lock(slotsMutex);
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        Slot &slot = slots[i];
+        if (slot.in_use && slot.filename_length == filename.size() &&
+            memcmp(slot.data, filename.data(), filename.size()) == 0) {
+            slot.in_use = 0;
+        }
+    }
+}
+
+std::vector<std::pair<std::string, std::string>> ExtractionJournal::takeLeftovers() {
+    lock_guard<std::mutex> lock(slotsMutex);
+    vector<pair<string, string>> leftovers;
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        Slot &slot = slots[i];
+        if (!slot.in_use) {
+            continue;
+        }
+        // Don't trust lengths from a file another process wrote.
+        if (size_t(slot.filename_length) + slot.etag_length <= sizeof(Slot::data)) {
+            leftovers.emplace_back(string(slot.data, slot.filename_length),
+                                   string(slot.data + slot.filename_length, slot.etag_length));
+        }
+        slot.in_use = 0;
+    }
+    return leftovers;
+}
+
+}
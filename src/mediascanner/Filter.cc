@@ -18,8 +18,12 @@
  */
 
 #include "Filter.hh"
+#include "Album.hh"
+#include "MediaFile.hh"
+#include "internal/utils.hh"
 
 using std::string;
+using std::to_string;
 
 namespace mediascanner {
 
@@ -28,6 +32,12 @@ struct Filter::Private {
     string album;
     string album_artist;
     string genre;
+    string cursor;
+
+    int64_t date_start = 0;
+    int64_t date_end = 0;
+    int64_t modified_start = 0;
+    int64_t modified_end = 0;
 
     int offset = 0;
     int limit = -1;
@@ -39,6 +49,8 @@ struct Filter::Private {
     bool have_album = false;
     bool have_album_artist = false;
     bool have_genre = false;
+    bool have_date_range = false;
+    bool have_modified_range = false;
 
     Private() {}
 };
@@ -68,8 +80,15 @@ bool Filter::operator==(const Filter &other) const {
         p->album == other.p->album &&
         p->album_artist == other.p->album_artist &&
         p->genre == other.p->genre &&
+        p->have_date_range == other.p->have_date_range &&
+        p->date_start == other.p->date_start &&
+        p->date_end == other.p->date_end &&
+        p->have_modified_range == other.p->have_modified_range &&
+        p->modified_start == other.p->modified_start &&
+        p->modified_end == other.p->modified_end &&
         p->offset == other.p->offset &&
         p->limit == other.p->limit &&
+        p->cursor == other.p->cursor &&
         p->order == other.p->order &&
         p->reverse == other.p->reverse;
 }
@@ -97,8 +116,11 @@ void Filter::clear() {
     unsetAlbum();
     unsetAlbumArtist();
     unsetGenre();
+    unsetDateRange();
+    unsetModifiedRange();
     p->offset = 0;
     p->limit = -1;
+    p->cursor = "";
     p->order = MediaOrder::Default;
     p->reverse = false;
 }
@@ -175,6 +197,54 @@ const std::string &Filter::getGenre() const {
     return p->genre;
 }
 
+void Filter::setDateRange(int64_t start, int64_t end) {
+    p->date_start = start;
+    p->date_end = end;
+    p->have_date_range = true;
+}
+
+void Filter::unsetDateRange() {
+    p->date_start = 0;
+    p->date_end = 0;
+    p->have_date_range = false;
+}
+
+bool Filter::hasDateRange() const {
+    return p->have_date_range;
+}
+
+int64_t Filter::getDateStart() const {
+    return p->date_start;
+}
+
+int64_t Filter::getDateEnd() const {
+    return p->date_end;
+}
+
+void Filter::setModifiedRange(int64_t start, int64_t end) {
+    p->modified_start = start;
+    p->modified_end = end;
+    p->have_modified_range = true;
+}
+
+void Filter::unsetModifiedRange() {
+    p->modified_start = 0;
+    p->modified_end = 0;
+    p->have_modified_range = false;
+}
+
+bool Filter::hasModifiedRange() const {
+    return p->have_modified_range;
+}
+
+int64_t Filter::getModifiedStart() const {
+    return p->modified_start;
+}
+
+int64_t Filter::getModifiedEnd() const {
+    return p->modified_end;
+}
+
 void Filter::setOffset(int offset) {
     p->offset = offset;
 }
@@ -191,6 +261,45 @@ int Filter::getLimit() const {
     return p->limit;
 }
 
+void Filter::setCursor(const std::string &cursor) {
+    p->cursor = cursor;
+}
+
+void Filter::unsetCursor() {
+    p->cursor = "";
+}
+
+bool Filter::hasCursor() const {
+    return !p->cursor.empty();
+}
+
+const std::string &Filter::getCursor() const {
+    return p->cursor;
+}
+
+// The cursor holds every key a media query might be sorted on,
+// so the store can pick out the ones for the requested order.
+void Filter::setCursorAfter(const MediaFile &file) {
+    p->cursor = encode_cursor({
+        "media",
+        file.getAlbumArtist(),
+        file.getAlbum(),
+        to_string(file.getDiscNumber()),
+        to_string(file.getTrackNumber()),
+        file.getTitle(),
+        file.getDate(),
+        to_string(file.getModificationTime()),
+        file.getFileName()});
+}
+
+void Filter::setCursorAfter(const Album &album) {
+    p->cursor = encode_cursor({"album", album.getTitle()});
+}
+
+void Filter::setCursorAfterName(const std::string &name) {
+    p->cursor = encode_cursor({"name", name});
+}
+
 void Filter::setOrder(MediaOrder order) {
     p->order = order;
 }
@@ -20,11 +20,15 @@
 #ifndef MEDIAFILTER_H_
 #define MEDIAFILTER_H_
 
+#include <cstdint>
 #include <string>
 #include "scannercore.hh"
 
 namespace mediascanner {
 
+class Album;
+class MediaFile;
+
 class Filter final {
 public:
     Filter();
@@ -59,11 +63,40 @@ public:
     bool hasGenre() const;
     const std::string &getGenre() const;
 
+    // Only media dated, or last modified, from start up to but not
+    // including end, in seconds since the epoch.  Media without a
+    // date never match a date range.
+    void setDateRange(int64_t start, int64_t end);
+    void unsetDateRange();
+    bool hasDateRange() const;
+    int64_t getDateStart() const;
+    int64_t getDateEnd() const;
+
+    void setModifiedRange(int64_t start, int64_t end);
+    void unsetModifiedRange();
+    bool hasModifiedRange() const;
+    int64_t getModifiedStart() const;
+    int64_t getModifiedEnd() const;
+
     void setOffset(int offset);
     int getOffset() const;
     void setLimit(int limit);
     int getLimit() const;
 
+    // An opaque continuation cursor.  When set, results resume
+    // after the row the cursor was made from instead of skipping
+    // getOffset() rows.  Orderings that can not be resumed this way
+    // (search rank) ignore the cursor and use the offset.
+    void setCursor(const std::string &cursor);
+    void unsetCursor();
+    bool hasCursor() const;
+    const std::string &getCursor() const;
+    // Set the cursor to continue after the last row of a previous
+    // batch of results.
+    void setCursorAfter(const MediaFile &file);
+    void setCursorAfter(const Album &album);
+    void setCursorAfterName(const std::string &name);
+
     void setOrder(MediaOrder order);
     MediaOrder getOrder() const;
     void setReverse(bool reverse);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Folder.hh"
+#include "MediaFile.hh"
+
+using namespace std;
+
+namespace mediascanner {
+
+struct Folder::Private {
+    string path;
+    int media_count = 0;
+    vector<Folder> subfolders;
+    vector<MediaFile> media;
+
+    Private() {}
+    Private(const string &path, int media_count,
+            const vector<Folder> &subfolders,
+            const vector<MediaFile> &media)
+        : path(path), media_count(media_count),
+          subfolders(subfolders), media(media) {}
+    Private(const Private &other) = default;
+    Private &operator=(const Private &other) = default;
+};
+
+Folder::Folder() : p(new Private) {
+}
+
+Folder::Folder(const std::string &path, int media_count)
+    : Folder(path, media_count, {}, {}) {
+}
+
+Folder::Folder(const std::string &path, int media_count,
+               const std::vector<Folder> &subfolders,
+               const std::vector<MediaFile> &media)
+    : p(new Private(path, media_count, subfolders, media)) {
+}
+
+Folder::Folder(const Folder &other) : p(new Private(*other.p)) {
+}
+
+Folder::Folder(Folder &&other) : p(nullptr) {
+    *this = std::move(other);
+}
+
+Folder::~Folder() {
+    delete p;
+}
+
+Folder &Folder::operator=(const Folder &other) {
+    *p = *other.p;
+    return *this;
+}
+
+Folder &Folder::operator=(Folder &&other) {
+    if (this != &other) {
+        delete p;
+        p = other.p;
+        other.p = nullptr;
+    }
+    return *this;
+}
+
+const std::string& Folder::getPath() const noexcept {
+    return p->path;
+}
+
+std::string Folder::getName() const {
+    auto pos = p->path.rfind('/');
+    if (pos == string::npos) {
+        return p->path;
+    }
+    return p->path.substr(pos + 1);
+}
+
+int Folder::getMediaCount() const noexcept {
+    return p->media_count;
+}
+
+const std::vector<Folder>& Folder::getSubfolders() const noexcept {
+    return p->subfolders;
+}
+
+const std::vector<MediaFile>& Folder::getMedia() const noexcept {
+    return p->media;
+}
+
+bool Folder::operator==(const Folder &other) const {
+    return p->path == other.p->path &&
+        p->media_count == other.p->media_count &&
+        p->subfolders == other.p->subfolders &&
+        p->media == other.p->media;
+}
+
+bool Folder::operator!=(const Folder &other) const {
+    return !(*this == other);
+}
+
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FOLDER_HH
+#define FOLDER_HH
+
+#include <string>
+#include <vector>
+
+namespace mediascanner {
+
+class MediaFile;
+
+// The contents of a directory as returned by
+// MediaStoreBase::listFolder().  Subfolders are listed with their
+// media counts only: their own subfolders and media are not filled
+// in.
+class Folder final {
+public:
+
+    Folder();
+    Folder(const std::string &path, int media_count);
+    Folder(const std::string &path, int media_count,
+           const std::vector<Folder> &subfolders,
+           const std::vector<MediaFile> &media);
+    Folder(const Folder &other);
+    Folder(Folder &&other);
+    ~Folder();
+
+    Folder &operator=(const Folder &other);
+    Folder &operator=(Folder &&other);
+
+    const std::string& getPath() const noexcept;
+    std::string getName() const;
+    // The number of media files in this folder and all folders below it.
+    int getMediaCount() const noexcept;
+    const std::vector<Folder>& getSubfolders() const noexcept;
+    const std::vector<MediaFile>& getMedia() const noexcept;
+    bool operator==(const Folder &other) const;
+    bool operator!=(const Folder &other) const;
+
+private:
+    struct Private;
+    Private *p;
+};
+
+}
+
+#endif
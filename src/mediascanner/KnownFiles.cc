@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal/KnownFiles.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace mediascanner {
+
+struct KnownFiles::Private {
+    static const uint32_t NONE = numeric_limits<uint32_t>::max();
+
+    struct Entry {
+        uint32_t filename;
+        uint32_t filename_length;
+        uint32_t etag;          // NONE if not in media
+        uint32_t broken_etag;   // NONE if not broken
+    };
+
+    // The file names and etags, each followed by a nul.
+    std::string text;
+    // Sorted by file name.
+    std::vector<Entry> entries;
+    std::vector<bool> seen;
+
+    int compare(const Entry &entry, const string &filename) const {
+        return filename.compare(0, string::npos, text, entry.filename, entry.filename_length);
+    }
+
+    uint32_t addText(const char *value) {
+        const size_t length = strlen(value);
+        if (text.size() + length >= NONE) {
+            throw length_error("KnownFiles text is too long");
+        }
+        const uint32_t offset = text.size();
+        text.append(value, length + 1);
+        return offset;
+    }
+};
+
+KnownFiles::KnownFiles() : p(new Private) {
+}
+
+KnownFiles::KnownFiles(KnownFiles &&other) : p(nullptr) {
+    *this = std::move(other);
+}
+
+KnownFiles::~KnownFiles() {
+    delete p;
+}
+
+KnownFiles &KnownFiles::operator=(KnownFiles &&other) {
+    if (this != &other) {
+        delete p;
+        p = other.p;
+        other.p = nullptr;
+    }
+    return *this;
+}
+
+size_t KnownFiles::size() const noexcept {
+    return p->entries.size();
+}
+
+KnownFiles::Status KnownFiles::check(const std::string &filename, const std::string &etag) {
+    auto it = lower_bound(p->entries.begin(), p->entries.end(), filename,
+                          [this](const Private::Entry &entry, const string &filename) {
+                              return p->compare(entry, filename) > 0;
+                          });
+    if (it == p->entries.end() || p->compare(*it, filename) != 0) {
+        return New;
+    }
+    p->seen[it - p->entries.begin()] = true;
+    if (it->broken_etag != Private::NONE &&
+        etag.compare(&p->text[it->broken_etag]) == 0) {
+        return Broken;
+    }
+    if (it->etag == Private::NONE) {
+        return New;
+    }
+    return etag.compare(&p->text[it->etag]) == 0 ? Unchanged : Changed;
+}
+
+std::vector<std::string> KnownFiles::getUnseen() const {
+    vector<string> unseen;
+    for (size_t i = 0; i < p->entries.size(); i++) {
+        const auto &entry = p->entries[i];
+        if (!p->seen[i] && entry.etag != Private::NONE) {
+            unseen.emplace_back(p->text, entry.filename, entry.filename_length);
+        }
+    }
+    return unseen;
+}
+
+void KnownFiles::add(const std::string &filename, const char *etag, const char *broken_etag) {
+    if (!p->entries.empty() && p->compare(p->entries.back(), filename) <= 0) {
+        throw invalid_argument("KnownFiles must be added in order of file name");
+    }
+    Private::Entry entry;
+    entry.filename_length = filename.size();
+    entry.filename = p->addText(filename.c_str());
+    entry.etag = etag ? p->addText(etag) : Private::NONE;
+    entry.broken_etag = broken_etag ? p->addText(broken_etag) : Private::NONE;
+    p->entries.push_back(entry);
+    p->seen.push_back(false);
+}
+
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MediaChange.hh"
+
+using namespace std;
+
+namespace mediascanner {
+
+struct MediaChange::Private {
+    int64_t sequence = 0;
+    ChangeKind kind = ChangeKind::Insert;
+    string filename;
+    MediaType type = UnknownMedia;
+
+    Private() {}
+    Private(int64_t sequence, ChangeKind kind, const string &filename,
+            MediaType type)
+        : sequence(sequence), kind(kind), filename(filename), type(type) {}
+};
+
+MediaChange::MediaChange() : p(new Private) {
+}
+
+MediaChange::MediaChange(int64_t sequence, ChangeKind kind,
+                         const std::string &filename, MediaType type)
+    : p(new Private(sequence, kind, filename, type)) {
+}
+
+MediaChange::MediaChange(const MediaChange &other) : p(new Private(*other.p)) {
+}
+
+MediaChange::MediaChange(MediaChange &&other) : p(nullptr) {
+    *this = std::move(other);
+}
+
+MediaChange::~MediaChange() {
+    delete p;
+}
+
+MediaChange &MediaChange::operator=(const MediaChange &other) {
+    *p = *other.p;
+    return *this;
+}
+
+MediaChange &MediaChange::operator=(MediaChange &&other) {
+    if (this != &other) {
+        delete p;
+        p = other.p;
+        other.p = nullptr;
+    }
+    return *this;
+}
+
+int64_t MediaChange::getSequence() const noexcept {
+    return p->sequence;
+}
+
+ChangeKind MediaChange::getKind() const noexcept {
+    return p->kind;
+}
+
+const std::string& MediaChange::getFileName() const noexcept {
+    return p->filename;
+}
+
+MediaType MediaChange::getType() const noexcept {
+    return p->type;
+}
+
+bool MediaChange::operator==(const MediaChange &other) const {
+    return
+        p->sequence == other.p->sequence &&
+        p->kind == other.p->kind &&
+        p->filename == other.p->filename &&
+        p->type == other.p->type;
+}
+
+bool MediaChange::operator!=(const MediaChange &other) const {
+    return !(*this == other);
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEDIACHANGE_HH
+#define MEDIACHANGE_HH
+
+#include "scannercore.hh"
+#include <cstdint>
+#include <string>
+
+namespace mediascanner {
+
+// An entry in the change journal returned by
+// MediaStoreBase::getChangesSince().  Sequence numbers increase with
+// every change.
+class MediaChange final {
+public:
+
+    MediaChange();
+    MediaChange(int64_t sequence, ChangeKind kind,
+                const std::string &filename, MediaType type);
+    MediaChange(const MediaChange &other);
+    MediaChange(MediaChange &&other);
+    ~MediaChange();
+
+    MediaChange &operator=(const MediaChange &other);
+    MediaChange &operator=(MediaChange &&other);
+
+    int64_t getSequence() const noexcept;
+    ChangeKind getKind() const noexcept;
+    const std::string& getFileName() const noexcept;
+    MediaType getType() const noexcept;
+    bool operator==(const MediaChange &other) const;
+    bool operator!=(const MediaChange &other) const;
+
+private:
+    struct Private;
+    Private *p;
+};
+
+}
+
+#endif
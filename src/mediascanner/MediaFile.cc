@@ -20,7 +20,6 @@
 #include "MediaFile.hh"
 #include "MediaFileBuilder.hh"
 #include "internal/MediaFilePrivate.hh"
-#include "internal/FolderArtCache.hh"
 #include "internal/utils.hh"
 #include <stdexcept>
 
@@ -79,7 +78,7 @@ const std::string& MediaFile::getFileName() const noexcept {
 }
 
 const std::string& MediaFile::getContentType() const noexcept {
-    return p->content_type;
+    return p->content_type.str();
 }
 
 const std::string& MediaFile::getETag() const noexcept {
@@ -91,15 +90,15 @@ const std::string& MediaFile::getTitle() const noexcept {
 }
 
 const std::string& MediaFile::getAuthor() const noexcept {
-    return p->author;
+    return p->author.str();
 }
 
 const std::string& MediaFile::getAlbum() const noexcept {
-    return p->album;
+    return p->album.str();
 }
 
 const std::string& MediaFile::getAlbumArtist() const noexcept {
-    return p->album_artist;
+    return p->album_artist.str();
 }
 
 const std::string& MediaFile::getDate() const noexcept {
@@ -107,7 +106,7 @@ const std::string& MediaFile::getDate() const noexcept {
 }
 
 const std::string& MediaFile::getGenre() const noexcept {
-    return p->genre;
+    return p->genre.str();
 }
 
 int MediaFile::getDiscNumber() const noexcept {
@@ -155,21 +154,8 @@ std::string MediaFile::getUri() const {
 }
 
 std::string MediaFile::getArtUri() const {
-    switch (p->type) {
-    case AudioMedia: {
-        if (p->has_thumbnail) {
-            return make_thumbnail_uri(getUri());
-        }
-        auto standalone = FolderArtCache::get().get_art_for_file(p->filename);
-        if(!standalone.empty()) {
-            return make_thumbnail_uri(mediascanner::getUri(standalone));
-        }
-        return make_album_art_uri(getAuthor(), getAlbum());
-    }
-
-    default:
-        return make_thumbnail_uri(getUri());
-    }
+    return make_art_uri(p->type, p->has_thumbnail, p->filename,
+                        getAuthor(), getAlbum());
 }
 
 bool MediaFile::operator==(const MediaFile &other) const {
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MediaFileBatch.hh"
+#include "MediaFile.hh"
+#include "MediaFileBuilder.hh"
+#include "internal/MediaFilePrivate.hh"
+#include "internal/utils.hh"
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace mediascanner {
+
+struct MediaFileBatch::Private {
+    static const int NUM_TEXT_FIELDS = MediaFileBatch::Genre + 1;
+
+    // The text fields of every row, each followed by a nul.
+    std::string text;
+    // Where each field starts in text, NUM_TEXT_FIELDS per row.
+    std::vector<uint32_t> text_offsets;
+
+    std::vector<int32_t> disc_number;
+    std::vector<int32_t> track_number;
+    std::vector<int32_t> duration;
+    std::vector<int32_t> width;
+    std::vector<int32_t> height;
+    std::vector<double> latitude;
+    std::vector<double> longitude;
+    std::vector<uint8_t> has_thumbnail;
+    std::vector<uint64_t> modification_time;
+    std::vector<MediaType> type;
+
+    size_t size() const noexcept {
+        return type.size();
+    }
+
+    size_t textOffset(size_t row, int field) const noexcept {
+        return text_offsets[row * NUM_TEXT_FIELDS + field];
+    }
+    size_t textLength(size_t row, int field) const noexcept {
+        const size_t i = row * NUM_TEXT_FIELDS + field + 1;
+        const size_t end = i < text_offsets.size() ? text_offsets[i] : text.size();
+        return end - textOffset(row, field) - 1;
+    }
+};
+
+MediaFileBatch::MediaFileBatch() : p(new Private) {
+}
+
+MediaFileBatch::MediaFileBatch(const std::vector<MediaFile> &files)
+    : MediaFileBatch() {
+    for (const auto &file : files) {
+        append(file);
+    }
+}
+
+MediaFileBatch::MediaFileBatch(const MediaFileBatch &other)
+    : p(new Private(*other.p)) {
+}
+
+MediaFileBatch::MediaFileBatch(MediaFileBatch &&other) : p(nullptr) {
+    *this = std::move(other);
+}
+
+MediaFileBatch::~MediaFileBatch() {
+    delete p;
+}
+
+MediaFileBatch &MediaFileBatch::operator=(const MediaFileBatch &other) {
+    *p = *other.p;
+    return *this;
+}
+
+MediaFileBatch &MediaFileBatch::operator=(MediaFileBatch &&other) {
+    if (this != &other) {
+        delete p;
+        p = other.p;
+        other.p = nullptr;
+    }
+    return *this;
+}
+
+size_t MediaFileBatch::size() const noexcept {
+    return p->size();
+}
+
+bool MediaFileBatch::empty() const noexcept {
+    return p->size() == 0;
+}
+
+const char *MediaFileBatch::getText(size_t row, Field field) const noexcept {
+    return p->text.data() + p->textOffset(row, field);
+}
+
+size_t MediaFileBatch::getTextLength(size_t row, Field field) const noexcept {
+    return p->textLength(row, field);
+}
+
+std::string MediaFileBatch::getString(size_t row, Field field) const {
+    return string(getText(row, field), getTextLength(row, field));
+}
+
+int MediaFileBatch::getDiscNumber(size_t row) const noexcept {
+    return p->disc_number[row];
+}
+
+int MediaFileBatch::getTrackNumber(size_t row) const noexcept {
+    return p->track_number[row];
+}
+
+int MediaFileBatch::getDuration(size_t row) const noexcept {
+    return p->duration[row];
+}
+
+int MediaFileBatch::getWidth(size_t row) const noexcept {
+    return p->width[row];
+}
+
+int MediaFileBatch::getHeight(size_t row) const noexcept {
+    return p->height[row];
+}
+
+double MediaFileBatch::getLatitude(size_t row) const noexcept {
+    return p->latitude[row];
+}
+
+double MediaFileBatch::getLongitude(size_t row) const noexcept {
+    return p->longitude[row];
+}
+
+bool MediaFileBatch::getHasThumbnail(size_t row) const noexcept {
+    return p->has_thumbnail[row];
+}
+
+uint64_t MediaFileBatch::getModificationTime(size_t row) const noexcept {
+    return p->modification_time[row];
+}
+
+MediaType MediaFileBatch::getType(size_t row) const noexcept {
+    return p->type[row];
+}
+
+std::string MediaFileBatch::getUri(size_t row) const {
+    return mediascanner::getUri(getText(row, FileName));
+}
+
+std::string MediaFileBatch::getArtUri(size_t row) const {
+    return make_art_uri(getType(row), getHasThumbnail(row),
+                        getText(row, FileName),
+                        getString(row, Author), getString(row, Album));
+}
+
+MediaFile MediaFileBatch::getMediaFile(size_t row) const {
+    return MediaFileBuilder(getString(row, FileName))
+        .setContentType(getString(row, ContentType))
+        .setETag(getString(row, ETag))
+        .setTitle(getString(row, Title))
+        .setDate(getString(row, Date))
+        .setAuthor(getString(row, Author))
+        .setAlbum(getString(row, Album))
+        .setAlbumArtist(getString(row, AlbumArtist))
+        .setGenre(getString(row, Genre))
+        .setDiscNumber(getDiscNumber(row))
+        .setTrackNumber(getTrackNumber(row))
+        .setDuration(getDuration(row))
+        .setWidth(getWidth(row))
+        .setHeight(getHeight(row))
+        .setLatitude(getLatitude(row))
+        .setLongitude(getLongitude(row))
+        .setHasThumbnail(getHasThumbnail(row))
+        .setModificationTime(getModificationTime(row))
+        .setType(getType(row));
+}
+
+void MediaFileBatch::appendText(const char *text, size_t length) {
+    const size_t row = p->text_offsets.size() / Private::NUM_TEXT_FIELDS;
+    const int field = p->text_offsets.size() % Private::NUM_TEXT_FIELDS;
+    if (p->text.size() + length >= numeric_limits<uint32_t>::max()) {
+        throw length_error("MediaFileBatch text is too long");
+    }
+    if (length == 0 && field == Title) {
+        const string title = filenameToTitle(getText(row, FileName));
+        p->text_offsets.push_back(p->text.size());
+        p->text.append(title.c_str(), title.size() + 1);
+        return;
+    }
+    p->text_offsets.push_back(p->text.size());
+    if (length == 0 && field == AlbumArtist) {
+        // Copy the author, which is already in the buffer.
+        length = getTextLength(row, Author);
+        p->text.reserve(p->text.size() + length + 1);
+        text = getText(row, Author);
+    }
+    p->text.append(text, length);
+    p->text.push_back('\0');
+}
+
+void MediaFileBatch::appendNumbers(int disc_number, int track_number, int duration,
+                                   int width, int height,
+                                   double latitude, double longitude,
+                                   bool has_thumbnail, uint64_t modification_time,
+                                   MediaType type) {
+    p->disc_number.push_back(disc_number);
+    p->track_number.push_back(track_number);
+    p->duration.push_back(duration);
+    p->width.push_back(width);
+    p->height.push_back(height);
+    p->latitude.push_back(latitude);
+    p->longitude.push_back(longitude);
+    p->has_thumbnail.push_back(has_thumbnail);
+    p->modification_time.push_back(modification_time);
+    p->type.push_back(type);
+}
+
+void MediaFileBatch::append(const MediaFile &file) {
+    for (const string *value : {
+            &file.getFileName(), &file.getContentType(), &file.getETag(),
+            &file.getTitle(), &file.getDate(), &file.getAuthor(),
+            &file.getAlbum(), &file.getAlbumArtist(), &file.getGenre()}) {
+        appendText(value->c_str(), value->size());
+    }
+    appendNumbers(file.getDiscNumber(), file.getTrackNumber(),
+                  file.getDuration(), file.getWidth(), file.getHeight(),
+                  file.getLatitude(), file.getLongitude(),
+                  file.getHasThumbnail(), file.getModificationTime(),
+                  file.getType());
+}
+
+template <typename T>
+static void extend(vector<T> &a, const vector<T> &b) {
+    a.insert(a.end(), b.begin(), b.end());
+}
+
+void MediaFileBatch::append(const MediaFileBatch &other) {
+    if (this == &other) {
+        MediaFileBatch copy(other);
+        append(copy);
+        return;
+    }
+    const Private &o = *other.p;
+    if (p->text.size() + o.text.size() >= numeric_limits<uint32_t>::max()) {
+        throw length_error("MediaFileBatch text is too long");
+    }
+    const uint32_t shift = p->text.size();
+    p->text += o.text;
+    p->text_offsets.reserve(p->text_offsets.size() + o.text_offsets.size());
+    for (uint32_t offset : o.text_offsets) {
+        p->text_offsets.push_back(offset + shift);
+    }
+    extend(p->disc_number, o.disc_number);
+    extend(p->track_number, o.track_number);
+    extend(p->duration, o.duration);
+    extend(p->width, o.width);
+    extend(p->height, o.height);
+    extend(p->latitude, o.latitude);
+    extend(p->longitude, o.longitude);
+    extend(p->has_thumbnail, o.has_thumbnail);
+    extend(p->modification_time, o.modification_time);
+    extend(p->type, o.type);
+}
+
+void MediaFileBatch::clear() {
+    *p = Private();
+}
+
+bool MediaFileBatch::operator==(const MediaFileBatch &other) const {
+    return
+        p->text == other.p->text &&
+        p->text_offsets == other.p->text_offsets &&
+        p->disc_number == other.p->disc_number &&
+        p->track_number == other.p->track_number &&
+        p->duration == other.p->duration &&
+        p->width == other.p->width &&
+        p->height == other.p->height &&
+        p->latitude == other.p->latitude &&
+        p->longitude == other.p->longitude &&
+        p->has_thumbnail == other.p->has_thumbnail &&
+        p->modification_time == other.p->modification_time &&
+        p->type == other.p->type;
+}
+
+bool MediaFileBatch::operator!=(const MediaFileBatch &other) const {
+    return !(*this == other);
+}
+
+}
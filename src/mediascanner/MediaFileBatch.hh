@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEDIAFILEBATCH_HH
+#define MEDIAFILEBATCH_HH
+
+#include "scannercore.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mediascanner {
+
+class MediaFile;
+
+// A list of media files stored by column rather than as separate
+// MediaFile objects: the text of every row lives in one buffer, and
+// the numeric fields in one array each.  Filling or reading one does
+// not allocate per row, which matters when streaming whole libraries
+// into a model.
+//
+// Rows are indexed from 0 to size() - 1; the accessors do not check
+// the index.
+class MediaFileBatch final {
+public:
+    enum Field {
+        FileName,
+        ContentType,
+        ETag,
+        Title,
+        Date,
+        Author,
+        Album,
+        AlbumArtist,
+        Genre,
+    };
+
+    MediaFileBatch();
+    explicit MediaFileBatch(const std::vector<MediaFile> &files);
+    MediaFileBatch(const MediaFileBatch &other);
+    MediaFileBatch(MediaFileBatch &&other);
+    ~MediaFileBatch();
+
+    MediaFileBatch &operator=(const MediaFileBatch &other);
+    MediaFileBatch &operator=(MediaFileBatch &&other);
+
+    size_t size() const noexcept;
+    bool empty() const noexcept;
+
+    // The field's text, nul terminated.  The pointer is valid until
+    // the batch is next modified.
+    const char *getText(size_t row, Field field) const noexcept;
+    size_t getTextLength(size_t row, Field field) const noexcept;
+    std::string getString(size_t row, Field field) const;
+
+    int getDiscNumber(size_t row) const noexcept;
+    int getTrackNumber(size_t row) const noexcept;
+    int getDuration(size_t row) const noexcept;
+    int getWidth(size_t row) const noexcept;
+    int getHeight(size_t row) const noexcept;
+    double getLatitude(size_t row) const noexcept;
+    double getLongitude(size_t row) const noexcept;
+    bool getHasThumbnail(size_t row) const noexcept;
+    uint64_t getModificationTime(size_t row) const noexcept;
+    MediaType getType(size_t row) const noexcept;
+    std::string getUri(size_t row) const;
+    std::string getArtUri(size_t row) const;
+
+    // Build a MediaFile from a row, for the few users that need one.
+    MediaFile getMediaFile(size_t row) const;
+
+    void append(const MediaFile &file);
+    void append(const MediaFileBatch &other);
+    // Add a row field by field, without building a MediaFile: call
+    // appendText() for each Field in order, then appendNumbers().  An
+    // empty title or album artist gets the same fallback as in a
+    // MediaFile.
+    void appendText(const char *text, size_t length);
+    void appendNumbers(int disc_number, int track_number, int duration,
+                       int width, int height,
+                       double latitude, double longitude,
+                       bool has_thumbnail, uint64_t modification_time,
+                       MediaType type);
+    void clear();
+
+    bool operator==(const MediaFileBatch &other) const;
+    bool operator!=(const MediaFileBatch &other) const;
+
+private:
+    struct Private;
+    Private *p;
+};
+
+}
+
+#endif
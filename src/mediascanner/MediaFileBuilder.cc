@@ -50,7 +50,7 @@ MediaFileBuilder &MediaFileBuilder::setETag(const std::string &e) {
 }
 
 MediaFileBuilder &MediaFileBuilder::setContentType(const std::string &c) {
-    p->content_type = c;
+    p->content_type = InternedString(c);
     return *this;
 }
 
@@ -65,22 +65,22 @@ MediaFileBuilder &MediaFileBuilder::setDate(const std::string &d) {
 }
 
 MediaFileBuilder &MediaFileBuilder::setAuthor(const std::string &a) {
-    p->author = a;
+    p->author = InternedString(a);
     return *this;
 }
 
 MediaFileBuilder &MediaFileBuilder::setAlbum(const std::string &a) {
-    p->album = a;
+    p->album = InternedString(a);
     return *this;
 }
 
 MediaFileBuilder &MediaFileBuilder::setAlbumArtist(const std::string &a) {
-    p->album_artist = a;
+    p->album_artist = InternedString(a);
     return *this;
 }
 
 MediaFileBuilder &MediaFileBuilder::setGenre(const std::string &g) {
-    p->genre = g;
+    p->genre = InternedString(g);
     return *this;
 }
 
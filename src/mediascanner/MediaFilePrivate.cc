@@ -20,6 +20,7 @@
 
 #include "scannercore.hh"
 #include "internal/MediaFilePrivate.hh"
+#include "internal/FolderArtCache.hh"
 #include "internal/utils.hh"
 
 namespace mediascanner {
@@ -70,5 +71,25 @@ void MediaFilePrivate::setFallbackMetadata() {
     }
 }
 
+std::string make_art_uri(MediaType type, bool has_thumbnail,
+                         const std::string &filename,
+                         const std::string &author, const std::string &album) {
+    switch (type) {
+    case AudioMedia: {
+        if (has_thumbnail) {
+            return make_thumbnail_uri(getUri(filename));
+        }
+        auto standalone = FolderArtCache::get().get_art_for_file(filename);
+        if(!standalone.empty()) {
+            return make_thumbnail_uri(getUri(standalone));
+        }
+        return make_album_art_uri(author, album);
+    }
+
+    default:
+        return make_thumbnail_uri(getUri(filename));
+    }
+}
+
 
 }
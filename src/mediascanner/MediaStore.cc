@@ -21,22 +21,35 @@
 
 #include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <condition_variable>
+#include <functional>
 #include <stdexcept>
 #include <mutex>
-#include <sstream>
-#include <map>
+#include <thread>
+#include <memory>
 
 #include <glib.h>
 #include <sqlite3.h>
 
-#include "mozilla/fts3_tokenizer.h"
+#include "MediaChange.hh"
 #include "MediaFile.hh"
+#include "MediaFileBatch.hh"
 #include "MediaFileBuilder.hh"
 #include "Album.hh"
 #include "Filter.hh"
+#include "Folder.hh"
+#include "internal/ExtractionJournal.hh"
+#include "internal/KnownFiles.hh"
+#include "internal/fts.hh"
+#include "internal/prune.hh"
+#include "internal/ResultCache.hh"
 #include "internal/sqliteutils.hh"
 #include "internal/utils.hh"
 
@@ -44,223 +57,189 @@ using namespace std;
 
 namespace mediascanner {
 
-// Increment this whenever changing db schema.
-// It will cause dbstore to rebuild its tables.
-static const int schemaVersion = 10;
+// Increment this whenever changing db schema, and add a step to
+// migrations below that brings a database from the previous version.
+// Without one, dbstore rebuilds its tables.
+static const int schemaVersion = 19;
+
+// Without token positions the search index is about a fifth
+// smaller, but bm25() ranks matches several times slower.  Queries
+// never contain phrases, so either works.
+#ifdef MEDIASCANNER_FTS_DETAIL_COLUMN
+#define FTS_DETAIL "column"
+#else
+#define FTS_DETAIL "full"
+#endif
+
+// A region of latitudes and longitudes, in degrees.  It crosses the
+// 180th meridian when west is greater than east.
+struct GeoBox {
+    double south, west, north, east;
+};
 
 struct MediaStorePrivate {
-    sqlite3 *db;
+    sqlite3 *db = nullptr;
     // https://www.sqlite.org/cvstrac/wiki?p=DatabaseIsLocked
     // http://sqlite.com/faq.html#q6
     std::mutex dbMutex;
+    // Prepared statements reused across calls.  Must be cleared
+    // before the database is closed.
+    std::unique_ptr<StatementCache> statements;
+
+    std::string filename;
+    OpenType access_type;
+    // The writer keeps its database in WAL mode, which readers could
+    // only use with write access to the cache directory.  Instead it
+    // publishes a read only copy of the database next to it, which is
+    // atomically replaced whenever it is updated.
+    std::string snapshot;
+    SnapshotId snapshot_id;
+    int published_changes = -1;
+    // The directory of the last file inserted, as most files are
+    // inserted next to the one before.  Cleared on rollback.
+    mutable std::string last_directory;
+    mutable int64_t last_directory_id = -1;
+
+    // Read only stores keep a pool of connections, so queries from
+    // different threads can run in parallel.  This store's own
+    // connection is the first member of the pool.
+    class Reader;
+    std::mutex poolMutex;
+    std::condition_variable poolAvailable;
+    std::vector<MediaStorePrivate*> idleReaders;
+    std::vector<std::unique_ptr<MediaStorePrivate>> extraReaders;
+    size_t maxReaders = 1;
+    // Results of recent queries on a read only store, shared by the
+    // pool.  Off unless given a size.
+    ResultCache cache;
+    // The files a read write store's user is extracting, in case the
+    // extractor crashes on one.
+    std::unique_ptr<ExtractionJournal> extracting;
+    // How far runMaintenance() got: the task, and the step within it.
+    int maintenance_task = 0;
+    size_t maintenance_step = 0;
+
+    ~MediaStorePrivate();
+    Reader acquireReader();
+    void releaseReader(MediaStorePrivate *reader);
+
+    void open();
+    void close();
+    void checkSchemaVersion() const;
+    bool migrateSchema(int version);
+    void openExtractionJournal();
+    void checkSnapshot();
+    void publishSnapshot();
+    DataVersion dataVersion() const;
 
     void insert(const MediaFile &m) const;
     void remove(const std::string &fname) const;
+    void insertBatch(const std::vector<MediaFile> &files) const;
+    void removeBatch(const std::vector<std::string> &filenames) const;
     void insert_broken_file(const std::string &fname, const std::string &etag) const;
     void remove_broken_file(const std::string &fname) const;
+    void remove_broken_files(const std::vector<MediaFile> &files) const;
     bool is_broken_file(const std::string &fname, const std::string &etag) const;
+    KnownFiles getKnownFiles(const std::string &directory) const;
     MediaFile lookup(const std::string &filename) const;
-    std::vector<MediaFile> query(const std::string &q, MediaType type, const Filter &filter) const;
+    std::vector<MediaFile> lookupMany(const std::vector<std::string> &filenames) const;
+    // query() and listSongs() call emit on each row, which has the
+    // columns make_media() reads, and stop if it returns false.
+    void query(const std::string &q, MediaType type, const Filter &filter,
+               const std::function<bool(Statement&)> &emit) const;
+    void listMedia(MediaType type, const Filter &filter,
+                   const std::function<bool(Statement&)> &emit) const;
     std::vector<Album> queryAlbums(const std::string &core_term, const Filter &filter) const;
     std::vector<string> queryArtists(const std::string &q, const Filter &filter) const;
     std::vector<MediaFile> getAlbumSongs(const Album& album) const;
     std::string getETag(const std::string &filename) const;
-    std::vector<MediaFile> listSongs(const Filter &filter) const;
+    void listSongs(const Filter &filter,
+                   const std::function<bool(Statement&)> &emit) const;
+    void queryBoundingBox(const GeoBox &box, MediaType type, const Filter &filter,
+                          const std::function<bool(Statement&)> &emit) const;
+    std::vector<MediaFile> queryNearest(double latitude, double longitude, MediaType type, const Filter &filter) const;
+    std::vector<TimelineEntry> timeline(MediaType type, TimelineInterval interval, const Filter &filter) const;
     std::vector<Album> listAlbums(const Filter &filter) const;
     std::vector<std::string> listArtists(const Filter &filter) const;
     std::vector<std::string> listAlbumArtists(const Filter &filter) const;
     std::vector<std::string> listGenres(const Filter &filter) const;
     bool hasMedia(MediaType type) const;
+    int64_t count(MediaType type, const Filter &filter) const;
+    Aggregate aggregate(const Filter &filter) const;
+    std::vector<Facet> facets(FacetField field, const Filter &filter) const;
+    Folder listFolder(const std::string &path, const Filter &filter) const;
+    int64_t getChangeSequence() const;
+    std::vector<MediaChange> getChangesSince(int64_t sequence) const;
+    std::vector<MediaType> getChangedTypesSince(int64_t sequence) const;
+    void checkChangesSince(int64_t sequence) const;
+    void trimChanges(size_t max_changes, int max_age);
+    int64_t directoryId(const std::string &path, bool create) const;
 
     size_t size() const;
-    void pruneDeleted();
+    std::vector<std::string> listFilenames() const;
+    void prune(const PrunePlan &plan);
     void archiveItems(const std::string &prefix);
     void restoreItems(const std::string &prefix);
     void removeSubtree(const std::string &directory);
+    void removeEmptyDirectories(int64_t dir_id);
+    void enableIncrementalVacuum();
+    bool maintain();
+    DatabaseStats getDatabaseStats() const;
 
     void begin();
     void commit();
     void rollback();
-};
-
-extern "C" void sqlite3Fts3PorterTokenizerModule(
-    sqlite3_tokenizer_module const**ppModule);
-
-static void register_tokenizer(sqlite3 *db) {
-    Statement query(db, "SELECT fts3_tokenizer(?, ?)");
-
-    query.bind(1, "mozporter");
-    const sqlite3_tokenizer_module *p = nullptr;
-    sqlite3Fts3PorterTokenizerModule(&p);
-    query.bind(2, &p, sizeof(p));
-
-    query.step();
-}
-
-/* ranking function adapted from http://sqlite.org/fts3.html#appendix_a */
-static void rankfunc(sqlite3_context *pCtx, int nVal, sqlite3_value **apVal) {
-    const int32_t *aMatchinfo;      /* Return value of matchinfo() */
-    int32_t nCol;                   /* Number of columns in the table */
-    int32_t nPhrase;                /* Number of phrases in the query */
-    int32_t iPhrase;                /* Current phrase */
-    double score = 0.0;             /* Value to return */
-
-    /* Check that the number of arguments passed to this function is correct.
-    ** If not, jump to wrong_number_args. Set aMatchinfo to point to the array
-    ** of unsigned integer values returned by FTS function matchinfo. Set
-    ** nPhrase to contain the number of reportable phrases in the users full-text
-    ** query, and nCol to the number of columns in the table.
-    */
-    if( nVal<1 ) goto wrong_number_args;
-    aMatchinfo = static_cast<const int32_t*>(sqlite3_value_blob(apVal[0]));
-    nPhrase = aMatchinfo[0];
-    nCol = aMatchinfo[1];
-    if( nVal!=(1+nCol) ) goto wrong_number_args;
-
-    /* Iterate through each phrase in the users query. */
-    for(iPhrase=0; iPhrase<nPhrase; iPhrase++){
-        int32_t iCol;                     /* Current column */
-
-        /* Now iterate through each column in the users query. For each column,
-        ** increment the relevancy score by:
-        **
-        **   (<hit count> / <global hit count>) * <column weight>
-        **
-        ** aPhraseinfo[] points to the start of the data for phrase iPhrase. So
-        ** the hit count and global hit counts for each column are found in
-        ** aPhraseinfo[iCol*3] and aPhraseinfo[iCol*3+1], respectively.
-        */
-        const int32_t *aPhraseinfo = &aMatchinfo[2 + iPhrase*nCol*3];
-        for(iCol=0; iCol<nCol; iCol++){
-            int32_t nHitCount = aPhraseinfo[3*iCol];
-            int32_t nGlobalHitCount = aPhraseinfo[3*iCol+1];
-            double weight = sqlite3_value_double(apVal[iCol+1]);
-            if( nHitCount>0 ){
-                score += ((double)nHitCount / (double)nGlobalHitCount) * weight;
-            }
-        }
-    }
-
-    sqlite3_result_double(pCtx, score);
-    return;
-
-    /* Jump here if the wrong number of arguments are passed to this function */
-wrong_number_args:
-    sqlite3_result_error(pCtx, "wrong number of arguments to function rank()", -1);
-}
 
-struct FirstContext {
-    int type;
-    union {
-        int i;
-        double f;
-        struct {
-            void *blob;
-            int length;
-        } b;
-    } data;
+    void savepoint(const char *name) const;
+    void release(const char *name) const;
+    void rollback_to(const char *name) const;
 };
 
-static void first_step(sqlite3_context *ctx, int /*argc*/, sqlite3_value **argv) {
-    FirstContext *d = static_cast<FirstContext*>(sqlite3_aggregate_context(ctx, sizeof(FirstContext*)));
-    if (d->type != 0) {
-        return;
-    }
-    sqlite3_value *arg = argv[0];
-    d->type = sqlite3_value_type(arg);
-    switch (d->type) {
-    case SQLITE_INTEGER:
-        d->data.i = sqlite3_value_int(arg);
-        break;
-    case SQLITE_FLOAT:
-        d->data.f = sqlite3_value_double(arg);
-        break;
-    case SQLITE_NULL:
-        break;
-    case SQLITE_TEXT:
-        d->data.b.length = sqlite3_value_bytes(arg);
-        d->data.b.blob = malloc(d->data.b.length);
-        memcpy(d->data.b.blob, sqlite3_value_text(arg), d->data.b.length);
-        break;
-    case SQLITE_BLOB:
-        d->data.b.length = sqlite3_value_bytes(arg);
-        d->data.b.blob = malloc(d->data.b.length);
-        memcpy(d->data.b.blob, sqlite3_value_blob(arg), d->data.b.length);
-        break;
-    default:
-        sqlite3_result_error(ctx, "Unhandled data type", -1);
-        sqlite3_result_error_code(ctx, SQLITE_MISMATCH);
-    }
-}
-
-static void first_finalize(sqlite3_context *ctx) {
-    FirstContext *d = static_cast<FirstContext*>(sqlite3_aggregate_context(ctx, 0));
-    if (d == nullptr) {
-        sqlite3_result_null(ctx);
-        return;
+// Exclusive use of one of a store's connections for the duration of
+// a read.  Read write stores only have the one connection.
+class MediaStorePrivate::Reader final {
+public:
+    Reader(MediaStorePrivate *pool, MediaStorePrivate *store)
+        : pool(pool), store(store), lock(store->dbMutex) {}
+    Reader(Reader &&other)
+        : pool(other.pool), store(other.store), lock(std::move(other.lock)) {
+        other.pool = nullptr;
     }
-    switch (d->type) {
-    case SQLITE_INTEGER:
-        sqlite3_result_int(ctx, d->data.i);
-        break;
-    case SQLITE_FLOAT:
-        sqlite3_result_double(ctx, d->data.f);
-        break;
-    case SQLITE_NULL:
-        sqlite3_result_null(ctx);
-        break;
-    case SQLITE_TEXT:
-        sqlite3_result_text(ctx, reinterpret_cast<char*>(d->data.b.blob),
-                            d->data.b.length, free);
-        d->data.b.blob = nullptr;
-        break;
-    case SQLITE_BLOB:
-        sqlite3_result_blob(ctx, d->data.b.blob, d->data.b.length, free);
-        d->data.b.blob = nullptr;
-        break;
-    default:
-        sqlite3_result_error(ctx, "Unhandled data type", -1);
-        sqlite3_result_error_code(ctx, SQLITE_MISMATCH);
-    }
-}
-
-static bool has_block_in_path(std::map<std::string, bool> &cache, const std::string &filename) {
-    std::vector<std::string> path_segments;
-    std::istringstream f(filename);
-    std::string s;
-    while (std::getline(f, s, '/')) {
-        path_segments.push_back(s);
-    }
-    path_segments.pop_back();
-    std::string trial_path;
-    for(const auto &seg : path_segments) {
-        if(trial_path != "/")
-            trial_path += "/";
-        trial_path += seg;
-        auto r = cache.find(trial_path);
-        if(r != cache.end() && r->second) {
-            return true;
+    Reader(const Reader &other) = delete;
+    Reader &operator=(const Reader &other) = delete;
+    ~Reader() {
+        if (lock.owns_lock()) {
+            lock.unlock();
         }
-        if(has_scanblock(trial_path)) {
-            cache[trial_path] = true;
-            return true;
-        } else {
-            cache[trial_path] = false;
+        if (pool) {
+            pool->releaseReader(store);
         }
     }
-    return false;
-}
 
-static void register_functions(sqlite3 *db) {
-    if (sqlite3_create_function(db, "rank", -1, SQLITE_ANY, nullptr,
-                                rankfunc, nullptr, nullptr) != SQLITE_OK) {
-        throw runtime_error(sqlite3_errmsg(db));
+    MediaStorePrivate *operator->() const {
+        return store;
+    }
+    MediaStorePrivate &operator*() const {
+        return *store;
     }
 
-    if (sqlite3_create_function(db, "first", 1, SQLITE_ANY, nullptr,
-                                nullptr, first_step, first_finalize) != SQLITE_OK) {
-        throw runtime_error(sqlite3_errmsg(db));
+private:
+    MediaStorePrivate *pool;
+    MediaStorePrivate *store;
+    std::unique_lock<std::mutex> lock;
+};
+
+/* Back off exponentially while the database is locked, rather than
+ * spinning: 1, 2, 4, ... 64ms, then 100ms per retry, giving up after
+ * about ten seconds. */
+static int busy_handler(void * /*data*/, int count) {
+    const int max_retries = 106;
+    if (count >= max_retries) {
+        return 0;
     }
+    const int delay_ms = count < 7 ? 1 << count : 100;
+    usleep(delay_ms * 1000);
+    return 1;
 }
 
 static void execute_sql(sqlite3 *db, const string &cmd) {
@@ -289,10 +268,248 @@ DROP TABLE IF EXISTS media_fts;
 DROP TABLE IF EXISTS media_attic;
 DROP TABLE IF EXISTS schemaVersion;
 DROP TABLE IF EXISTS broken_files;
+DROP TABLE IF EXISTS album_summary;
+DROP TABLE IF EXISTS artist_summary;
+DROP TABLE IF EXISTS album_artist_summary;
+DROP TABLE IF EXISTS genre_summary;
+DROP TABLE IF EXISTS media_type_summary;
+DROP TABLE IF EXISTS directories;
+DROP TABLE IF EXISTS media_changes;
+DROP TABLE IF EXISTS media_location;
 )");
     execute_sql(db, deleteCmd);
 }
 
+// Recompute the album_summary row for the album of a trigger's
+// old or new row.  The album's details are taken from its first
+// track.
+static string refresh_album_summary(const string &row) {
+    const string match = "type = 1 AND album_artist = " + row + ".album_artist AND album = " + row + ".album";
+    return
+        "  DELETE FROM album_summary WHERE album = " + row + ".album AND album_artist = " + row + ".album_artist;\n"
+        "  INSERT INTO album_summary (album, album_artist, track_count, duration, date, genre, filename, has_thumbnail, mtime)\n"
+        "    SELECT album, album_artist, (SELECT count(*) FROM media WHERE " + match + "),\n"
+        "      (SELECT ifnull(sum(duration), 0) FROM media WHERE " + match + "), date, genre, filename, has_thumbnail, mtime\n"
+        "    FROM media WHERE " + match + "\n"
+        "    ORDER BY disc_number, track_number, title, filename LIMIT 1;\n";
+}
+
+// Add or remove a trigger's old or new row from the count and total
+// duration of the summary row with the same key columns.
+static string count_in_summary(const string &table, const vector<string> &key_columns,
+                               const string &count_column, const string &row, bool add) {
+    string columns, values, key;
+    for (const auto &column : key_columns) {
+        if (!key.empty()) {
+            columns += ", ";
+            values += ", ";
+            key += " AND ";
+        }
+        columns += column;
+        values += row + "." + column;
+        key += column + " = " + row + "." + column;
+    }
+    const string sign = add ? " + " : " - ";
+    string sql;
+    if (add) {
+        // Not "INSERT OR IGNORE": the conflict clause of the
+        // statement firing the trigger would override it.
+        sql += "  INSERT INTO " + table + " (" + columns + ", " + count_column + ", duration) SELECT " + values + ", 0, 0\n"
+            "    WHERE NOT EXISTS (SELECT 1 FROM " + table + " WHERE " + key + ");\n";
+    }
+    sql += "  UPDATE " + table + " SET " + count_column + " = " + count_column + sign + "1, "
+        "duration = duration" + sign + "ifnull(" + row + ".duration, 0) WHERE " + key + ";\n";
+    if (!add) {
+        sql += "  DELETE FROM " + table + " WHERE " + key + " AND " + count_column + " = 0;\n";
+    }
+    return sql;
+}
+
+// Add or remove a track from the artist, album artist and genre
+// track counts of a trigger's old or new row.
+static string count_track(const string &row, bool add) {
+    static const vector<pair<string, vector<string>>> summaries = {
+        {"artist_summary", {"artist", "genre"}},
+        {"album_artist_summary", {"album_artist", "genre"}},
+        {"genre_summary", {"genre"}},
+    };
+    string sql;
+    for (const auto &summary : summaries) {
+        sql += count_in_summary(summary.first, summary.second, "track_count", row, add);
+    }
+    return sql;
+}
+
+static const char directories_schema[] = R"(
+-- The directories holding media, so operations on a subtree can
+-- follow parent_id rather than matching filename prefixes.  The
+-- root directory has id 1 and an empty name.
+CREATE TABLE directories (
+    id INTEGER PRIMARY KEY,
+    parent_id INTEGER REFERENCES directories(id),
+    name TEXT NOT NULL,
+    mtime INTEGER
+);
+CREATE UNIQUE INDEX directories_parent_idx ON directories(parent_id, name);
+INSERT INTO directories (id, parent_id, name, mtime) VALUES (1, NULL, '', 0);
+)";
+
+static const char media_fts_schema[] = R"(
+-- Prefix indexes serve the as-you-type queries of one to three
+-- characters.
+CREATE VIRTUAL TABLE media_fts
+USING fts5(title, artist, album, content='media', content_rowid='id',
+           tokenize=mozporter, prefix='1 2 3', detail=)" FTS_DETAIL R"();
+
+CREATE TRIGGER media_au AFTER UPDATE ON media BEGIN
+  INSERT INTO media_fts(media_fts, rowid, title, artist, album) VALUES ('delete', old.id, old.title, old.artist, old.album);
+  INSERT INTO media_fts(rowid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);
+END;
+
+CREATE TRIGGER media_ad AFTER DELETE ON media BEGIN
+  INSERT INTO media_fts(media_fts, rowid, title, artist, album) VALUES ('delete', old.id, old.title, old.artist, old.album);
+END;
+
+CREATE TRIGGER media_ai AFTER INSERT ON media BEGIN
+  INSERT INTO media_fts(rowid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);
+END;
+)";
+
+static const char media_changes_schema[] = R"(
+-- A journal of changes to media, so clients can catch up on what
+-- changed since they last looked rather than reloading everything.
+-- AUTOINCREMENT keeps sequence numbers increasing even once the
+-- journal has been trimmed empty.
+CREATE TABLE media_changes (
+    seq INTEGER PRIMARY KEY AUTOINCREMENT,
+    media_id INTEGER NOT NULL,
+    filename TEXT NOT NULL,
+    type INTEGER NOT NULL,
+    change INTEGER NOT NULL, -- ChangeKind enum
+    time INTEGER NOT NULL
+);
+CREATE INDEX media_changes_time_idx ON media_changes(time);
+
+-- INSERT OR REPLACE deletes the old row before inserting the new
+-- one, which gets a new media_id, so an insert straight after the
+-- deletion of the same file is journaled as a single update.
+CREATE TRIGGER media_changes_ai AFTER INSERT ON media BEGIN
+  INSERT INTO media_changes (media_id, filename, type, change, time)
+    SELECT new.id, new.filename, new.type,
+      CASE WHEN EXISTS (
+        SELECT 1 FROM media_changes
+          WHERE seq = (SELECT max(seq) FROM media_changes)
+            AND change = 2 AND filename = new.filename) THEN 1 ELSE 0 END,
+      strftime('%s', 'now');
+  DELETE FROM media_changes
+    WHERE seq = (SELECT max(seq) FROM media_changes
+                   WHERE seq < (SELECT max(seq) FROM media_changes))
+      AND change = 2 AND filename = new.filename;
+END;
+
+CREATE TRIGGER media_changes_au AFTER UPDATE ON media BEGIN
+  INSERT INTO media_changes (media_id, filename, type, change, time)
+    VALUES (new.id, new.filename, new.type, 1, strftime('%s', 'now'));
+END;
+
+CREATE TRIGGER media_changes_ad AFTER DELETE ON media BEGIN
+  INSERT INTO media_changes (media_id, filename, type, change, time)
+    VALUES (old.id, old.filename, old.type, 2, strftime('%s', 'now'));
+END;
+)";
+
+static const char media_location_schema[] = R"(
+-- Where each geotagged file was taken, so map views can find the
+-- media in a region without scanning media.  A point is a box of no
+-- size.  Files without a location have a latitude and longitude of
+-- 0, and are left out.
+CREATE VIRTUAL TABLE media_location
+USING rtree(id, min_latitude, max_latitude, min_longitude, max_longitude);
+
+CREATE TRIGGER media_location_ai AFTER INSERT ON media
+  WHEN new.latitude <> 0 OR new.longitude <> 0 BEGIN
+  INSERT INTO media_location VALUES (new.id, new.latitude, new.latitude, new.longitude, new.longitude);
+END;
+
+CREATE TRIGGER media_location_au AFTER UPDATE ON media BEGIN
+  DELETE FROM media_location WHERE id = old.id;
+  INSERT INTO media_location
+    SELECT new.id, new.latitude, new.latitude, new.longitude, new.longitude
+    WHERE new.latitude <> 0 OR new.longitude <> 0;
+END;
+
+CREATE TRIGGER media_location_ad AFTER DELETE ON media BEGIN
+  DELETE FROM media_location WHERE id = old.id;
+END;
+)";
+
+static string summary_schema() {
+    string schema(R"(
+-- Summaries of the songs in media, kept up to date by the triggers
+-- below so listing albums, artists and genres need not scan media.
+CREATE TABLE album_summary (
+    album TEXT,
+    album_artist TEXT,
+    track_count INTEGER,
+    duration INTEGER,
+    date TEXT,            -- The remaining columns are from the first track
+    genre TEXT,
+    filename TEXT,
+    has_thumbnail INTEGER,
+    mtime INTEGER,
+    PRIMARY KEY (album, album_artist)
+);
+
+CREATE TABLE artist_summary (
+    artist TEXT,
+    genre TEXT,
+    track_count INTEGER,
+    duration INTEGER,
+    PRIMARY KEY (artist, genre)
+);
+CREATE INDEX artist_summary_genre_idx ON artist_summary(genre, artist);
+
+CREATE TABLE album_artist_summary (
+    album_artist TEXT,
+    genre TEXT,
+    track_count INTEGER,
+    duration INTEGER,
+    PRIMARY KEY (album_artist, genre)
+);
+CREATE INDEX album_artist_summary_genre_idx ON album_artist_summary(genre, album_artist);
+
+CREATE TABLE genre_summary (
+    genre TEXT PRIMARY KEY,
+    track_count INTEGER,
+    duration INTEGER
+);
+
+-- The number and total duration of media of each type, so counting
+-- them need not scan media.
+CREATE TABLE media_type_summary (
+    type INTEGER PRIMARY KEY,
+    media_count INTEGER,
+    duration INTEGER
+);
+)");
+    schema += "CREATE TRIGGER media_type_summary_ai AFTER INSERT ON media BEGIN\n" +
+        count_in_summary("media_type_summary", {"type"}, "media_count", "new", true) + "END;\n";
+    schema += "CREATE TRIGGER media_type_summary_ad AFTER DELETE ON media BEGIN\n" +
+        count_in_summary("media_type_summary", {"type"}, "media_count", "old", false) + "END;\n";
+    schema += "CREATE TRIGGER media_type_summary_au AFTER UPDATE ON media BEGIN\n" +
+        count_in_summary("media_type_summary", {"type"}, "media_count", "old", false) +
+        count_in_summary("media_type_summary", {"type"}, "media_count", "new", true) + "END;\n";
+    schema += "CREATE TRIGGER media_summary_ai AFTER INSERT ON media WHEN new.type = 1 BEGIN\n" +
+        refresh_album_summary("new") + count_track("new", true) + "END;\n";
+    schema += "CREATE TRIGGER media_summary_ad AFTER DELETE ON media WHEN old.type = 1 BEGIN\n" +
+        refresh_album_summary("old") + count_track("old", false) + "END;\n";
+    schema += "CREATE TRIGGER media_summary_au_old AFTER UPDATE ON media WHEN old.type = 1 BEGIN\n" +
+        refresh_album_summary("old") + count_track("old", false) + "END;\n";
+    schema += "CREATE TRIGGER media_summary_au_new AFTER UPDATE ON media WHEN new.type = 1 BEGIN\n" +
+        refresh_album_summary("new") + count_track("new", true) + "END;\n";
+    return schema;
+}
+
 void createTables(sqlite3 *db) {
     string schema(R"(
 CREATE TABLE schemaVersion (version INTEGER);
@@ -317,14 +534,19 @@ CREATE TABLE media (
     longitude DOUBLE,
     has_thumbnail INTEGER CHECK (has_thumbnail IN (0, 1)),
     mtime INTEGER,
-    type INTEGER CHECK (type IN (1, 2, 3)) -- MediaType enum
+    type INTEGER CHECK (type IN (1, 2, 3)), -- MediaType enum
+    dir_id INTEGER REFERENCES directories(id),
+    date_epoch INTEGER    -- date in seconds since the epoch, if it parses
 );
 
 CREATE INDEX media_type_idx ON media(type);
-CREATE INDEX media_song_info_idx ON media(type, album_artist, album, disc_number, track_number, title) WHERE type = 1;
+CREATE INDEX media_song_info_idx ON media(type, album_artist, album, disc_number, track_number, title, filename) WHERE type = 1;
 CREATE INDEX media_artist_idx ON media(type, artist) WHERE type = 1;
 CREATE INDEX media_genre_idx ON media(type, genre) WHERE type = 1;
-CREATE INDEX media_mtime_idx ON media(type, mtime);
+CREATE INDEX media_mtime_idx ON media(type, mtime, filename);
+CREATE INDEX media_dir_idx ON media(dir_id, filename);
+CREATE INDEX media_date_idx ON media(type, date_epoch, filename);
+CREATE INDEX media_title_idx ON media(type, title, filename);
 
 CREATE TABLE media_attic (
     filename TEXT UNIQUE NOT NULL,
@@ -345,33 +567,22 @@ CREATE TABLE media_attic (
     longitude DOUBLE,
     has_thumbnail INTEGER,
     mtime INTEGER,
-    type INTEGER   -- 0=Audio, 1=Video
+    type INTEGER,  -- 0=Audio, 1=Video
+    dir_id INTEGER,
+    date_epoch INTEGER
 );
-
-CREATE VIRTUAL TABLE media_fts
-USING fts4(content='media', title, artist, album, tokenize=mozporter);
-
-CREATE TRIGGER media_bu BEFORE UPDATE ON media BEGIN
-  DELETE FROM media_fts WHERE docid=old.id;
-END;
-
-CREATE TRIGGER media_au AFTER UPDATE ON media BEGIN
-  INSERT INTO media_fts(docid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);
-END;
-
-CREATE TRIGGER media_bd BEFORE DELETE ON media BEGIN
-  DELETE FROM media_fts WHERE docid=old.id;
-END;
-
-CREATE TRIGGER media_ai AFTER INSERT ON media BEGIN
-  INSERT INTO media_fts(docid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);
-END;
+CREATE INDEX media_attic_dir_idx ON media_attic(dir_id);
 
 CREATE TABLE broken_files (
     filename TEXT PRIMARY KEY NOT NULL,
     etag TEXT NOT NULL
 );
 )");
+    schema += directories_schema;
+    schema += media_fts_schema;
+    schema += media_changes_schema;
+    schema += media_location_schema;
+    schema += summary_schema();
     execute_sql(db, schema);
 
     Statement version(db, "INSERT INTO schemaVersion (version) VALUES (?)");
@@ -379,6 +590,30 @@ CREATE TABLE broken_files (
     version.step();
 }
 
+static std::string get_snapshot_name(const std::string &filename) {
+    if (filename.empty() || filename == ":memory:" ||
+        filename.compare(0, 5, "file:") == 0) {
+        return std::string();
+    }
+    return filename + "-snapshot";
+}
+
+// Turn a file name into a URI filename as accepted by sqlite3_open_v2.
+static std::string make_uri_filename(const std::string &filename) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string uri("file:");
+    for (const unsigned char c : filename) {
+        if (c == '%' || c == '?' || c == '#' || c < 0x20 || c >= 0x7f) {
+            uri += '%';
+            uri += hex[c >> 4];
+            uri += hex[c & 0xf];
+        } else {
+            uri += c;
+        }
+    }
+    return uri;
+}
+
 static std::string get_default_database() {
     std::string cachedir;
 
@@ -403,45 +638,906 @@ MediaStore::MediaStore(OpenType access, const std::string &retireprefix)
 }
 
 MediaStore::MediaStore(const std::string &filename, OpenType access, const std::string &retireprefix) {
-    int sqliteFlags = access == MS_READ_WRITE ? SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE : SQLITE_OPEN_READONLY;
     p = new MediaStorePrivate();
-    if(sqlite3_open_v2(filename.c_str(), &p->db, sqliteFlags, nullptr) != SQLITE_OK) {
-        throw runtime_error(sqlite3_errmsg(p->db));
-    }
-    register_tokenizer(p->db);
-    register_functions(p->db);
-    int detectedSchemaVersion = getSchemaVersion(p->db);
+    p->filename = filename;
+    p->access_type = access;
+    p->snapshot = get_snapshot_name(filename);
+    p->open();
     if(access == MS_READ_WRITE) {
+        int detectedSchemaVersion = getSchemaVersion(p->db);
         if(detectedSchemaVersion != schemaVersion) {
-            deleteTables(p->db);
-            createTables(p->db);
+            if (detectedSchemaVersion < 14) {
+                // Writing to media updates the old FTS4 index, and
+                // dropping it, whether migrating or not, needs its
+                // tokenizer too.
+                register_fts3_tokenizer(p->db);
+            }
+            bool migrated = false;
+            try {
+                migrated = p->migrateSchema(detectedSchemaVersion);
+            } catch (const std::exception &e) {
+                fprintf(stderr, "MediaStore: could not migrate schema version %d: %s\n",
+                        detectedSchemaVersion, e.what());
+            }
+            if (!migrated) {
+                deleteTables(p->db);
+                createTables(p->db);
+            }
+            try {
+                p->enableIncrementalVacuum();
+            } catch (const std::exception &e) {
+                fprintf(stderr, "MediaStore: could not enable incremental vacuum: %s\n", e.what());
+            }
         }
+        p->openExtractionJournal();
         if(!retireprefix.empty())
             archiveItems(retireprefix);
-    } else {
-        if(detectedSchemaVersion != schemaVersion) {
-            std::string msg("Tried to open a db with schema version ");
-            msg += std::to_string(detectedSchemaVersion);
-            msg += ", while supported version is ";
-            msg += std::to_string(schemaVersion) + ".";
-            throw runtime_error(msg);
+        try {
+            p->publishSnapshot();
+        } catch (const std::exception &e) {
+            fprintf(stderr, "MediaStore: could not publish snapshot: %s\n", e.what());
         }
+    } else {
+        p->checkSchemaVersion();
+        p->idleReaders.push_back(p);
+        p->maxReaders = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
     }
 }
 
 MediaStore::~MediaStore() {
-    sqlite3_close(p->db);
+    try {
+        p->publishSnapshot();
+    } catch (const std::exception &e) {
+        fprintf(stderr, "MediaStore: could not publish snapshot: %s\n", e.what());
+    }
+    p->close();
     delete p;
 }
 
-size_t MediaStorePrivate::size() const {
-    Statement count(db, "SELECT COUNT(*) FROM media");
-    count.step();
-    return count.getInt(0);
-}
+void MediaStorePrivate::open() {
+    std::string path = filename;
+    int flags;
+    if (access_type == MS_READ_WRITE) {
+        flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+    } else {
+        flags = SQLITE_OPEN_READONLY;
+        struct stat st;
+        if (!snapshot.empty() && stat(snapshot.c_str(), &st) == 0) {
+            // The snapshot is never modified in place, so readers
+            // can skip locking entirely.
+            path = make_uri_filename(snapshot) + "?immutable=1";
+            flags |= SQLITE_OPEN_URI;
+            snapshot_id = SnapshotId(st);
+        } else {
+            // No snapshot published yet: fall back to the database
+            // itself, as written by older versions.
+            snapshot_id = SnapshotId();
+        }
+    }
+    if(sqlite3_open_v2(path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+        std::string msg(sqlite3_errmsg(db));
+        sqlite3_close(db);
+        db = nullptr;
+        throw runtime_error(msg);
+    }
+    statements.reset(new StatementCache(db));
+    sqlite3_busy_handler(db, busy_handler, nullptr);
+    register_fts5_tokenizer(db);
+    if (access_type == MS_READ_WRITE) {
+        // Rows replaced by "INSERT OR REPLACE" must fire the delete
+        // triggers to keep the full text index and summaries in sync.
+        execute_sql(db, "PRAGMA recursive_triggers=ON;");
+        // Let maintenance return free pages a few at a time.  Only
+        // takes effect on a new database file, and only before the
+        // switch to WAL writes out its header.
+        execute_sql(db, "PRAGMA auto_vacuum = INCREMENTAL;");
+    }
+    if (access_type == MS_READ_WRITE && !snapshot.empty()) {
+        execute_sql(db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;");
+    }
+}
+
+MediaStorePrivate::~MediaStorePrivate() {
+    close();
+}
+
+MediaStorePrivate::Reader MediaStorePrivate::acquireReader() {
+    if (access_type != MS_READ_ONLY) {
+        return Reader(nullptr, this);
+    }
+    MediaStorePrivate *reader = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        poolAvailable.wait(lock, [this]() {
+                return !idleReaders.empty() || extraReaders.size() + 1 < maxReaders;
+            });
+        if (!idleReaders.empty()) {
+            reader = idleReaders.back();
+            idleReaders.pop_back();
+        } else {
+            std::unique_ptr<MediaStorePrivate> extra(new MediaStorePrivate);
+            extra->filename = filename;
+            extra->access_type = access_type;
+            extra->snapshot = snapshot;
+            extra->open();
+            reader = extra.get();
+            extraReaders.push_back(std::move(extra));
+        }
+    }
+    // On error, the connection is returned to the pool by r.
+    Reader r(this, reader);
+    reader->checkSnapshot();
+    return r;
+}
+
+void MediaStorePrivate::releaseReader(MediaStorePrivate *reader) {
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        idleReaders.push_back(reader);
+    }
+    poolAvailable.notify_one();
+}
+
+void MediaStorePrivate::close() {
+    statements.reset();
+    sqlite3_close(db);
+    db = nullptr;
+}
+
+void MediaStorePrivate::checkSchemaVersion() const {
+    int detectedSchemaVersion = getSchemaVersion(db);
+    if(detectedSchemaVersion != schemaVersion) {
+        std::string msg("Tried to open a db with schema version ");
+        msg += std::to_string(detectedSchemaVersion);
+        msg += ", while supported version is ";
+        msg += std::to_string(schemaVersion) + ".";
+        throw runtime_error(msg);
+    }
+}
+
+void MediaStorePrivate::checkSnapshot() {
+    if (access_type != MS_READ_ONLY || snapshot.empty()) {
+        return;
+    }
+    struct stat st;
+    if (stat(snapshot.c_str(), &st) != 0) {
+        return;
+    }
+    if (db && SnapshotId(st) == snapshot_id) {
+        return;
+    }
+    // A new snapshot has been published.
+    close();
+    open();
+    checkSchemaVersion();
+}
+
+void MediaStorePrivate::publishSnapshot() {
+    if (access_type != MS_READ_WRITE || snapshot.empty()) {
+        return;
+    }
+    // Only committed data can be published.
+    if (!sqlite3_get_autocommit(db)) {
+        return;
+    }
+    const int changes = sqlite3_total_changes(db);
+    if (changes == published_changes) {
+        return;
+    }
+
+    const std::string tmpname = snapshot + ".tmp";
+    unlink(tmpname.c_str());
+    sqlite3 *dest = nullptr;
+    int rc = sqlite3_open_v2(tmpname.c_str(), &dest,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+    if (rc == SQLITE_OK) {
+        sqlite3_backup *backup = sqlite3_backup_init(dest, "main", db, "main");
+        if (backup) {
+            sqlite3_backup_step(backup, -1);
+            rc = sqlite3_backup_finish(backup);
+        } else {
+            rc = sqlite3_errcode(dest);
+        }
+    }
+    if (rc == SQLITE_OK) {
+        // The copied header still says WAL: readers must not need
+        // to create a -shm file next to the snapshot.
+        rc = sqlite3_exec(dest, "PRAGMA journal_mode=DELETE", nullptr, nullptr, nullptr);
+    }
+    std::string msg("Could not publish database snapshot: ");
+    if (rc != SQLITE_OK) {
+        msg += sqlite3_errmsg(dest);
+    }
+    sqlite3_close(dest);
+    if (rc != SQLITE_OK) {
+        unlink(tmpname.c_str());
+        throw runtime_error(msg);
+    }
+    if (rename(tmpname.c_str(), snapshot.c_str()) < 0) {
+        msg += strerror(errno);
+        unlink(tmpname.c_str());
+        throw runtime_error(msg);
+    }
+    published_changes = changes;
+}
+
+void MediaStorePrivate::openExtractionJournal() {
+    const string path = snapshot.empty() ? string() : filename + "-extracting";
+    try {
+        extracting.reset(new ExtractionJournal(path));
+    } catch (const std::exception &e) {
+        fprintf(stderr, "MediaStore: %s\n", e.what());
+        extracting.reset(new ExtractionJournal(string()));
+    }
+    // Whatever was being extracted when the last writer died is
+    // presumed to have crashed it.
+    for (const auto &file : extracting->takeLeftovers()) {
+        fprintf(stderr, "MediaStore: marking %s as broken\n", file.first.c_str());
+        insert_broken_file(file.first, file.second);
+    }
+}
+
+DataVersion MediaStorePrivate::dataVersion() const {
+    DataVersion version;
+    version.snapshot = snapshot_id;
+    if (snapshot_id.ino == 0) {
+        // Reading the database itself, which the writer may change.
+        version.connection = this;
+        Statement query(*statements, "PRAGMA data_version");
+        query.step();
+        version.data_version = query.getInt64(0);
+    }
+    return version;
+}
+
+size_t MediaStorePrivate::size() const {
+    Statement count(*statements, "SELECT COUNT(*) FROM media");
+    count.step();
+    return count.getInt(0);
+}
+
+static const int64_t root_directory_id = 1;
+
+// Strip trailing slashes from a directory name, leaving "/" for the
+// root directory.
+static string normalize_directory(const string &path) {
+    string::size_type end = path.find_last_not_of('/');
+    if (end == string::npos) {
+        return "/";
+    }
+    return path.substr(0, end + 1);
+}
+
+static string parent_directory(const string &filename) {
+    string::size_type pos = filename.rfind('/');
+    if (pos == string::npos || pos == 0) {
+        return "/";
+    }
+    return filename.substr(0, pos);
+}
+
+// Look up a directory by walking down from the root one component
+// at a time.  Returns -1 if it is not in the table, unless create is
+// set, in which case the missing directories are added.
+int64_t MediaStorePrivate::directoryId(const std::string &path, bool create) const {
+    if (create && path == last_directory) {
+        return last_directory_id;
+    }
+    int64_t id = root_directory_id;
+    Statement select(*statements, "SELECT id FROM directories WHERE parent_id = ? AND name = ?");
+    string::size_type start = 0;
+    while (start < path.size()) {
+        string::size_type end = path.find('/', start);
+        if (end == string::npos) {
+            end = path.size();
+        }
+        if (end == start) {
+            start++;
+            continue;
+        }
+        const string name = path.substr(start, end - start);
+        select.bind(1, id);
+        select.bind(2, name);
+        if (select.step()) {
+            id = select.getInt64(0);
+        } else if (create) {
+            struct stat st;
+            int64_t mtime = 0;
+            if (stat(path.substr(0, end).c_str(), &st) == 0) {
+                mtime = st.st_mtime;
+            }
+            Statement insert(*statements, "INSERT INTO directories (parent_id, name, mtime) VALUES (?, ?, ?)");
+            insert.bind(1, id);
+            insert.bind(2, name);
+            insert.bind(3, mtime);
+            insert.step();
+            id = sqlite3_last_insert_rowid(db);
+        } else {
+            return -1;
+        }
+        select.reset();
+        start = end + 1;
+    }
+    if (create) {
+        last_directory = path;
+        last_directory_id = id;
+    }
+    return id;
+}
+
+// The steps from each old schema version to the next.  They keep the
+// rows and etags of the media already scanned, so an upgrade need
+// not rescan everything.  Each step's SQL is frozen as it stood at
+// the version the step leads to: the live schema above moves on, and
+// must not change what an old step does.
+
+// Drop the triggers on media while fill runs and then put them back,
+// so filling in a new column neither journals a change to every file
+// nor reindexes and re-summarizes them.
+static void without_media_triggers(MediaStorePrivate &p, const std::function<void()> &fill) {
+    vector<pair<string, string>> triggers;
+    {
+        Statement select(*p.statements, "SELECT name, sql FROM sqlite_master WHERE type = 'trigger' AND tbl_name = 'media'");
+        while (select.step()) {
+            triggers.emplace_back(select.getText(0), select.getText(1));
+        }
+    }
+    for (const auto &trigger : triggers) {
+        execute_sql(p.db, "DROP TRIGGER " + trigger.first);
+    }
+    fill();
+    for (const auto &trigger : triggers) {
+        execute_sql(p.db, trigger.second);
+    }
+}
+
+static void migrate_10_to_11(MediaStorePrivate &p) {
+    // The song and mtime indexes cover the keyset cursor's key.
+    execute_sql(p.db, R"(
+DROP INDEX media_song_info_idx;
+DROP INDEX media_mtime_idx;
+CREATE INDEX media_song_info_idx ON media(type, album_artist, album, disc_number, track_number, title, filename) WHERE type = 1;
+CREATE INDEX media_mtime_idx ON media(type, mtime, filename);
+)");
+}
+
+static void migrate_11_to_12(MediaStorePrivate &p) {
+    // The summaries and their triggers, then the rows the triggers
+    // would have made had they been there from the start.
+    execute_sql(p.db, R"(
+-- Summaries of the songs in media, kept up to date by the triggers
+-- below so listing albums, artists and genres need not scan media.
+CREATE TABLE album_summary (
+    album TEXT,
+    album_artist TEXT,
+    track_count INTEGER,
+    date TEXT,            -- The remaining columns are from the first track
+    genre TEXT,
+    filename TEXT,
+    has_thumbnail INTEGER,
+    mtime INTEGER,
+    PRIMARY KEY (album, album_artist)
+);
+
+CREATE TABLE artist_summary (
+    artist TEXT,
+    genre TEXT,
+    track_count INTEGER,
+    PRIMARY KEY (artist, genre)
+);
+CREATE INDEX artist_summary_genre_idx ON artist_summary(genre, artist);
+
+CREATE TABLE album_artist_summary (
+    album_artist TEXT,
+    genre TEXT,
+    track_count INTEGER,
+    PRIMARY KEY (album_artist, genre)
+);
+CREATE INDEX album_artist_summary_genre_idx ON album_artist_summary(genre, album_artist);
+
+CREATE TABLE genre_summary (
+    genre TEXT PRIMARY KEY,
+    track_count INTEGER
+);
+CREATE TRIGGER media_summary_ai AFTER INSERT ON media WHEN new.type = 1 BEGIN
+  DELETE FROM album_summary WHERE album = new.album AND album_artist = new.album_artist;
+  INSERT INTO album_summary (album, album_artist, track_count, date, genre, filename, has_thumbnail, mtime)
+    SELECT album, album_artist, (SELECT count(*) FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album), date, genre, filename, has_thumbnail, mtime
+    FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album
+    ORDER BY disc_number, track_number, title, filename LIMIT 1;
+  INSERT INTO artist_summary (artist, genre, track_count) SELECT new.artist, new.genre, 0
+    WHERE NOT EXISTS (SELECT 1 FROM artist_summary WHERE artist = new.artist AND genre = new.genre);
+  UPDATE artist_summary SET track_count = track_count + 1 WHERE artist = new.artist AND genre = new.genre;
+  INSERT INTO album_artist_summary (album_artist, genre, track_count) SELECT new.album_artist, new.genre, 0
+    WHERE NOT EXISTS (SELECT 1 FROM album_artist_summary WHERE album_artist = new.album_artist AND genre = new.genre);
+  UPDATE album_artist_summary SET track_count = track_count + 1 WHERE album_artist = new.album_artist AND genre = new.genre;
+  INSERT INTO genre_summary (genre, track_count) SELECT new.genre, 0
+    WHERE NOT EXISTS (SELECT 1 FROM genre_summary WHERE genre = new.genre);
+  UPDATE genre_summary SET track_count = track_count + 1 WHERE genre = new.genre;
+END;
+CREATE TRIGGER media_summary_ad AFTER DELETE ON media WHEN old.type = 1 BEGIN
+  DELETE FROM album_summary WHERE album = old.album AND album_artist = old.album_artist;
+  INSERT INTO album_summary (album, album_artist, track_count, date, genre, filename, has_thumbnail, mtime)
+    SELECT album, album_artist, (SELECT count(*) FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album), date, genre, filename, has_thumbnail, mtime
+    FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album
+    ORDER BY disc_number, track_number, title, filename LIMIT 1;
+  UPDATE artist_summary SET track_count = track_count - 1 WHERE artist = old.artist AND genre = old.genre;
+  DELETE FROM artist_summary WHERE artist = old.artist AND genre = old.genre AND track_count = 0;
+  UPDATE album_artist_summary SET track_count = track_count - 1 WHERE album_artist = old.album_artist AND genre = old.genre;
+  DELETE FROM album_artist_summary WHERE album_artist = old.album_artist AND genre = old.genre AND track_count = 0;
+  UPDATE genre_summary SET track_count = track_count - 1 WHERE genre = old.genre;
+  DELETE FROM genre_summary WHERE genre = old.genre AND track_count = 0;
+END;
+CREATE TRIGGER media_summary_au_old AFTER UPDATE ON media WHEN old.type = 1 BEGIN
+  DELETE FROM album_summary WHERE album = old.album AND album_artist = old.album_artist;
+  INSERT INTO album_summary (album, album_artist, track_count, date, genre, filename, has_thumbnail, mtime)
+    SELECT album, album_artist, (SELECT count(*) FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album), date, genre, filename, has_thumbnail, mtime
+    FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album
+    ORDER BY disc_number, track_number, title, filename LIMIT 1;
+  UPDATE artist_summary SET track_count = track_count - 1 WHERE artist = old.artist AND genre = old.genre;
+  DELETE FROM artist_summary WHERE artist = old.artist AND genre = old.genre AND track_count = 0;
+  UPDATE album_artist_summary SET track_count = track_count - 1 WHERE album_artist = old.album_artist AND genre = old.genre;
+  DELETE FROM album_artist_summary WHERE album_artist = old.album_artist AND genre = old.genre AND track_count = 0;
+  UPDATE genre_summary SET track_count = track_count - 1 WHERE genre = old.genre;
+  DELETE FROM genre_summary WHERE genre = old.genre AND track_count = 0;
+END;
+CREATE TRIGGER media_summary_au_new AFTER UPDATE ON media WHEN new.type = 1 BEGIN
+  DELETE FROM album_summary WHERE album = new.album AND album_artist = new.album_artist;
+  INSERT INTO album_summary (album, album_artist, track_count, date, genre, filename, has_thumbnail, mtime)
+    SELECT album, album_artist, (SELECT count(*) FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album), date, genre, filename, has_thumbnail, mtime
+    FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album
+    ORDER BY disc_number, track_number, title, filename LIMIT 1;
+  INSERT INTO artist_summary (artist, genre, track_count) SELECT new.artist, new.genre, 0
+    WHERE NOT EXISTS (SELECT 1 FROM artist_summary WHERE artist = new.artist AND genre = new.genre);
+  UPDATE artist_summary SET track_count = track_count + 1 WHERE artist = new.artist AND genre = new.genre;
+  INSERT INTO album_artist_summary (album_artist, genre, track_count) SELECT new.album_artist, new.genre, 0
+    WHERE NOT EXISTS (SELECT 1 FROM album_artist_summary WHERE album_artist = new.album_artist AND genre = new.genre);
+  UPDATE album_artist_summary SET track_count = track_count + 1 WHERE album_artist = new.album_artist AND genre = new.genre;
+  INSERT INTO genre_summary (genre, track_count) SELECT new.genre, 0
+    WHERE NOT EXISTS (SELECT 1 FROM genre_summary WHERE genre = new.genre);
+  UPDATE genre_summary SET track_count = track_count + 1 WHERE genre = new.genre;
+END;
+
+INSERT INTO album_summary (album, album_artist, track_count, date, genre, filename, has_thumbnail, mtime)
+  SELECT album, album_artist,
+    (SELECT count(*) FROM media AS t WHERE t.type = 1 AND t.album_artist = m.album_artist AND t.album = m.album),
+    date, genre, filename, has_thumbnail, mtime
+  FROM media AS m
+  WHERE m.type = 1 AND m.id = (
+    SELECT id FROM media WHERE type = 1 AND album_artist = m.album_artist AND album = m.album
+      ORDER BY disc_number, track_number, title, filename LIMIT 1);
+INSERT INTO artist_summary (artist, genre, track_count)
+  SELECT artist, genre, count(*) FROM media WHERE type = 1 GROUP BY artist, genre;
+INSERT INTO album_artist_summary (album_artist, genre, track_count)
+  SELECT album_artist, genre, count(*) FROM media WHERE type = 1 GROUP BY album_artist, genre;
+INSERT INTO genre_summary (genre, track_count)
+  SELECT genre, count(*) FROM media WHERE type = 1 GROUP BY genre;
+)");
+}
+
+static void migrate_12_to_13(MediaStorePrivate &p) {
+    execute_sql(p.db, R"(
+-- The directories holding media, so operations on a subtree can
+-- follow parent_id rather than matching filename prefixes.  The
+-- root directory has id 1 and an empty name.
+CREATE TABLE directories (
+    id INTEGER PRIMARY KEY,
+    parent_id INTEGER REFERENCES directories(id),
+    name TEXT NOT NULL,
+    mtime INTEGER
+);
+CREATE UNIQUE INDEX directories_parent_idx ON directories(parent_id, name);
+INSERT INTO directories (id, parent_id, name, mtime) VALUES (1, NULL, '', 0);
+
+ALTER TABLE media ADD COLUMN dir_id INTEGER REFERENCES directories(id);
+ALTER TABLE media_attic ADD COLUMN dir_id INTEGER;
+)");
+    // Add each file's directory a component at a time, as the
+    // version 13 schema has them.
+    Statement select_dir(*p.statements, "SELECT id FROM directories WHERE parent_id = ? AND name = ?");
+    Statement insert_dir(*p.statements, "INSERT INTO directories (parent_id, name, mtime) VALUES (?, ?, ?)");
+    string last_path;
+    int64_t last_id = -1;
+    auto directory_id = [&](const string &path) -> int64_t {
+        if (path == last_path) {
+            return last_id;
+        }
+        int64_t id = 1;
+        string::size_type start = 0;
+        while (start < path.size()) {
+            string::size_type end = path.find('/', start);
+            if (end == string::npos) {
+                end = path.size();
+            }
+            if (end > start) {
+                const string name = path.substr(start, end - start);
+                select_dir.bind(1, id);
+                select_dir.bind(2, name);
+                if (select_dir.step()) {
+                    id = select_dir.getInt64(0);
+                } else {
+                    struct stat st;
+                    insert_dir.bind(1, id);
+                    insert_dir.bind(2, name);
+                    insert_dir.bind(3, static_cast<int64_t>(
+                        stat(path.substr(0, end).c_str(), &st) == 0 ? st.st_mtime : 0));
+                    insert_dir.step();
+                    insert_dir.reset();
+                    id = sqlite3_last_insert_rowid(p.db);
+                }
+                select_dir.reset();
+            }
+            start = end + 1;
+        }
+        last_path = path;
+        last_id = id;
+        return id;
+    };
+    without_media_triggers(p, [&]() {
+            for (const string table : {"media", "media_attic"}) {
+                // Read every file name before updating any, rather than
+                // changing the table under the query.
+                vector<pair<int64_t, string>> files;
+                Statement select(*p.statements, "SELECT rowid, filename FROM " + table);
+                while (select.step()) {
+                    files.emplace_back(select.getInt64(0), select.getText(1));
+                }
+                Statement update(*p.statements, "UPDATE " + table + " SET dir_id = ? WHERE rowid = ?");
+                for (const auto &file : files) {
+                    update.bind(1, directory_id(parent_directory(file.second)));
+                    update.bind(2, file.first);
+                    update.step();
+                    update.reset();
+                }
+            }
+        });
+    execute_sql(p.db, R"(
+CREATE INDEX media_dir_idx ON media(dir_id, filename);
+CREATE INDEX media_attic_dir_idx ON media_attic(dir_id);
+)");
+}
+
+static void migrate_13_to_14(MediaStorePrivate &p) {
+    // FTS5 builds its index from the media table it is a content
+    // table of.
+    execute_sql(p.db, R"(
+DROP TRIGGER media_bu;
+DROP TRIGGER media_au;
+DROP TRIGGER media_bd;
+DROP TRIGGER media_ai;
+DROP TABLE media_fts;
+
+CREATE VIRTUAL TABLE media_fts
+USING fts5(title, artist, album, content='media', content_rowid='id',
+           tokenize=mozporter, prefix='1 2 3', detail=)" FTS_DETAIL R"();
+
+CREATE TRIGGER media_au AFTER UPDATE ON media BEGIN
+  INSERT INTO media_fts(media_fts, rowid, title, artist, album) VALUES ('delete', old.id, old.title, old.artist, old.album);
+  INSERT INTO media_fts(rowid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);
+END;
+
+CREATE TRIGGER media_ad AFTER DELETE ON media BEGIN
+  INSERT INTO media_fts(media_fts, rowid, title, artist, album) VALUES ('delete', old.id, old.title, old.artist, old.album);
+END;
+
+CREATE TRIGGER media_ai AFTER INSERT ON media BEGIN
+  INSERT INTO media_fts(rowid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);
+END;
+
+INSERT INTO media_fts(media_fts) VALUES ('rebuild');
+)");
+}
+
+static void migrate_14_to_15(MediaStorePrivate &p) {
+    // The journal starts empty: clients that saw the old schema
+    // reload everything anyway.
+    execute_sql(p.db, R"(
+CREATE TABLE media_changes (
+    seq INTEGER PRIMARY KEY AUTOINCREMENT,
+    media_id INTEGER NOT NULL,
+    filename TEXT NOT NULL,
+    type INTEGER NOT NULL,
+    change INTEGER NOT NULL, -- ChangeKind enum
+    time INTEGER NOT NULL
+);
+CREATE INDEX media_changes_time_idx ON media_changes(time);
+
+CREATE TRIGGER media_changes_ai AFTER INSERT ON media BEGIN
+  INSERT INTO media_changes (media_id, filename, type, change, time)
+    SELECT new.id, new.filename, new.type,
+      CASE WHEN EXISTS (
+        SELECT 1 FROM media_changes
+          WHERE seq = (SELECT max(seq) FROM media_changes)
+            AND change = 2 AND filename = new.filename) THEN 1 ELSE 0 END,
+      strftime('%s', 'now');
+  DELETE FROM media_changes
+    WHERE seq = (SELECT max(seq) FROM media_changes
+                   WHERE seq < (SELECT max(seq) FROM media_changes))
+      AND change = 2 AND filename = new.filename;
+END;
+
+CREATE TRIGGER media_changes_au AFTER UPDATE ON media BEGIN
+  INSERT INTO media_changes (media_id, filename, type, change, time)
+    VALUES (new.id, new.filename, new.type, 1, strftime('%s', 'now'));
+END;
+
+CREATE TRIGGER media_changes_ad AFTER DELETE ON media BEGIN
+  INSERT INTO media_changes (media_id, filename, type, change, time)
+    VALUES (old.id, old.filename, old.type, 2, strftime('%s', 'now'));
+END;
+)");
+}
+
+static void migrate_15_to_16(MediaStorePrivate &p) {
+    execute_sql(p.db, R"(
+CREATE VIRTUAL TABLE media_location
+USING rtree(id, min_latitude, max_latitude, min_longitude, max_longitude);
+
+CREATE TRIGGER media_location_ai AFTER INSERT ON media
+  WHEN new.latitude <> 0 OR new.longitude <> 0 BEGIN
+  INSERT INTO media_location VALUES (new.id, new.latitude, new.latitude, new.longitude, new.longitude);
+END;
+
+CREATE TRIGGER media_location_au AFTER UPDATE ON media BEGIN
+  DELETE FROM media_location WHERE id = old.id;
+  INSERT INTO media_location
+    SELECT new.id, new.latitude, new.latitude, new.longitude, new.longitude
+    WHERE new.latitude <> 0 OR new.longitude <> 0;
+END;
+
+CREATE TRIGGER media_location_ad AFTER DELETE ON media BEGIN
+  DELETE FROM media_location WHERE id = old.id;
+END;
+
+INSERT INTO media_location
+  SELECT id, latitude, latitude, longitude, longitude FROM media
+  WHERE latitude <> 0 OR longitude <> 0;
+)");
+}
+
+static void migrate_16_to_17(MediaStorePrivate &p) {
+    execute_sql(p.db, R"(
+ALTER TABLE media ADD COLUMN date_epoch INTEGER;
+ALTER TABLE media_attic ADD COLUMN date_epoch INTEGER;
+)");
+    without_media_triggers(p, [&]() {
+            for (const string table : {"media", "media_attic"}) {
+                vector<pair<int64_t, int64_t>> dates;
+                Statement select(*p.statements, "SELECT rowid, date FROM " + table + " WHERE date IS NOT NULL");
+                while (select.step()) {
+                    int64_t date_epoch;
+                    if (parse_date(select.getText(1), date_epoch)) {
+                        dates.emplace_back(select.getInt64(0), date_epoch);
+                    }
+                }
+                Statement update(*p.statements, "UPDATE " + table + " SET date_epoch = ? WHERE rowid = ?");
+                for (const auto &date : dates) {
+                    update.bind(1, date.second);
+                    update.bind(2, date.first);
+                    update.step();
+                    update.reset();
+                }
+            }
+        });
+    execute_sql(p.db, "CREATE INDEX media_date_idx ON media(type, date_epoch, filename)");
+}
+
+static void migrate_17_to_18(MediaStorePrivate &p) {
+    execute_sql(p.db, "CREATE INDEX media_title_idx ON media(type, title, filename)");
+}
+
+static void migrate_18_to_19(MediaStorePrivate &p) {
+    // Rebuild the summaries with their new duration totals, and add
+    // the media type summary.
+    execute_sql(p.db, R"(
+DROP TRIGGER media_summary_ai;
+DROP TRIGGER media_summary_ad;
+DROP TRIGGER media_summary_au_old;
+DROP TRIGGER media_summary_au_new;
+DROP TABLE album_summary;
+DROP TABLE artist_summary;
+DROP TABLE album_artist_summary;
+DROP TABLE genre_summary;
+
+-- Summaries of the songs in media, kept up to date by the triggers
+-- below so listing albums, artists and genres need not scan media.
+CREATE TABLE album_summary (
+    album TEXT,
+    album_artist TEXT,
+    track_count INTEGER,
+    duration INTEGER,
+    date TEXT,            -- The remaining columns are from the first track
+    genre TEXT,
+    filename TEXT,
+    has_thumbnail INTEGER,
+    mtime INTEGER,
+    PRIMARY KEY (album, album_artist)
+);
+
+CREATE TABLE artist_summary (
+    artist TEXT,
+    genre TEXT,
+    track_count INTEGER,
+    duration INTEGER,
+    PRIMARY KEY (artist, genre)
+);
+CREATE INDEX artist_summary_genre_idx ON artist_summary(genre, artist);
+
+CREATE TABLE album_artist_summary (
+    album_artist TEXT,
+    genre TEXT,
+    track_count INTEGER,
+    duration INTEGER,
+    PRIMARY KEY (album_artist, genre)
+);
+CREATE INDEX album_artist_summary_genre_idx ON album_artist_summary(genre, album_artist);
+
+CREATE TABLE genre_summary (
+    genre TEXT PRIMARY KEY,
+    track_count INTEGER,
+    duration INTEGER
+);
+
+-- The number and total duration of media of each type, so counting
+-- them need not scan media.
+CREATE TABLE media_type_summary (
+    type INTEGER PRIMARY KEY,
+    media_count INTEGER,
+    duration INTEGER
+);
+CREATE TRIGGER media_type_summary_ai AFTER INSERT ON media BEGIN
+  INSERT INTO media_type_summary (type, media_count, duration) SELECT new.type, 0, 0
+    WHERE NOT EXISTS (SELECT 1 FROM media_type_summary WHERE type = new.type);
+  UPDATE media_type_summary SET media_count = media_count + 1, duration = duration + ifnull(new.duration, 0) WHERE type = new.type;
+END;
+CREATE TRIGGER media_type_summary_ad AFTER DELETE ON media BEGIN
+  UPDATE media_type_summary SET media_count = media_count - 1, duration = duration - ifnull(old.duration, 0) WHERE type = old.type;
+  DELETE FROM media_type_summary WHERE type = old.type AND media_count = 0;
+END;
+CREATE TRIGGER media_type_summary_au AFTER UPDATE ON media BEGIN
+  UPDATE media_type_summary SET media_count = media_count - 1, duration = duration - ifnull(old.duration, 0) WHERE type = old.type;
+  DELETE FROM media_type_summary WHERE type = old.type AND media_count = 0;
+  INSERT INTO media_type_summary (type, media_count, duration) SELECT new.type, 0, 0
+    WHERE NOT EXISTS (SELECT 1 FROM media_type_summary WHERE type = new.type);
+  UPDATE media_type_summary SET media_count = media_count + 1, duration = duration + ifnull(new.duration, 0) WHERE type = new.type;
+END;
+CREATE TRIGGER media_summary_ai AFTER INSERT ON media WHEN new.type = 1 BEGIN
+  DELETE FROM album_summary WHERE album = new.album AND album_artist = new.album_artist;
+  INSERT INTO album_summary (album, album_artist, track_count, duration, date, genre, filename, has_thumbnail, mtime)
+    SELECT album, album_artist, (SELECT count(*) FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album),
+      (SELECT ifnull(sum(duration), 0) FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album), date, genre, filename, has_thumbnail, mtime
+    FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album
+    ORDER BY disc_number, track_number, title, filename LIMIT 1;
+  INSERT INTO artist_summary (artist, genre, track_count, duration) SELECT new.artist, new.genre, 0, 0
+    WHERE NOT EXISTS (SELECT 1 FROM artist_summary WHERE artist = new.artist AND genre = new.genre);
+  UPDATE artist_summary SET track_count = track_count + 1, duration = duration + ifnull(new.duration, 0) WHERE artist = new.artist AND genre = new.genre;
+  INSERT INTO album_artist_summary (album_artist, genre, track_count, duration) SELECT new.album_artist, new.genre, 0, 0
+    WHERE NOT EXISTS (SELECT 1 FROM album_artist_summary WHERE album_artist = new.album_artist AND genre = new.genre);
+  UPDATE album_artist_summary SET track_count = track_count + 1, duration = duration + ifnull(new.duration, 0) WHERE album_artist = new.album_artist AND genre = new.genre;
+  INSERT INTO genre_summary (genre, track_count, duration) SELECT new.genre, 0, 0
+    WHERE NOT EXISTS (SELECT 1 FROM genre_summary WHERE genre = new.genre);
+  UPDATE genre_summary SET track_count = track_count + 1, duration = duration + ifnull(new.duration, 0) WHERE genre = new.genre;
+END;
+CREATE TRIGGER media_summary_ad AFTER DELETE ON media WHEN old.type = 1 BEGIN
+  DELETE FROM album_summary WHERE album = old.album AND album_artist = old.album_artist;
+  INSERT INTO album_summary (album, album_artist, track_count, duration, date, genre, filename, has_thumbnail, mtime)
+    SELECT album, album_artist, (SELECT count(*) FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album),
+      (SELECT ifnull(sum(duration), 0) FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album), date, genre, filename, has_thumbnail, mtime
+    FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album
+    ORDER BY disc_number, track_number, title, filename LIMIT 1;
+  UPDATE artist_summary SET track_count = track_count - 1, duration = duration - ifnull(old.duration, 0) WHERE artist = old.artist AND genre = old.genre;
+  DELETE FROM artist_summary WHERE artist = old.artist AND genre = old.genre AND track_count = 0;
+  UPDATE album_artist_summary SET track_count = track_count - 1, duration = duration - ifnull(old.duration, 0) WHERE album_artist = old.album_artist AND genre = old.genre;
+  DELETE FROM album_artist_summary WHERE album_artist = old.album_artist AND genre = old.genre AND track_count = 0;
+  UPDATE genre_summary SET track_count = track_count - 1, duration = duration - ifnull(old.duration, 0) WHERE genre = old.genre;
+  DELETE FROM genre_summary WHERE genre = old.genre AND track_count = 0;
+END;
+CREATE TRIGGER media_summary_au_old AFTER UPDATE ON media WHEN old.type = 1 BEGIN
+  DELETE FROM album_summary WHERE album = old.album AND album_artist = old.album_artist;
+  INSERT INTO album_summary (album, album_artist, track_count, duration, date, genre, filename, has_thumbnail, mtime)
+    SELECT album, album_artist, (SELECT count(*) FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album),
+      (SELECT ifnull(sum(duration), 0) FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album), date, genre, filename, has_thumbnail, mtime
+    FROM media WHERE type = 1 AND album_artist = old.album_artist AND album = old.album
+    ORDER BY disc_number, track_number, title, filename LIMIT 1;
+  UPDATE artist_summary SET track_count = track_count - 1, duration = duration - ifnull(old.duration, 0) WHERE artist = old.artist AND genre = old.genre;
+  DELETE FROM artist_summary WHERE artist = old.artist AND genre = old.genre AND track_count = 0;
+  UPDATE album_artist_summary SET track_count = track_count - 1, duration = duration - ifnull(old.duration, 0) WHERE album_artist = old.album_artist AND genre = old.genre;
+  DELETE FROM album_artist_summary WHERE album_artist = old.album_artist AND genre = old.genre AND track_count = 0;
+  UPDATE genre_summary SET track_count = track_count - 1, duration = duration - ifnull(old.duration, 0) WHERE genre = old.genre;
+  DELETE FROM genre_summary WHERE genre = old.genre AND track_count = 0;
+END;
+CREATE TRIGGER media_summary_au_new AFTER UPDATE ON media WHEN new.type = 1 BEGIN
+  DELETE FROM album_summary WHERE album = new.album AND album_artist = new.album_artist;
+  INSERT INTO album_summary (album, album_artist, track_count, duration, date, genre, filename, has_thumbnail, mtime)
+    SELECT album, album_artist, (SELECT count(*) FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album),
+      (SELECT ifnull(sum(duration), 0) FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album), date, genre, filename, has_thumbnail, mtime
+    FROM media WHERE type = 1 AND album_artist = new.album_artist AND album = new.album
+    ORDER BY disc_number, track_number, title, filename LIMIT 1;
+  INSERT INTO artist_summary (artist, genre, track_count, duration) SELECT new.artist, new.genre, 0, 0
+    WHERE NOT EXISTS (SELECT 1 FROM artist_summary WHERE artist = new.artist AND genre = new.genre);
+  UPDATE artist_summary SET track_count = track_count + 1, duration = duration + ifnull(new.duration, 0) WHERE artist = new.artist AND genre = new.genre;
+  INSERT INTO album_artist_summary (album_artist, genre, track_count, duration) SELECT new.album_artist, new.genre, 0, 0
+    WHERE NOT EXISTS (SELECT 1 FROM album_artist_summary WHERE album_artist = new.album_artist AND genre = new.genre);
+  UPDATE album_artist_summary SET track_count = track_count + 1, duration = duration + ifnull(new.duration, 0) WHERE album_artist = new.album_artist AND genre = new.genre;
+  INSERT INTO genre_summary (genre, track_count, duration) SELECT new.genre, 0, 0
+    WHERE NOT EXISTS (SELECT 1 FROM genre_summary WHERE genre = new.genre);
+  UPDATE genre_summary SET track_count = track_count + 1, duration = duration + ifnull(new.duration, 0) WHERE genre = new.genre;
+END;
+
+INSERT INTO album_summary (album, album_artist, track_count, duration, date, genre, filename, has_thumbnail, mtime)
+  SELECT album, album_artist,
+    (SELECT count(*) FROM media AS t WHERE t.type = 1 AND t.album_artist = m.album_artist AND t.album = m.album),
+    (SELECT ifnull(sum(duration), 0) FROM media AS t WHERE t.type = 1 AND t.album_artist = m.album_artist AND t.album = m.album),
+    date, genre, filename, has_thumbnail, mtime
+  FROM media AS m
+  WHERE m.type = 1 AND m.id = (
+    SELECT id FROM media WHERE type = 1 AND album_artist = m.album_artist AND album = m.album
+      ORDER BY disc_number, track_number, title, filename LIMIT 1);
+INSERT INTO artist_summary (artist, genre, track_count, duration)
+  SELECT artist, genre, count(*), ifnull(sum(duration), 0) FROM media WHERE type = 1 GROUP BY artist, genre;
+INSERT INTO album_artist_summary (album_artist, genre, track_count, duration)
+  SELECT album_artist, genre, count(*), ifnull(sum(duration), 0) FROM media WHERE type = 1 GROUP BY album_artist, genre;
+INSERT INTO genre_summary (genre, track_count, duration)
+  SELECT genre, count(*), ifnull(sum(duration), 0) FROM media WHERE type = 1 GROUP BY genre;
+INSERT INTO media_type_summary (type, media_count, duration)
+  SELECT type, count(*), ifnull(sum(duration), 0) FROM media GROUP BY type;
+)");
+}
+
+struct Migration {
+    int from;
+    void (*migrate)(MediaStorePrivate &p);
+};
+
+static const Migration migrations[] = {
+    {10, migrate_10_to_11},
+    {11, migrate_11_to_12},
+    {12, migrate_12_to_13},
+    {13, migrate_13_to_14},
+    {14, migrate_14_to_15},
+    {15, migrate_15_to_16},
+    {16, migrate_16_to_17},
+    {17, migrate_17_to_18},
+    {18, migrate_18_to_19},
+};
+
+// Bring the database from the given schema version to the current
+// one a step at a time, each in a transaction with the update of
+// schemaVersion.  Returns false if there is no way to get there from
+// that version, and throws if a step fails.  The database is then
+// left at the last version successfully reached.
+bool MediaStorePrivate::migrateSchema(int version) {
+    auto step = std::find_if(std::begin(migrations), std::end(migrations),
+                             [version](const Migration &m) { return m.from == version; });
+    if (step == std::end(migrations)) {
+        return false;
+    }
+    for (; step != std::end(migrations); ++step) {
+        savepoint("migrate");
+        try {
+            step->migrate(*this);
+            Statement update(*statements, "UPDATE schemaVersion SET version = ?");
+            update.bind(1, step->from + 1);
+            update.step();
+        } catch (...) {
+            rollback_to("migrate");
+            throw;
+        }
+        release("migrate");
+    }
+    return true;
+}
+
+// Select the ids of a directory and every directory below it.
+static const char subtree_sql[] = R"(WITH RECURSIVE subtree(id) AS (
+    SELECT ?
+    UNION ALL
+    SELECT directories.id FROM directories JOIN subtree ON directories.parent_id = subtree.id)
+  SELECT id FROM subtree)";
 
-void MediaStorePrivate::insert(const MediaFile &m) const {
-    Statement query(db, "INSERT OR REPLACE INTO media (filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type)  VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+static const char insert_media_sql[] = "INSERT OR REPLACE INTO media (filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type, dir_id, date_epoch)  VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+static void bind_media(Statement &query, const MediaFile &m, int64_t dir_id) {
     query.bind(1, m.getFileName());
     query.bind(2, m.getContentType());
     query.bind(3, m.getETag());
@@ -461,14 +1557,20 @@ void MediaStorePrivate::insert(const MediaFile &m) const {
     query.bind(17, (int)m.getHasThumbnail());
     query.bind(18, (int64_t)m.getModificationTime());
     query.bind(19, (int)m.getType());
-    query.step();
+    query.bind(20, dir_id);
+    int64_t date_epoch;
+    if (parse_date(m.getDate(), date_epoch)) {
+        query.bind(21, date_epoch);
+    } else {
+        query.bindNull(21);
+    }
+}
 
-    const char *typestr = m.getType() == AudioMedia ? "song" : "video";
-    printf("Added %s to backing store: %s\n", typestr, m.getFileName().c_str());
-    printf(" author   : %s\n", m.getAuthor().c_str());
-    printf(" title    : %s\n", m.getTitle().c_str());
-    printf(" album    : %s\n", m.getAlbum().c_str());
-    printf(" duration : %d\n", m.getDuration());
+void MediaStorePrivate::insert(const MediaFile &m) const {
+    int64_t dir_id = directoryId(parent_directory(m.getFileName()), true);
+    Statement query(*statements, insert_media_sql);
+    bind_media(query, m, dir_id);
+    query.step();
 
     // Not atomic with the addition above but very unlikely to crash between the two.
     // Even if it does, only one residual line remains and that will be cleaned up
@@ -477,31 +1579,118 @@ void MediaStorePrivate::insert(const MediaFile &m) const {
 }
 
 void MediaStorePrivate::remove(const string &fname) const {
-    Statement del(db, "DELETE FROM media WHERE filename = ?");
+    Statement del(*statements, "DELETE FROM media WHERE filename = ?");
     del.bind(1, fname);
     del.step();
 }
 
+void MediaStorePrivate::insertBatch(const std::vector<MediaFile> &files) const {
+    if (files.empty()) {
+        return;
+    }
+    // A savepoint works both inside and outside of an open transaction.
+    savepoint("insert_batch");
+    try {
+        Statement query(*statements, insert_media_sql);
+        for (const auto &m : files) {
+            bind_media(query, m, directoryId(parent_directory(m.getFileName()), true));
+            query.step();
+            query.reset();
+        }
+        query.finalize();
+        remove_broken_files(files);
+    } catch (...) {
+        rollback_to("insert_batch");
+        throw;
+    }
+    release("insert_batch");
+}
+
+void MediaStorePrivate::removeBatch(const std::vector<std::string> &filenames) const {
+    if (filenames.empty()) {
+        return;
+    }
+    savepoint("remove_batch");
+    try {
+        Statement del(*statements, "DELETE FROM media WHERE filename = ?");
+        for (const auto &fname : filenames) {
+            del.bind(1, fname);
+            del.step();
+            del.reset();
+        }
+    } catch (...) {
+        rollback_to("remove_batch");
+        throw;
+    }
+    release("remove_batch");
+}
+
 void MediaStorePrivate::insert_broken_file(const std::string &fname, const std::string &etag) const {
-    Statement del(db, "INSERT OR REPLACE INTO broken_files (filename, etag) VALUES (?, ?)");
+    Statement del(*statements, "INSERT OR REPLACE INTO broken_files (filename, etag) VALUES (?, ?)");
     del.bind(1, fname);
     del.bind(2, etag);
     del.step();
 }
 
 void MediaStorePrivate::remove_broken_file(const std::string &fname) const {
-    Statement del(db, "DELETE FROM broken_files WHERE filename = ?");
+    Statement del(*statements, "DELETE FROM broken_files WHERE filename = ?");
     del.bind(1, fname);
     del.step();
 }
 
+void MediaStorePrivate::remove_broken_files(const std::vector<MediaFile> &files) const {
+    // Stay well below SQLITE_MAX_VARIABLE_NUMBER.
+    const size_t chunk_size = 500;
+    for (size_t start = 0; start < files.size(); start += chunk_size) {
+        const size_t end = std::min(start + chunk_size, files.size());
+        string qs("DELETE FROM broken_files WHERE filename IN (?");
+        for (size_t i = start + 1; i < end; i++) {
+            qs += ", ?";
+        }
+        qs += ")";
+        // Only the last chunk can have a different size, so this
+        // adds at most two statements to the cache.
+        Statement del(*statements, qs);
+        for (size_t i = start; i < end; i++) {
+            del.bind(i - start + 1, files[i].getFileName());
+        }
+        del.step();
+    }
+}
+
 bool MediaStorePrivate::is_broken_file(const std::string &fname, const std::string &etag) const {
-    Statement query(db, "SELECT * FROM broken_files WHERE filename = ? AND etag = ?");
+    Statement query(*statements, "SELECT * FROM broken_files WHERE filename = ? AND etag = ?");
     query.bind(1, fname);
     query.bind(2, etag);
     return query.step();
 }
 
+KnownFiles MediaStorePrivate::getKnownFiles(const std::string &directory) const {
+    // Media are found through the directories table, broken files by
+    // prefix: '0' follows '/'.
+    const string dir = normalize_directory(directory);
+    const string prefix = dir == "/" ? dir : dir + "/";
+    Statement query(*statements, string(R"(
+SELECT filename, max(in_media), max(etag), max(broken), max(broken_etag) FROM (
+  SELECT filename, 1 AS in_media, etag, 0 AS broken, NULL AS broken_etag FROM media
+    WHERE dir_id IN ()") + subtree_sql + R"()
+  UNION ALL
+  SELECT filename, 0, NULL, 1, etag FROM broken_files
+    WHERE filename >= ? AND filename < ?)
+GROUP BY filename ORDER BY filename)");
+    query.bind(1, directoryId(dir, false));
+    query.bind(2, prefix);
+    query.bind(3, prefix.substr(0, prefix.size() - 1) + "0");
+    KnownFiles files;
+    size_t length;
+    while (query.step()) {
+        files.add(query.getText(0),
+                  query.getInt(1) ? query.getTextPointer(2, length) : nullptr,
+                  query.getInt(3) ? query.getTextPointer(4, length) : nullptr);
+    }
+    return files;
+}
+
 static MediaFile make_media(Statement &query) {
     return MediaFileBuilder(query.getText(0))
         .setContentType(query.getText(1))
@@ -532,8 +1721,184 @@ static vector<MediaFile> collect_media(Statement &query) {
     return result;
 }
 
+// Add a row of the columns make_media() reads to a batch, straight
+// from SQLite's buffers.
+static void append_media(MediaFileBatch &batch, Statement &query) {
+    for (int column = 0; column <= MediaFileBatch::Genre; column++) {
+        size_t length;
+        const char *text = query.getTextPointer(column, length);
+        batch.appendText(text, length);
+    }
+    batch.appendNumbers(query.getInt(9), query.getInt(10), query.getInt(11),
+                        query.getInt(12), query.getInt(13),
+                        query.getDouble(14), query.getDouble(15),
+                        query.getInt(16), query.getInt64(17),
+                        (MediaType)query.getInt(18));
+}
+
+// Keys of a cursor made by Filter::setCursorAfter(const MediaFile&).
+enum MediaCursorKey {
+    CursorAlbumArtist,
+    CursorAlbum,
+    CursorDiscNumber,
+    CursorTrackNumber,
+    CursorTitle,
+    CursorDate,
+    CursorModified,
+    CursorFileName,
+    CursorMediaKeys
+};
+
+// Decode the filter's cursor, checking that it was made from the
+// kind of row the query returns.
+static vector<string> get_cursor(const Filter &filter, const string &kind, size_t num_keys) {
+    vector<string> keys = decode_cursor(filter.getCursor());
+    if (keys.size() != num_keys + 1 || keys[0] != kind) {
+        throw runtime_error("Cursor does not match query");
+    }
+    keys.erase(keys.begin());
+    return keys;
+}
+
+// Append conditions to a query as its WHERE clause.
+static void add_where(string &qs, const vector<string> &conditions) {
+    for (size_t i = 0; i < conditions.size(); i++) {
+        qs += i == 0 ? "  WHERE " : " AND ";
+        qs += conditions[i];
+    }
+}
+
+static int64_t cursor_int(const string &key) {
+    char *end = nullptr;
+    errno = 0;
+    long long value = strtoll(key.c_str(), &end, 10);
+    if (key.empty() || *end != '\0' || errno != 0) {
+        throw runtime_error("Malformed cursor");
+    }
+    return value;
+}
+
+// Orderings on a column can resume from a cursor, with the filename
+// breaking ties.  Returns the column and its cursor key, or nullptr
+// for the orderings that have no column, such as rank.
+static const char *media_sort_column(MediaOrder order, int &key) {
+    switch (order) {
+    case MediaOrder::Default:
+    case MediaOrder::Rank:
+        break;
+    case MediaOrder::Title:
+        key = CursorTitle;
+        return "title";
+    case MediaOrder::Date:
+        key = CursorDate;
+        return "date_epoch";
+    case MediaOrder::Modified:
+        key = CursorModified;
+        return "mtime";
+    }
+    return nullptr;
+}
+
+// Append the condition resuming after the filter's cursor, if it has
+// one, and the ORDER BY on a sort column to a query whose WHERE
+// clause has begun.  Returns the keys of the cursor.
+static vector<string> add_media_order(string &qs, const Filter &filter, const char *column, int key) {
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "media", CursorMediaKeys);
+        int64_t date_epoch;
+        if (key == CursorDate && !parse_date(cursor[CursorDate], date_epoch)) {
+            // Media without a date sort first, by filename.
+            qs += filter.getReverse() ? " AND date_epoch IS NULL AND filename < ?"
+                : " AND (date_epoch IS NOT NULL OR filename > ?)";
+        } else if (key == CursorDate && filter.getReverse()) {
+            qs += " AND ((date_epoch, filename) < (?, ?) OR date_epoch IS NULL)";
+        } else {
+            qs += string(" AND (") + column + ", filename)";
+            qs += filter.getReverse() ? " < (?, ?)" : " > (?, ?)";
+        }
+    }
+    const char *direction = filter.getReverse() ? " DESC" : "";
+    qs += string(" ORDER BY ") + column + direction + ", filename" + direction;
+    return cursor;
+}
+
+static void bind_media_cursor(Statement &query, int &param, const vector<string> &cursor, int key) {
+    if (cursor.empty()) {
+        return;
+    }
+    int64_t date_epoch;
+    if (key == CursorDate) {
+        if (parse_date(cursor[key], date_epoch)) {
+            query.bind(param++, date_epoch);
+        }
+    } else if (key == CursorModified) {
+        query.bind(param++, cursor_int(cursor[key]));
+    } else {
+        query.bind(param++, cursor[key]);
+    }
+    query.bind(param++, cursor[CursorFileName]);
+}
+
+// Append the filter's date and modification time ranges to a query
+// whose WHERE clause has begun.
+static void add_media_ranges(string &qs, const Filter &filter) {
+    if (filter.hasDateRange()) {
+        qs += " AND date_epoch >= ? AND date_epoch < ?";
+    }
+    if (filter.hasModifiedRange()) {
+        qs += " AND mtime >= ? AND mtime < ?";
+    }
+}
+
+static void bind_media_ranges(Statement &query, int &param, const Filter &filter) {
+    if (filter.hasDateRange()) {
+        query.bind(param++, filter.getDateStart());
+        query.bind(param++, filter.getDateEnd());
+    }
+    if (filter.hasModifiedRange()) {
+        query.bind(param++, filter.getModifiedStart());
+        query.bind(param++, filter.getModifiedEnd());
+    }
+}
+
+// Append the conditions on songs of the filter's artist, album,
+// album artist, genre and ranges to a query whose WHERE clause has
+// begun.
+static void add_song_conditions(string &qs, const Filter &filter) {
+    if (filter.hasArtist()) {
+        qs += " AND artist = ?";
+    }
+    if (filter.hasAlbum()) {
+        qs += " AND album = ?";
+    }
+    if (filter.hasAlbumArtist()) {
+        qs += " AND album_artist = ?";
+    }
+    if (filter.hasGenre()) {
+        qs += " AND genre = ?";
+    }
+    add_media_ranges(qs, filter);
+}
+
+static void bind_song_conditions(Statement &query, int &param, const Filter &filter) {
+    if (filter.hasArtist()) {
+        query.bind(param++, filter.getArtist());
+    }
+    if (filter.hasAlbum()) {
+        query.bind(param++, filter.getAlbum());
+    }
+    if (filter.hasAlbumArtist()) {
+        query.bind(param++, filter.getAlbumArtist());
+    }
+    if (filter.hasGenre()) {
+        query.bind(param++, filter.getGenre());
+    }
+    bind_media_ranges(query, param, filter);
+}
+
 MediaFile MediaStorePrivate::lookup(const std::string &filename) const {
-    Statement query(db, R"(
+    Statement query(*statements, R"(
 SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type
   FROM media
   WHERE filename = ?
@@ -545,7 +1910,56 @@ SELECT filename, content_type, etag, title, date, artist, album, album_artist, g
     return make_media(query);
 }
 
-vector<MediaFile> MediaStorePrivate::query(const std::string &core_term, MediaType type, const Filter &filter) const {
+std::vector<MediaFile> MediaStorePrivate::lookupMany(const std::vector<std::string> &filenames) const {
+    // The names go in a temporary table, so any number of them can be
+    // matched with one join.  Temporary tables live outside the main
+    // database, so this works on read only connections too.
+    execute_sql(db, R"(
+CREATE TEMP TABLE IF NOT EXISTS lookup_names (
+    position INTEGER PRIMARY KEY,
+    filename TEXT NOT NULL
+);
+DELETE FROM temp.lookup_names;
+)");
+    vector<MediaFile> result;
+    try {
+        Statement insert(*statements, "INSERT INTO temp.lookup_names (position, filename) VALUES (?, ?)");
+        for (size_t i = 0; i < filenames.size(); i++) {
+            insert.bind(1, static_cast<int64_t>(i));
+            insert.bind(2, filenames[i]);
+            insert.step();
+            insert.reset();
+        }
+        insert.finalize();
+
+        Statement query(*statements, R"(
+SELECT media.filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type, media.id IS NOT NULL
+  FROM temp.lookup_names AS wanted
+  LEFT JOIN media ON media.filename = wanted.filename
+  ORDER BY wanted.position
+)");
+        result.reserve(filenames.size());
+        while (query.step()) {
+            if (query.getInt(19)) {
+                result.push_back(make_media(query));
+            } else {
+                result.emplace_back();
+            }
+        }
+    } catch (...) {
+        execute_sql(db, "DELETE FROM temp.lookup_names");
+        throw;
+    }
+    execute_sql(db, "DELETE FROM temp.lookup_names");
+    return result;
+}
+
+void MediaStorePrivate::query(const std::string &core_term, MediaType type, const Filter &filter,
+                              const std::function<bool(Statement&)> &emit) const {
+    const string match = core_term.empty() ? "" : make_fts5_query(core_term);
+    if (!core_term.empty() && match.empty()) {
+        return;
+    }
     string qs(R"(
 SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type
   FROM media
@@ -553,53 +1967,259 @@ SELECT filename, content_type, etag, title, date, artist, album, album_artist, g
     if (!core_term.empty()) {
         qs += R"(
   JOIN (
-    SELECT docid, rank(matchinfo(media_fts), 1.0, 0.5, 0.75) AS rank
+    SELECT rowid, bm25(media_fts, 1.0, 0.5, 0.75) AS rank
       FROM media_fts WHERE media_fts MATCH ?
-    ) AS ranktable ON (media.id = ranktable.docid)
+    ) AS ranktable ON (media.id = ranktable.rowid)
 )";
     }
     qs += " WHERE type = ?";
-    switch (filter.getOrder()) {
-    case MediaOrder::Default:
-    case MediaOrder::Rank:
-        // We can only sort by rank if there was a query term
-        if (!core_term.empty()) {
-            qs += " ORDER BY ranktable.rank";
-            if (!filter.getReverse()) { // Normal order is descending
-                qs += " DESC";
-            }
-        }
-        break;
-    case MediaOrder::Title:
-        qs += " ORDER BY title";
-        if (filter.getReverse()) {
-            qs += " DESC";
-        }
-        break;
-    case MediaOrder::Date:
-        qs += " ORDER BY date";
-        if (filter.getReverse()) {
-            qs += " DESC";
-        }
-        break;
-    case MediaOrder::Modified:
-        qs += " ORDER BY mtime";
+    add_media_ranges(qs, filter);
+    int sort_key = 0;
+    const char *sort_column = media_sort_column(filter.getOrder(), sort_key);
+    vector<string> cursor;
+    if (sort_column) {
+        cursor = add_media_order(qs, filter, sort_column, sort_key);
+    } else if (!core_term.empty()) {
+        // We can only sort by rank if there was a query term.
+        // bm25() gives better matches lower scores.
+        qs += " ORDER BY ranktable.rank";
         if (filter.getReverse()) {
             qs += " DESC";
         }
-        break;
     }
     qs += " LIMIT ? OFFSET ?";
 
-    Statement query(db, qs.c_str());
+    Statement query(*statements, qs);
     int param = 1;
     if (!core_term.empty()) {
-        query.bind(param++, core_term + "*");
+        query.bind(param++, match);
     }
     query.bind(param++, (int)type);
+    bind_media_ranges(query, param, filter);
+    bind_media_cursor(query, param, cursor, sort_key);
     query.bind(param++, filter.getLimit());
-    query.bind(param++, filter.getOffset());
-    return collect_media(query);
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
+    while (query.step()) {
+        if (!emit(query)) {
+            break;
+        }
+    }
+}
+
+// Every media of a type, walking the index on the sort column.  The
+// orders with no column fall back to the title.
+void MediaStorePrivate::listMedia(MediaType type, const Filter &filter,
+                                  const std::function<bool(Statement&)> &emit) const {
+    if (filter.getOrder() != MediaOrder::Default && filter.getOrder() != MediaOrder::Rank) {
+        query("", type, filter, emit);
+        return;
+    }
+    Filter ordered(filter);
+    ordered.setOrder(MediaOrder::Title);
+    query("", type, ordered, emit);
+}
+
+// A condition on media selecting the rows located in a box.  The
+// R*Tree finds the candidates, but keeps its coordinates as 32 bit
+// floats rounded outwards, so the media's own columns decide rows
+// near the edges.
+static string location_condition(const GeoBox &box) {
+    const bool crosses = box.west > box.east;
+    string sql = "id IN (SELECT id FROM media_location WHERE max_latitude >= ? AND min_latitude <= ? AND max_longitude >= ? AND min_longitude <= ?";
+    if (crosses) {
+        sql += " UNION ALL SELECT id FROM media_location WHERE max_latitude >= ? AND min_latitude <= ? AND max_longitude >= ? AND min_longitude <= ?";
+    }
+    sql += ") AND latitude BETWEEN ? AND ?";
+    sql += crosses ? " AND (longitude >= ? OR longitude <= ?)" : " AND longitude BETWEEN ? AND ?";
+    return sql;
+}
+
+static void bind_location(Statement &query, int &param, const GeoBox &box) {
+    const bool crosses = box.west > box.east;
+    query.bind(param++, box.south);
+    query.bind(param++, box.north);
+    query.bind(param++, box.west);
+    query.bind(param++, crosses ? 180.0 : box.east);
+    if (crosses) {
+        query.bind(param++, box.south);
+        query.bind(param++, box.north);
+        query.bind(param++, -180.0);
+        query.bind(param++, box.east);
+    }
+    query.bind(param++, box.south);
+    query.bind(param++, box.north);
+    query.bind(param++, box.west);
+    query.bind(param++, box.east);
+}
+
+void MediaStorePrivate::queryBoundingBox(const GeoBox &box, MediaType type, const Filter &filter,
+                                         const std::function<bool(Statement&)> &emit) const {
+    string qs(R"(
+SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type
+  FROM media
+)");
+    qs += "  WHERE " + location_condition(box);
+    if (type != AllMedia) {
+        qs += " AND type = ?";
+    }
+    add_media_ranges(qs, filter);
+    int sort_key = 0;
+    const char *sort_column = media_sort_column(filter.getOrder(), sort_key);
+    vector<string> cursor;
+    if (sort_column) {
+        cursor = add_media_order(qs, filter, sort_column, sort_key);
+    }
+    qs += " LIMIT ? OFFSET ?";
+
+    Statement query(*statements, qs);
+    int param = 1;
+    bind_location(query, param, box);
+    if (type != AllMedia) {
+        query.bind(param++, (int)type);
+    }
+    bind_media_ranges(query, param, filter);
+    bind_media_cursor(query, param, cursor, sort_key);
+    query.bind(param++, filter.getLimit());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
+    while (query.step()) {
+        if (!emit(query)) {
+            break;
+        }
+    }
+}
+
+static const double DEGREES_PER_RADIAN = 180 / M_PI;
+
+// The great circle distance between two points, in radians.
+static double angular_distance(double latitude1, double longitude1,
+                               double latitude2, double longitude2) {
+    const double lat1 = latitude1 / DEGREES_PER_RADIAN;
+    const double lat2 = latitude2 / DEGREES_PER_RADIAN;
+    const double dlat = lat2 - lat1;
+    const double dlon = (longitude2 - longitude1) / DEGREES_PER_RADIAN;
+    const double a = sin(dlat / 2) * sin(dlat / 2) +
+        cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+    return 2 * asin(std::min(1.0, sqrt(a)));
+}
+
+// The smallest box holding every point within a distance, in radians,
+// of the given point.
+static GeoBox box_around(double latitude, double longitude, double distance) {
+    GeoBox box;
+    box.south = latitude - distance * DEGREES_PER_RADIAN;
+    box.north = latitude + distance * DEGREES_PER_RADIAN;
+    if (box.south <= -90 || box.north >= 90) {
+        // A pole is inside, and with it every longitude.
+        box.south = std::max(box.south, -90.0);
+        box.north = std::min(box.north, 90.0);
+        box.west = -180;
+        box.east = 180;
+        return box;
+    }
+    const double reach = asin(std::min(1.0, sin(distance) / cos(latitude / DEGREES_PER_RADIAN)));
+    box.west = longitude - reach * DEGREES_PER_RADIAN;
+    box.east = longitude + reach * DEGREES_PER_RADIAN;
+    if (box.west < -180) {
+        box.west += 360;
+    }
+    if (box.east > 180) {
+        box.east -= 360;
+    }
+    return box;
+}
+
+// About a kilometre.
+static const double FIRST_SEARCH_DISTANCE = 1.0 / 6371;
+
+std::vector<MediaFile> MediaStorePrivate::queryNearest(double latitude, double longitude, MediaType type, const Filter &filter) const {
+    const size_t offset = std::max(filter.getOffset(), 0);
+    const size_t wanted = filter.getLimit() < 0 ? SIZE_MAX : offset + filter.getLimit();
+
+    // Search ever wider boxes until the circle inside one holds
+    // enough media, or it takes in the whole world.  Only the ids
+    // and locations are read until the nearest are known.
+    vector<pair<double, int64_t>> found;
+    double distance = FIRST_SEARCH_DISTANCE;
+    while (true) {
+        const GeoBox box = box_around(latitude, longitude, distance);
+        string qs = "SELECT id, latitude, longitude FROM media WHERE " + location_condition(box);
+        if (type != AllMedia) {
+            qs += " AND type = ?";
+        }
+        add_media_ranges(qs, filter);
+        Statement query(*statements, qs);
+        int param = 1;
+        bind_location(query, param, box);
+        if (type != AllMedia) {
+            query.bind(param++, (int)type);
+        }
+        bind_media_ranges(query, param, filter);
+        found.clear();
+        while (query.step()) {
+            const double d = angular_distance(latitude, longitude,
+                                              query.getDouble(1), query.getDouble(2));
+            // Media in the corners of the box may be further away
+            // than media outside it.
+            if (d <= distance) {
+                found.emplace_back(d, query.getInt64(0));
+            }
+        }
+        if (found.size() >= wanted || distance >= M_PI) {
+            break;
+        }
+        distance = std::min(distance * 4, M_PI);
+    }
+    sort(found.begin(), found.end());
+
+    vector<MediaFile> result;
+    Statement select(*statements, R"(
+SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type
+  FROM media
+  WHERE id = ?
+)");
+    for (size_t i = offset; i < found.size() && i < wanted; i++) {
+        select.bind(1, found[i].second);
+        if (select.step()) {
+            result.push_back(make_media(select));
+        }
+        select.reset();
+    }
+    return result;
+}
+
+std::vector<TimelineEntry> MediaStorePrivate::timeline(MediaType type, TimelineInterval interval, const Filter &filter) const {
+    // Count by day with integer arithmetic, which the date index
+    // feeds in order, and only then group the days into months or
+    // years.
+    string days = "SELECT date_epoch - (date_epoch % 86400 + 86400) % 86400 AS day, count(*) AS n FROM media WHERE date_epoch IS NOT NULL";
+    if (type != AllMedia) {
+        days += " AND type = ?";
+    }
+    add_media_ranges(days, filter);
+    days += " GROUP BY day";
+    string qs;
+    switch (interval) {
+    case TimelineInterval::Day:
+        qs = days + " ORDER BY day";
+        break;
+    case TimelineInterval::Month:
+    case TimelineInterval::Year:
+        qs = string("SELECT CAST(strftime('%s', day, 'unixepoch', ") +
+            (interval == TimelineInterval::Month ? "'start of month'" : "'start of year'") +
+            ") AS INTEGER) AS start, sum(n) FROM (" + days + ") GROUP BY start ORDER BY start";
+        break;
+    }
+    Statement query(*statements, qs);
+    int param = 1;
+    if (type != AllMedia) {
+        query.bind(param++, (int)type);
+    }
+    bind_media_ranges(query, param, filter);
+    vector<TimelineEntry> result;
+    while (query.step()) {
+        result.emplace_back(query.getInt64(0), query.getInt(1));
+    }
+    return result;
 }
 
 static Album make_album(Statement &query) {
@@ -622,17 +2242,27 @@ static vector<Album> collect_albums(Statement &query) {
 }
 
 vector<Album> MediaStorePrivate::queryAlbums(const std::string &core_term, const Filter &filter) const {
+    const string match = core_term.empty() ? "" : make_fts5_query(core_term);
+    if (!core_term.empty() && match.empty()) {
+        return {};
+    }
     string qs(R"(
-SELECT album, album_artist, first(date) as date, first(genre) as genre, first(filename) as filename, first(has_thumbnail) as has_thumbnail, count(distinct album_artist) as artist_count, first(mtime) as mtime FROM media
-WHERE type = ? AND album <> ''
+SELECT album, album_artist, date, genre, filename, has_thumbnail, count(*) AS artist_count, mtime FROM album_summary
+WHERE album <> ''
 )");
     if (!core_term.empty()) {
-        qs += " AND id IN (SELECT docid FROM media_fts WHERE media_fts MATCH ?)";
+        qs += " AND (album, album_artist) IN (SELECT album, album_artist FROM media WHERE type = ? AND id IN (SELECT rowid FROM media_fts WHERE media_fts MATCH ?))";
     }
-    qs += " GROUP BY album";
+    // Only the album title ordering can resume from a cursor.
+    vector<string> cursor;
     switch (filter.getOrder()) {
     case MediaOrder::Default:
     case MediaOrder::Title:
+        if (filter.hasCursor()) {
+            cursor = get_cursor(filter, "album", 1);
+            qs += filter.getReverse() ? " AND album < ?" : " AND album > ?";
+        }
+        qs += " GROUP BY album";
         qs += " ORDER BY album";
         if (filter.getReverse()) {
             qs += " DESC";
@@ -643,6 +2273,7 @@ WHERE type = ? AND album <> ''
     case MediaOrder::Date:
         throw std::runtime_error("Can not query albums by date");
     case MediaOrder::Modified:
+        qs += " GROUP BY album";
         qs += " ORDER BY mtime";
         if (filter.getReverse()) {
             qs += " DESC";
@@ -651,24 +2282,36 @@ WHERE type = ? AND album <> ''
     }
     qs += " LIMIT ? OFFSET ?";
 
-    Statement query(db, qs.c_str());
+    Statement query(*statements, qs);
     int param = 1;
-    query.bind(param++, (int)AudioMedia);
     if (!core_term.empty()) {
-        query.bind(param++, core_term + "*");
+        query.bind(param++, (int)AudioMedia);
+        query.bind(param++, match);
+    }
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[0]);
     }
     query.bind(param++, filter.getLimit());
-    query.bind(param++, filter.getOffset());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
     return collect_albums(query);
 }
 
 vector<string> MediaStorePrivate::queryArtists(const string &q, const Filter &filter) const {
+    const string match = q.empty() ? "" : make_fts5_query(q);
+    if (!q.empty() && match.empty()) {
+        return {};
+    }
     string qs(R"(
-SELECT artist FROM media
-WHERE type = ? AND artist <> ''
+SELECT artist FROM artist_summary
+WHERE artist <> ''
 )");
     if (!q.empty()) {
-        qs += "AND id IN (SELECT docid FROM media_fts WHERE media_fts MATCH ?)";
+        qs += "AND artist IN (SELECT artist FROM media WHERE type = ? AND id IN (SELECT rowid FROM media_fts WHERE media_fts MATCH ?))";
+    }
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "name", 1);
+        qs += filter.getReverse() ? " AND artist < ?" : " AND artist > ?";
     }
     qs += " GROUP BY artist";
     switch (filter.getOrder()) {
@@ -688,14 +2331,17 @@ WHERE type = ? AND artist <> ''
     }
     qs += " LIMIT ? OFFSET ?";
 
-    Statement query(db, qs.c_str());
+    Statement query(*statements, qs);
     int param = 1;
-    query.bind(param++, (int)AudioMedia);
     if (!q.empty()) {
-        query.bind(param++, q + "*");
+        query.bind(param++, (int)AudioMedia);
+        query.bind(param++, match);
+    }
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[0]);
     }
     query.bind(param++, filter.getLimit());
-    query.bind(param++, filter.getOffset());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
     vector<string> result;
     while (query.step()) {
         result.push_back(query.getText(0));
@@ -704,7 +2350,7 @@ WHERE type = ? AND artist <> ''
 }
 
 vector<MediaFile> MediaStorePrivate::getAlbumSongs(const Album& album) const {
-    Statement query(db, R"(
+    Statement query(*statements, R"(
 SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type FROM media
 WHERE album = ? AND album_artist = ? AND type = ?
 ORDER BY disc_number, track_number
@@ -716,7 +2362,7 @@ ORDER BY disc_number, track_number
 }
 
 std::string MediaStorePrivate::getETag(const std::string &filename) const {
-    Statement query(db, R"(
+    Statement query(*statements, R"(
 SELECT etag FROM media WHERE filename = ?
 )");
     query.bind(1, filename);
@@ -727,107 +2373,128 @@ SELECT etag FROM media WHERE filename = ?
     }
 }
 
-std::vector<MediaFile> MediaStorePrivate::listSongs(const Filter &filter) const {
+void MediaStorePrivate::listSongs(const Filter &filter,
+                                  const std::function<bool(Statement&)> &emit) const {
     std::string qs(R"(
 SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type
   FROM media
   WHERE type = ?
 )");
-    if (filter.hasArtist()) {
-        qs += " AND artist = ?";
-    }
-    if (filter.hasAlbum()) {
-        qs += " AND album = ?";
-    }
-    if (filter.hasAlbumArtist()) {
-        qs += " AND album_artist = ?";
-    }
-    if (filter.hasGenre()) {
-        qs += " AND genre = ?";
+    add_song_conditions(qs, filter);
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "media", CursorMediaKeys);
+        qs += " AND (album_artist, album, disc_number, track_number, title, filename) > (?, ?, ?, ?, ?, ?)";
     }
     qs += R"(
-ORDER BY album_artist, album, disc_number, track_number, title
+ORDER BY album_artist, album, disc_number, track_number, title, filename
 LIMIT ? OFFSET ?
 )";
-    Statement query(db, qs.c_str());
+    Statement query(*statements, qs);
     int param = 1;
     query.bind(param++, (int)AudioMedia);
-    if (filter.hasArtist()) {
-        query.bind(param++, filter.getArtist());
-    }
-    if (filter.hasAlbum()) {
-        query.bind(param++, filter.getAlbum());
-    }
-    if (filter.hasAlbumArtist()) {
-        query.bind(param++, filter.getAlbumArtist());
-    }
-    if (filter.hasGenre()) {
-        query.bind(param++, filter.getGenre());
+    bind_song_conditions(query, param, filter);
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[CursorAlbumArtist]);
+        query.bind(param++, cursor[CursorAlbum]);
+        query.bind(param++, cursor_int(cursor[CursorDiscNumber]));
+        query.bind(param++, cursor_int(cursor[CursorTrackNumber]));
+        query.bind(param++, cursor[CursorTitle]);
+        query.bind(param++, cursor[CursorFileName]);
     }
     query.bind(param++, filter.getLimit());
-    query.bind(param++, filter.getOffset());
-
-    return collect_media(query);
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
+    while (query.step()) {
+        if (!emit(query)) {
+            break;
+        }
+    }
 }
 
 std::vector<Album> MediaStorePrivate::listAlbums(const Filter &filter) const {
     std::string qs(R"(
-SELECT album, album_artist, first(date) as date, first(genre) as genre, first(filename) as filename, first(has_thumbnail) as has_thumbnail, count(distinct album_artist) as artist_count FROM media
-  WHERE type = ?
+SELECT album, album_artist, date, genre, filename, has_thumbnail, count(*) AS artist_count FROM album_summary
 )");
-    if (filter.hasArtist()) {
-        qs += " AND artist = ?";
+    vector<string> conditions;
+    if (filter.hasArtist() || filter.hasGenre()) {
+        // Artist and genre are per track, so look for albums
+        // containing a matching track.
+        string tracks = "(album, album_artist) IN (SELECT album, album_artist FROM media WHERE type = ?";
+        if (filter.hasArtist()) {
+            tracks += " AND artist = ?";
+        }
+        if (filter.hasGenre()) {
+            tracks += " AND genre = ?";
+        }
+        tracks += ")";
+        conditions.push_back(tracks);
     }
     if (filter.hasAlbumArtist()) {
-        qs += " AND album_artist = ?";
+        conditions.push_back("album_artist = ?");
     }
-    if (filter.hasGenre()) {
-        qs += "AND genre = ?";
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "album", 1);
+        conditions.push_back("album > ?");
     }
+    add_where(qs, conditions);
     qs += R"(
 GROUP BY album
 ORDER BY album
 LIMIT ? OFFSET ?
 )";
-    Statement query(db, qs.c_str());
+    Statement query(*statements, qs);
     int param = 1;
-    query.bind(param++, (int)AudioMedia);
-    if (filter.hasArtist()) {
-        query.bind(param++, filter.getArtist());
+    if (filter.hasArtist() || filter.hasGenre()) {
+        query.bind(param++, (int)AudioMedia);
+        if (filter.hasArtist()) {
+            query.bind(param++, filter.getArtist());
+        }
+        if (filter.hasGenre()) {
+            query.bind(param++, filter.getGenre());
+        }
     }
     if (filter.hasAlbumArtist()) {
         query.bind(param++, filter.getAlbumArtist());
     }
-    if (filter.hasGenre()) {
-        query.bind(param++, filter.getGenre());
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[0]);
     }
     query.bind(param++, filter.getLimit());
-    query.bind(param++, filter.getOffset());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
 
     return collect_albums(query);
 }
 
 vector<std::string> MediaStorePrivate::listArtists(const Filter &filter) const {
     string qs(R"(
-SELECT artist FROM media
-  WHERE type = ?
+SELECT artist FROM artist_summary
 )");
+    vector<string> conditions;
     if (filter.hasGenre()) {
-        qs += " AND genre = ?";
+        conditions.push_back("genre = ?");
     }
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "name", 1);
+        conditions.push_back("artist > ?");
+    }
+    add_where(qs, conditions);
     qs += R"(
   GROUP BY artist
   ORDER BY artist
   LIMIT ? OFFSET ?
 )";
-    Statement query(db, qs.c_str());
+    Statement query(*statements, qs);
     int param = 1;
-    query.bind(param++, (int)AudioMedia);
     if (filter.hasGenre()) {
         query.bind(param++, filter.getGenre());
     }
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[0]);
+    }
     query.bind(param++, filter.getLimit());
-    query.bind(param++, filter.getOffset());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
 
     vector<string> artists;
     while (query.step()) {
@@ -838,25 +2505,33 @@ SELECT artist FROM media
 
 vector<std::string> MediaStorePrivate::listAlbumArtists(const Filter &filter) const {
     string qs(R"(
-SELECT album_artist FROM media
-  WHERE type = ?
+SELECT album_artist FROM album_artist_summary
 )");
+    vector<string> conditions;
     if (filter.hasGenre()) {
-        qs += " AND genre = ?";
+        conditions.push_back("genre = ?");
+    }
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "name", 1);
+        conditions.push_back("album_artist > ?");
     }
+    add_where(qs, conditions);
     qs += R"(
   GROUP BY album_artist
   ORDER BY album_artist
   LIMIT ? OFFSET ?
 )";
-    Statement query(db, qs.c_str());
+    Statement query(*statements, qs);
     int param = 1;
-    query.bind(param++, (int)AudioMedia);
     if (filter.hasGenre()) {
         query.bind(param++, filter.getGenre());
     }
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[0]);
+    }
     query.bind(param++, filter.getLimit());
-    query.bind(param++, filter.getOffset());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
 
     vector<string> artists;
     while (query.step()) {
@@ -866,16 +2541,25 @@ SELECT album_artist FROM media
 }
 
 vector<std::string> MediaStorePrivate::listGenres(const Filter &filter) const {
-    Statement query(db, R"(
-SELECT genre FROM media
-  WHERE type = ?
-  GROUP BY genre
+    string qs(R"(
+SELECT genre FROM genre_summary
+)");
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "name", 1);
+        qs += "  WHERE genre > ?";
+    }
+    qs += R"(
   ORDER BY genre
   LIMIT ? OFFSET ?
-)");
-    query.bind(1, (int)AudioMedia);
-    query.bind(2, filter.getLimit());
-    query.bind(3, filter.getOffset());
+)";
+    Statement query(*statements, qs);
+    int param = 1;
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[0]);
+    }
+    query.bind(param++, filter.getLimit());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
 
     vector<string> genres;
     while (query.step()) {
@@ -886,13 +2570,13 @@ SELECT genre FROM media
 
 bool MediaStorePrivate::hasMedia(MediaType type) const {
     if (type == AllMedia) {
-        Statement query(db, R"(
+        Statement query(*statements, R"(
 SELECT id FROM media
   LIMIT 1
 )");
         return query.step();
     } else {
-        Statement query(db, R"(
+        Statement query(*statements, R"(
 SELECT id FROM media
   WHERE type = ?
   LIMIT 1
@@ -902,101 +2586,602 @@ SELECT id FROM media
     }
 }
 
-void MediaStorePrivate::pruneDeleted() {
-    std::map<std::string, bool> path_cache;
-    vector<string> deleted;
-    Statement query(db, "SELECT filename FROM media");
+// Whether the songs matching a filter can be totalled from the
+// artist, album artist and genre summaries.
+static bool summarized_songs(const Filter &filter) {
+    return !filter.hasAlbum() && !(filter.hasArtist() && filter.hasAlbumArtist()) &&
+        !filter.hasDateRange() && !filter.hasModifiedRange();
+}
+
+int64_t MediaStorePrivate::count(MediaType type, const Filter &filter) const {
+    if (type == AudioMedia) {
+        return aggregate(filter).count;
+    }
+    string qs;
+    if (filter.hasDateRange() || filter.hasModifiedRange()) {
+        qs = "SELECT count(*) FROM media WHERE ";
+        qs += type == AllMedia ? "type IS NOT NULL" : "type = ?";
+        add_media_ranges(qs, filter);
+    } else {
+        qs = "SELECT ifnull(sum(media_count), 0) FROM media_type_summary";
+        if (type != AllMedia) {
+            qs += " WHERE type = ?";
+        }
+    }
+    Statement query(*statements, qs);
+    int param = 1;
+    if (type != AllMedia) {
+        query.bind(param++, (int)type);
+    }
+    bind_media_ranges(query, param, filter);
+    query.step();
+    return query.getInt64(0);
+}
+
+Aggregate MediaStorePrivate::aggregate(const Filter &filter) const {
+    if (!summarized_songs(filter)) {
+        // Narrowed to an album or by date, so the index finds few
+        // enough rows to total them directly.
+        string qs = "SELECT count(*), ifnull(sum(duration), 0), count(DISTINCT album), count(DISTINCT artist) FROM media WHERE type = ?";
+        add_song_conditions(qs, filter);
+        Statement query(*statements, qs);
+        int param = 1;
+        query.bind(param++, (int)AudioMedia);
+        bind_song_conditions(query, param, filter);
+        query.step();
+        return Aggregate(query.getInt64(0), query.getInt64(1), query.getInt64(2), query.getInt64(3));
+    }
+
+    Aggregate result;
+    {
+        string qs;
+        if (filter.hasArtist()) {
+            qs = "SELECT ifnull(sum(track_count), 0), ifnull(sum(duration), 0) FROM artist_summary WHERE artist = ?";
+        } else if (filter.hasAlbumArtist()) {
+            qs = "SELECT ifnull(sum(track_count), 0), ifnull(sum(duration), 0) FROM album_artist_summary WHERE album_artist = ?";
+        } else if (filter.hasGenre()) {
+            qs = "SELECT track_count, duration FROM genre_summary WHERE genre = ?";
+        } else {
+            qs = "SELECT media_count, duration FROM media_type_summary WHERE type = 1";
+        }
+        if (filter.hasGenre() && (filter.hasArtist() || filter.hasAlbumArtist())) {
+            qs += " AND genre = ?";
+        }
+        Statement query(*statements, qs);
+        int param = 1;
+        if (filter.hasArtist()) {
+            query.bind(param++, filter.getArtist());
+        } else if (filter.hasAlbumArtist()) {
+            query.bind(param++, filter.getAlbumArtist());
+        }
+        if (filter.hasGenre()) {
+            query.bind(param++, filter.getGenre());
+        }
+        if (query.step()) {
+            result.count = query.getInt64(0);
+            result.duration = query.getInt64(1);
+        }
+    }
+    {
+        // The albums listAlbums() would return.
+        string qs = "SELECT count(DISTINCT album) FROM album_summary";
+        vector<string> conditions;
+        if (filter.hasArtist() || filter.hasGenre()) {
+            string tracks = "(album, album_artist) IN (SELECT album, album_artist FROM media WHERE type = ?";
+            if (filter.hasArtist()) {
+                tracks += " AND artist = ?";
+            }
+            if (filter.hasGenre()) {
+                tracks += " AND genre = ?";
+            }
+            tracks += ")";
+            conditions.push_back(tracks);
+        }
+        if (filter.hasAlbumArtist()) {
+            conditions.push_back("album_artist = ?");
+        }
+        add_where(qs, conditions);
+        Statement query(*statements, qs);
+        int param = 1;
+        if (filter.hasArtist() || filter.hasGenre()) {
+            query.bind(param++, (int)AudioMedia);
+            if (filter.hasArtist()) {
+                query.bind(param++, filter.getArtist());
+            }
+            if (filter.hasGenre()) {
+                query.bind(param++, filter.getGenre());
+            }
+        }
+        if (filter.hasAlbumArtist()) {
+            query.bind(param++, filter.getAlbumArtist());
+        }
+        query.step();
+        result.albums = query.getInt64(0);
+    }
+    if (filter.hasArtist()) {
+        result.artists = result.count > 0 ? 1 : 0;
+    } else {
+        string qs;
+        if (filter.hasAlbumArtist()) {
+            qs = "SELECT count(DISTINCT artist) FROM media WHERE type = 1 AND album_artist = ?";
+            if (filter.hasGenre()) {
+                qs += " AND genre = ?";
+            }
+        } else {
+            qs = "SELECT count(DISTINCT artist) FROM artist_summary";
+            if (filter.hasGenre()) {
+                qs += " WHERE genre = ?";
+            }
+        }
+        Statement query(*statements, qs);
+        int param = 1;
+        if (filter.hasAlbumArtist()) {
+            query.bind(param++, filter.getAlbumArtist());
+        }
+        if (filter.hasGenre()) {
+            query.bind(param++, filter.getGenre());
+        }
+        query.step();
+        result.artists = query.getInt64(0);
+    }
+    return result;
+}
+
+std::vector<Facet> MediaStorePrivate::facets(FacetField field, const Filter &filter) const {
+    string column;
+    switch (field) {
+    case FacetField::Artist:
+        column = "artist";
+        break;
+    case FacetField::AlbumArtist:
+        column = "album_artist";
+        break;
+    case FacetField::Genre:
+        column = "genre";
+        break;
+    case FacetField::Year:
+        column = "strftime('%Y', date_epoch, 'unixepoch')";
+        break;
+    default:
+        throw invalid_argument("Unknown facet field");
+    }
+    // The type is spelled out so the partial artist and genre indexes
+    // can feed the grouping in order.
+    string qs = "SELECT " + column + " AS value, count(*), count(DISTINCT album), ifnull(sum(duration), 0) FROM media WHERE type = 1";
+    add_song_conditions(qs, filter);
+    if (field == FacetField::Year) {
+        qs += " AND date_epoch IS NOT NULL";
+    }
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "name", 1);
+        qs += " AND " + column + " > ?";
+    }
+    qs += " GROUP BY value ORDER BY value LIMIT ? OFFSET ?";
+
+    Statement query(*statements, qs);
+    int param = 1;
+    bind_song_conditions(query, param, filter);
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[0]);
+    }
+    query.bind(param++, filter.getLimit());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
+    vector<Facet> result;
+    while (query.step()) {
+        result.emplace_back(query.getText(0), query.getInt64(1), query.getInt64(2), query.getInt64(3));
+    }
+    return result;
+}
+
+Folder MediaStorePrivate::listFolder(const std::string &path, const Filter &filter) const {
+    const string directory = normalize_directory(path);
+    int64_t dir_id = directoryId(directory, false);
+    if (dir_id < 0) {
+        return Folder(directory, 0);
+    }
+
+    // Count the media below each subfolder, leaving out those
+    // without any.
+    vector<Folder> subfolders;
+    int media_count = 0;
+    Statement children(*statements, R"(
+WITH RECURSIVE tree(id, child) AS (
+    SELECT id, id FROM directories WHERE parent_id = ?
+    UNION ALL
+    SELECT directories.id, tree.child FROM directories JOIN tree ON directories.parent_id = tree.id)
+SELECT child.name, count(*)
+  FROM tree
+  JOIN directories AS child ON child.id = tree.child
+  JOIN media ON media.dir_id = tree.id
+  GROUP BY tree.child
+  ORDER BY child.name
+)");
+    children.bind(1, dir_id);
+    const string prefix = directory == "/" ? directory : directory + "/";
+    while (children.step()) {
+        int count = children.getInt(1);
+        subfolders.emplace_back(prefix + children.getText(0), count);
+        media_count += count;
+    }
+    children.finalize();
+
+    Statement count(*statements, "SELECT count(*) FROM media WHERE dir_id = ?");
+    count.bind(1, dir_id);
+    count.step();
+    media_count += count.getInt(0);
+    count.finalize();
+
+    string qs(R"(
+SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type
+  FROM media
+  WHERE dir_id = ?
+)");
+    vector<string> cursor;
+    if (filter.hasCursor()) {
+        cursor = get_cursor(filter, "media", CursorMediaKeys);
+        qs += " AND filename > ?";
+    }
+    qs += R"(
+ORDER BY filename
+LIMIT ? OFFSET ?
+)";
+    Statement query(*statements, qs);
+    int param = 1;
+    query.bind(param++, dir_id);
+    if (!cursor.empty()) {
+        query.bind(param++, cursor[CursorFileName]);
+    }
+    query.bind(param++, filter.getLimit());
+    query.bind(param++, cursor.empty() ? filter.getOffset() : 0);
+
+    return Folder(directory, media_count, subfolders, collect_media(query));
+}
+
+std::vector<std::string> MediaStorePrivate::listFilenames() const {
+    vector<string> filenames;
+    Statement query(*statements, "SELECT filename FROM media");
     while (query.step()) {
-        const string filename = query.getText(0);
-        if (access(filename.c_str(), F_OK) != 0 ||
-            has_block_in_path(path_cache, filename)) {
-            deleted.push_back(filename);
-            continue;
+        filenames.push_back(query.getText(0));
+    }
+    return filenames;
+}
+
+void MediaStorePrivate::prune(const PrunePlan &plan) {
+    int deleted = 0;
+    savepoint("prune");
+    try {
+        Statement del_subtree(*statements, "DELETE FROM media WHERE filename >= ? AND filename < ?");
+        for (const auto &directory : plan.subtrees) {
+            // Match every filename starting with "directory/", using
+            // the fact that '0' sorts directly after '/'.
+            string start = directory == "/" ? directory : directory + "/";
+            string end = start;
+            end.back() = '0';
+            del_subtree.bind(1, start);
+            del_subtree.bind(2, end);
+            del_subtree.step();
+            del_subtree.reset();
+            deleted += sqlite3_changes(db);
+            int64_t dir_id = directoryId(directory, false);
+            if (dir_id >= 0) {
+                removeEmptyDirectories(dir_id);
+            }
+        }
+        Statement del(*statements, "DELETE FROM media WHERE filename = ?");
+        for (const auto &fname : plan.files) {
+            del.bind(1, fname);
+            del.step();
+            del.reset();
+            deleted += sqlite3_changes(db);
         }
+    } catch (...) {
+        rollback_to("prune");
+        throw;
     }
-    query.finalize();
-    printf("%d files deleted from disk or in scanblocked directories.\n", (int)deleted.size());
-    for(const auto &i : deleted) {
-        remove(i);
+    release("prune");
+    printf("%d files deleted from disk or in scanblocked directories.\n", deleted);
+}
+
+// Move the media in a directory and its subdirectories from one
+// table to another.
+static void move_subtree(MediaStorePrivate &d, const char *savepoint,
+                         const string &from, const string &to, int64_t dir_id) {
+    d.savepoint(savepoint);
+    try {
+        Statement copy(*d.statements, "INSERT INTO " + to + " (filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type, dir_id, date_epoch)\n"
+                       "  SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type, dir_id, date_epoch\n"
+                       "    FROM " + from + " WHERE dir_id IN (" + subtree_sql + ")");
+        copy.bind(1, dir_id);
+        copy.step();
+        Statement del(*d.statements, "DELETE FROM " + from + " WHERE dir_id IN (" + subtree_sql + ")");
+        del.bind(1, dir_id);
+        del.step();
+        d.removeEmptyDirectories(dir_id);
+    } catch (...) {
+        d.rollback_to(savepoint);
+        throw;
     }
+    d.release(savepoint);
 }
 
 void MediaStorePrivate::archiveItems(const std::string &prefix) {
-    const char *templ = R"(BEGIN TRANSACTION;
-INSERT INTO media_attic (filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type)
-  SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type
-    FROM media WHERE filename LIKE %s;
-DELETE FROM media WHERE filename LIKE %s;
-COMMIT;
-)";
-    string cond = sqlQuote(prefix + "%");
-    const size_t bufsize = 1024;
-    char cmd[bufsize];
-    snprintf(cmd, bufsize, templ, cond.c_str(), cond.c_str());
-    char *errmsg;
-    if(sqlite3_exec(db, cmd, nullptr, nullptr, &errmsg) != SQLITE_OK) {
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        throw runtime_error(errmsg);
+    int64_t dir_id = directoryId(normalize_directory(prefix), false);
+    if (dir_id >= 0) {
+        move_subtree(*this, "archive", "media", "media_attic", dir_id);
     }
 }
 
 void MediaStorePrivate::restoreItems(const std::string &prefix) {
-    const char *templ = R"(BEGIN TRANSACTION;
-INSERT INTO media (filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type)
-  SELECT filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type
-    FROM media_attic WHERE filename LIKE %s;
-DELETE FROM media_attic WHERE filename LIKE %s;
-COMMIT;
-)";
-    string cond = sqlQuote(prefix + "%");
-    const size_t bufsize = 1024;
-    char cmd[bufsize];
-    snprintf(cmd, bufsize, templ, cond.c_str(), cond.c_str());
-    char *errmsg;
-    if(sqlite3_exec(db, cmd, nullptr, nullptr, &errmsg) != SQLITE_OK) {
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        throw runtime_error(errmsg);
+    int64_t dir_id = directoryId(normalize_directory(prefix), false);
+    if (dir_id >= 0) {
+        move_subtree(*this, "restore", "media_attic", "media", dir_id);
     }
-
 }
 
 void MediaStorePrivate::removeSubtree(const std::string &directory) {
-    string escaped = directory;
-    string::size_type pos = 0;
-    // Escape instances of like expression special characters and the escape character.
-    while (true) {
-        pos = escaped.find_first_of("%_!", pos);
-        if (pos == string::npos) {
+    int64_t dir_id = directoryId(normalize_directory(directory), false);
+    if (dir_id < 0) {
+        return;
+    }
+    savepoint("remove");
+    try {
+        Statement query(*statements, string("DELETE FROM media WHERE dir_id IN (") + subtree_sql + ")");
+        query.bind(1, dir_id);
+        query.step();
+        removeEmptyDirectories(dir_id);
+    } catch (...) {
+        rollback_to("remove");
+        throw;
+    }
+    release("remove");
+}
+
+// Delete the directories at and below dir_id that no longer hold any
+// media, archived or not, and then the ones above it that were only
+// left holding them.
+void MediaStorePrivate::removeEmptyDirectories(int64_t dir_id) {
+    // The last directory looked up may be one of them.
+    last_directory.clear();
+    Statement parent(*statements, "SELECT parent_id FROM directories WHERE id = ?");
+    parent.bind(1, dir_id);
+    if (!parent.step()) {
+        return;
+    }
+    int64_t parent_id = parent.getInt64(0);
+    parent.reset();
+
+    // A directory is still used if it or one below it holds media.
+    Statement del_subtree(*statements, R"(
+WITH RECURSIVE subtree(id) AS (
+    SELECT ?1
+    UNION ALL
+    SELECT directories.id FROM directories JOIN subtree ON directories.parent_id = subtree.id),
+  used(id) AS (
+    SELECT id FROM subtree
+      WHERE EXISTS (SELECT 1 FROM media WHERE dir_id = subtree.id)
+         OR EXISTS (SELECT 1 FROM media_attic WHERE dir_id = subtree.id)
+    UNION
+    SELECT directories.parent_id FROM directories JOIN used ON directories.id = used.id
+      WHERE used.id <> ?1)
+DELETE FROM directories WHERE id IN subtree AND id NOT IN used AND id <> ?2
+)");
+    del_subtree.bind(1, dir_id);
+    del_subtree.bind(2, root_directory_id);
+    del_subtree.step();
+
+    Statement empty(*statements, R"(
+SELECT NOT EXISTS (SELECT 1 FROM directories WHERE parent_id = ?1)
+   AND NOT EXISTS (SELECT 1 FROM media WHERE dir_id = ?1)
+   AND NOT EXISTS (SELECT 1 FROM media_attic WHERE dir_id = ?1)
+)");
+    Statement del(*statements, "DELETE FROM directories WHERE id = ?");
+    while (parent_id > root_directory_id) {
+        empty.bind(1, parent_id);
+        empty.step();
+        const bool is_empty = empty.getInt(0) != 0;
+        empty.reset();
+        if (!is_empty) {
             break;
         }
-        escaped.replace(pos, 0, "!");
-        pos += 2;
+        parent.bind(1, parent_id);
+        parent.step();
+        const int64_t next = parent.getInt64(0);
+        parent.reset();
+        del.bind(1, parent_id);
+        del.step();
+        del.reset();
+        parent_id = next;
+    }
+}
+
+int64_t MediaStorePrivate::getChangeSequence() const {
+    Statement query(*statements, "SELECT seq FROM sqlite_sequence WHERE name = 'media_changes'");
+    return query.step() ? query.getInt64(0) : 0;
+}
+
+void MediaStorePrivate::checkChangesSince(int64_t sequence) const {
+    const int64_t latest = getChangeSequence();
+    Statement oldest(*statements, "SELECT coalesce(min(seq), ?) FROM media_changes");
+    oldest.bind(1, latest + 1);
+    oldest.step();
+    // Changes after sequence must not have been trimmed, and a
+    // sequence from before the database was recreated may be ahead
+    // of the journal.
+    if (sequence < oldest.getInt64(0) - 1 || sequence > latest) {
+        throw runtime_error("Changes since " + to_string(sequence) + " are not available");
     }
-    if (escaped.empty() || escaped[escaped.size() - 1] != '/') {
-        escaped += '/';
+}
+
+std::vector<MediaChange> MediaStorePrivate::getChangesSince(int64_t sequence) const {
+    checkChangesSince(sequence);
+    Statement query(*statements, R"(
+SELECT seq, change, filename, type
+  FROM media_changes
+  WHERE seq > ?
+  ORDER BY seq
+)");
+    query.bind(1, sequence);
+    vector<MediaChange> changes;
+    while (query.step()) {
+        changes.emplace_back(query.getInt64(0), (ChangeKind)query.getInt(1),
+                             query.getText(2), (MediaType)query.getInt(3));
     }
-    escaped += '%';
+    return changes;
+}
 
-    Statement query(db, "DELETE FROM media WHERE filename LIKE ? ESCAPE '!'");
-    query.bind(1, escaped);
-    query.step();
+std::vector<MediaType> MediaStorePrivate::getChangedTypesSince(int64_t sequence) const {
+    checkChangesSince(sequence);
+    Statement query(*statements, "SELECT DISTINCT type FROM media_changes WHERE seq > ? ORDER BY type");
+    query.bind(1, sequence);
+    vector<MediaType> types;
+    while (query.step()) {
+        types.push_back((MediaType)query.getInt(0));
+    }
+    return types;
+}
+
+void MediaStorePrivate::trimChanges(size_t max_changes, int max_age) {
+    Statement by_size(*statements, R"(
+DELETE FROM media_changes
+  WHERE seq <= (SELECT seq FROM media_changes ORDER BY seq DESC LIMIT 1 OFFSET ?)
+)");
+    by_size.bind(1, (int64_t)max_changes);
+    by_size.step();
+    by_size.finalize();
+
+    Statement by_age(*statements, "DELETE FROM media_changes WHERE time < strftime('%s', 'now') - ?");
+    by_age.bind(1, max_age);
+    by_age.step();
+}
+
+// The tables whose statistics the query planner uses.
+static const char *const analyzed_tables[] = {
+    "media", "media_attic", "directories", "broken_files", "media_changes",
+    "album_summary", "artist_summary", "album_artist_summary", "genre_summary",
+    "media_type_summary",
+};
+
+// Database files made before incremental vacuum was enabled, which
+// can only be changed by rewriting the whole file.  That is done
+// once, when the schema is upgraded, rather than by maintenance.
+void MediaStorePrivate::enableIncrementalVacuum() {
+    Statement mode(*statements, "PRAGMA auto_vacuum");
+    mode.step();
+    const bool incremental = mode.getInt(0) == 2;
+    mode.finalize();
+    if (!incremental) {
+        execute_sql(db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;");
+    }
+}
+
+// Do one step of the current maintenance task, each bounded in the
+// number of pages it touches.  Returns false once the last task is
+// done, having started over.
+bool MediaStorePrivate::maintain() {
+    enum { MergeIndex, Analyze, Vacuum, Optimize };
+    switch (maintenance_task) {
+    case MergeIndex: {
+        // A negative merge works towards a single segment, as
+        // 'optimize' would, but a few hundred pages at a time.  It
+        // did nothing if it changed fewer than two rows.
+        const int before = sqlite3_total_changes(db);
+        execute_sql(db, "INSERT INTO media_fts(media_fts, rank) VALUES ('merge', -500)");
+        if (sqlite3_total_changes(db) - before < 2) {
+            maintenance_task++;
+        }
+        return true;
+    }
+    case Analyze:
+        if (maintenance_step == 0) {
+            // Sample rather than read every row of large tables.
+            execute_sql(db, "PRAGMA analysis_limit = 1000");
+        }
+        execute_sql(db, string("ANALYZE ") + analyzed_tables[maintenance_step]);
+        if (++maintenance_step == sizeof(analyzed_tables) / sizeof(analyzed_tables[0])) {
+            maintenance_step = 0;
+            maintenance_task++;
+        }
+        return true;
+    case Vacuum: {
+        Statement mode(*statements, "PRAGMA auto_vacuum");
+        mode.step();
+        const bool incremental = mode.getInt(0) == 2;
+        mode.finalize();
+        if (!incremental) {
+            // Left to enableIncrementalVacuum().
+            maintenance_task++;
+            return true;
+        }
+        execute_sql(db, "PRAGMA incremental_vacuum(256)");
+        if (getDatabaseStats().freelist_pages == 0) {
+            maintenance_task++;
+        }
+        return true;
+    }
+    default:
+        execute_sql(db, "PRAGMA optimize");
+        maintenance_task = 0;
+        maintenance_step = 0;
+        return false;
+    }
+}
+
+DatabaseStats MediaStorePrivate::getDatabaseStats() const {
+    DatabaseStats stats;
+    Statement page_count(*statements, "PRAGMA page_count");
+    page_count.step();
+    Statement page_size(*statements, "PRAGMA page_size");
+    page_size.step();
+    stats.size = page_count.getInt64(0) * page_size.getInt64(0);
+    Statement freelist(*statements, "PRAGMA freelist_count");
+    freelist.step();
+    stats.freelist_pages = freelist.getInt64(0);
+    // Every segment has at least one entry in the index of its
+    // leaf pages.
+    Statement segments(*statements, "SELECT count(DISTINCT segid) FROM media_fts_idx");
+    segments.step();
+    stats.fts_segments = segments.getInt64(0);
+    return stats;
 }
 
 void MediaStorePrivate::begin() {
-    Statement query(db, "BEGIN TRANSACTION");
+    Statement query(*statements, "BEGIN TRANSACTION");
     query.step();
 }
 
 void MediaStorePrivate::commit() {
-    Statement query(db, "COMMIT TRANSACTION");
+    Statement query(*statements, "COMMIT TRANSACTION");
     query.step();
 }
 
 void MediaStorePrivate::rollback() {
-    Statement query(db, "ROLLBACK TRANSACTION");
+    last_directory.clear();
+    Statement query(*statements, "ROLLBACK TRANSACTION");
+    query.step();
+}
+
+void MediaStorePrivate::savepoint(const char *name) const {
+    Statement query(*statements, string("SAVEPOINT ") + name);
+    query.step();
+}
+
+void MediaStorePrivate::release(const char *name) const {
+    Statement query(*statements, string("RELEASE ") + name);
     query.step();
 }
 
+void MediaStorePrivate::rollback_to(const char *name) const {
+    last_directory.clear();
+    try {
+        Statement query(*statements, string("ROLLBACK TO ") + name);
+        query.step();
+        release(name);
+    } catch (const std::exception &e) {
+        fprintf(stderr, "Error rolling back to savepoint %s: %s\n", name, e.what());
+    }
+}
+
 void MediaStore::insert(const MediaFile &m) const {
     std::lock_guard<std::mutex> lock(p->dbMutex);
     p->insert(m);
@@ -1007,6 +3192,16 @@ void MediaStore::remove(const std::string &fname) const {
     p->remove(fname);
 }
 
+void MediaStore::insertBatch(const std::vector<MediaFile> &files) const {
+    std::lock_guard<std::mutex> lock(p->dbMutex);
+    p->insertBatch(files);
+}
+
+void MediaStore::removeBatch(const std::vector<std::string> &filenames) const {
+    std::lock_guard<std::mutex> lock(p->dbMutex);
+    p->removeBatch(filenames);
+}
+
 void MediaStore::insert_broken_file(const std::string &fname, const std::string &etag) const {
     std::lock_guard<std::mutex> lock(p->dbMutex);
     p->insert_broken_file(fname, etag);
@@ -1018,78 +3213,355 @@ void MediaStore::remove_broken_file(const std::string &fname) const {
 }
 
 bool MediaStore::is_broken_file(const std::string &fname, const std::string &etag) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->is_broken_file(fname, etag);
+    auto reader = p->acquireReader();
+    return reader->is_broken_file(fname, etag);
+}
+
+void MediaStore::beginExtraction(const std::string &fname, const std::string &etag) const {
+    if (!p->extracting) {
+        throw runtime_error("Extraction can only be recorded in a read-write store");
+    }
+    if (!p->extracting->begin(fname, etag)) {
+        insert_broken_file(fname, etag);
+    }
+}
+
+void MediaStore::endExtraction(const std::string &fname) const {
+    if (p->extracting) {
+        p->extracting->end(fname);
+    }
+}
+
+KnownFiles getKnownFiles(const MediaStore &store, const std::string &directory) {
+    auto reader = store.p->acquireReader();
+    return reader->getKnownFiles(directory);
+}
+
+// Read a result with one of the store's connections, or reuse it
+// from the cache if nothing has changed since it was last read.
+template <typename T>
+static T cached(MediaStorePrivate *p, const ResultCacheKey &key,
+                const function<T(MediaStorePrivate&)> &read) {
+    auto reader = p->acquireReader();
+    if (p->access_type != MS_READ_ONLY || p->cache.capacity() == 0) {
+        return read(*reader);
+    }
+    const DataVersion version = reader->dataVersion();
+    if (auto result = p->cache.get(key, version)) {
+        return *static_pointer_cast<const T>(result);
+    }
+    auto result = make_shared<const T>(read(*reader));
+    p->cache.put(key, version, result);
+    return *result;
 }
 
 MediaFile MediaStore::lookup(const std::string &filename) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->lookup(filename);
+    auto reader = p->acquireReader();
+    return reader->lookup(filename);
+}
+
+std::vector<MediaFile> MediaStore::lookupMany(const std::vector<std::string> &filenames) const {
+    auto reader = p->acquireReader();
+    return reader->lookupMany(filenames);
 }
 
 std::vector<MediaFile> MediaStore::query(const std::string &q, MediaType type, const Filter &filter) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->query(q, type, filter);
+    return cached<vector<MediaFile>>(
+        p, {CachedMethod::Query, q, type, filter}, [&](MediaStorePrivate &reader) {
+            vector<MediaFile> result;
+            reader.query(q, type, filter, [&](Statement &row) {
+                    result.push_back(make_media(row));
+                    return true;
+                });
+            return result;
+        });
+}
+
+std::vector<MediaFile> MediaStore::listMedia(MediaType type, const Filter &filter) const {
+    return cached<vector<MediaFile>>(
+        p, {CachedMethod::ListMedia, "", type, filter}, [&](MediaStorePrivate &reader) {
+            vector<MediaFile> result;
+            reader.listMedia(type, filter, [&](Statement &row) {
+                    result.push_back(make_media(row));
+                    return true;
+                });
+            return result;
+        });
+}
+
+int64_t MediaStore::count(MediaType type, const Filter &filter) const {
+    return cached<int64_t>(
+        p, {CachedMethod::Count, "", type, filter}, [&](MediaStorePrivate &reader) {
+            return reader.count(type, filter);
+        });
+}
+
+Aggregate MediaStore::aggregate(const Filter &filter) const {
+    return cached<Aggregate>(
+        p, {CachedMethod::Aggregate, "", AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            return reader.aggregate(filter);
+        });
+}
+
+std::vector<Facet> MediaStore::facets(FacetField field, const Filter &filter) const {
+    // The field stands in for the query string in the cache key.
+    return cached<vector<Facet>>(
+        p, {CachedMethod::Facets, std::to_string(static_cast<int>(field)), AllMedia, filter},
+        [&](MediaStorePrivate &reader) {
+            return reader.facets(field, filter);
+        });
+}
+
+static void check_coordinates(double latitude, double longitude) {
+    if (!(latitude >= -90 && latitude <= 90 && longitude >= -180 && longitude <= 180)) {
+        throw invalid_argument("Coordinates out of range");
+    }
+}
+
+std::vector<MediaFile> MediaStore::queryBoundingBox(double min_latitude, double min_longitude,
+                                                    double max_latitude, double max_longitude,
+                                                    MediaType type, const Filter &filter) const {
+    check_coordinates(min_latitude, min_longitude);
+    check_coordinates(max_latitude, max_longitude);
+    if (min_latitude > max_latitude) {
+        throw invalid_argument("Bounding box has min_latitude above max_latitude");
+    }
+    auto reader = p->acquireReader();
+    vector<MediaFile> result;
+    reader->queryBoundingBox({min_latitude, min_longitude, max_latitude, max_longitude},
+                             type, filter, [&](Statement &row) {
+            result.push_back(make_media(row));
+            return true;
+        });
+    return result;
+}
+
+std::vector<MediaFile> MediaStore::queryNearest(double latitude, double longitude, MediaType type, const Filter &filter) const {
+    check_coordinates(latitude, longitude);
+    auto reader = p->acquireReader();
+    return reader->queryNearest(latitude, longitude, type, filter);
+}
+
+std::vector<TimelineEntry> MediaStore::timeline(MediaType type, TimelineInterval interval, const Filter &filter) const {
+    auto reader = p->acquireReader();
+    return reader->timeline(type, interval, filter);
 }
 
 std::vector<Album> MediaStore::queryAlbums(const std::string &core_term, const Filter &filter) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->queryAlbums(core_term, filter);
+    return cached<vector<Album>>(
+        p, {CachedMethod::QueryAlbums, core_term, AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            return reader.queryAlbums(core_term, filter);
+        });
 }
 
 std::vector<string> MediaStore::queryArtists(const std::string &q, const Filter &filter) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->queryArtists(q, filter);
+    return cached<vector<string>>(
+        p, {CachedMethod::QueryArtists, q, AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            return reader.queryArtists(q, filter);
+        });
 }
 
 std::vector<MediaFile> MediaStore::getAlbumSongs(const Album& album) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->getAlbumSongs(album);
+    auto reader = p->acquireReader();
+    return reader->getAlbumSongs(album);
 }
 
 std::string MediaStore::getETag(const std::string &filename) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->getETag(filename);
+    auto reader = p->acquireReader();
+    return reader->getETag(filename);
 }
 
 std::vector<MediaFile> MediaStore::listSongs(const Filter &filter) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->listSongs(filter);
+    return cached<vector<MediaFile>>(
+        p, {CachedMethod::ListSongs, "", AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            vector<MediaFile> result;
+            reader.listSongs(filter, [&](Statement &row) {
+                    result.push_back(make_media(row));
+                    return true;
+                });
+            return result;
+        });
 }
 
 std::vector<Album> MediaStore::listAlbums(const Filter &filter) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->listAlbums(filter);
+    return cached<vector<Album>>(
+        p, {CachedMethod::ListAlbums, "", AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            return reader.listAlbums(filter);
+        });
 }
 
 std::vector<std::string> MediaStore::listArtists(const Filter &filter) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->listArtists(filter);
+    return cached<vector<string>>(
+        p, {CachedMethod::ListArtists, "", AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            return reader.listArtists(filter);
+        });
 }
 
 std::vector<std::string> MediaStore::listAlbumArtists(const Filter &filter) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->listAlbumArtists(filter);
+    return cached<vector<string>>(
+        p, {CachedMethod::ListAlbumArtists, "", AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            return reader.listAlbumArtists(filter);
+        });
 }
 
 std::vector<std::string> MediaStore::listGenres(const Filter &filter) const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->listGenres(filter);
+    return cached<vector<string>>(
+        p, {CachedMethod::ListGenres, "", AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            return reader.listGenres(filter);
+        });
 }
 
 bool MediaStore::hasMedia(MediaType type) const {
+    return cached<bool>(
+        p, {CachedMethod::HasMedia, "", type, Filter()}, [&](MediaStorePrivate &reader) {
+            return reader.hasMedia(type);
+        });
+}
+
+Folder MediaStore::listFolder(const std::string &path, const Filter &filter) const {
+    return cached<Folder>(
+        p, {CachedMethod::ListFolder, path, AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            return reader.listFolder(path, filter);
+        });
+}
+
+MediaFileBatch MediaStore::queryBatch(const std::string &q, MediaType type, const Filter &filter) const {
+    return cached<MediaFileBatch>(
+        p, {CachedMethod::QueryBatch, q, type, filter}, [&](MediaStorePrivate &reader) {
+            MediaFileBatch result;
+            reader.query(q, type, filter, [&](Statement &row) {
+                    append_media(result, row);
+                    return true;
+                });
+            return result;
+        });
+}
+
+MediaFileBatch MediaStore::listSongsBatch(const Filter &filter) const {
+    return cached<MediaFileBatch>(
+        p, {CachedMethod::ListSongsBatch, "", AllMedia, filter}, [&](MediaStorePrivate &reader) {
+            MediaFileBatch result;
+            reader.listSongs(filter, [&](Statement &row) {
+                    append_media(result, row);
+                    return true;
+                });
+            return result;
+        });
+}
+
+MediaFileBatch MediaStore::listMediaBatch(MediaType type, const Filter &filter) const {
+    return cached<MediaFileBatch>(
+        p, {CachedMethod::ListMediaBatch, "", type, filter}, [&](MediaStorePrivate &reader) {
+            MediaFileBatch result;
+            reader.listMedia(type, filter, [&](Statement &row) {
+                    append_media(result, row);
+                    return true;
+                });
+            return result;
+        });
+}
+
+void MediaStore::forEachMedia(const std::string &q, MediaType type, const Filter &filter,
+                              const std::function<bool(const MediaFile&)> &callback) const {
+    auto reader = p->acquireReader();
+    reader->query(q, type, filter, [&](Statement &row) {
+            return callback(make_media(row));
+        });
+}
+
+void MediaStore::forEachSong(const Filter &filter,
+                             const std::function<bool(const MediaFile&)> &callback) const {
+    auto reader = p->acquireReader();
+    reader->listSongs(filter, [&](Statement &row) {
+            return callback(make_media(row));
+        });
+}
+
+int64_t MediaStore::getChangeSequence() const {
+    auto reader = p->acquireReader();
+    return reader->getChangeSequence();
+}
+
+std::vector<MediaType> MediaStore::getChangedTypesSince(int64_t sequence) const {
+    auto reader = p->acquireReader();
+    return reader->getChangedTypesSince(sequence);
+}
+
+std::vector<MediaChange> MediaStore::getChangesSince(int64_t sequence) const {
+    auto reader = p->acquireReader();
+    return reader->getChangesSince(sequence);
+}
+
+void MediaStore::trimChanges(size_t max_changes, int max_age) {
     std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->hasMedia(type);
+    p->trimChanges(max_changes, max_age);
+}
+
+void MediaStore::setCacheSize(size_t entries) {
+    p->cache.setCapacity(entries);
+}
+
+uint64_t MediaStore::getCacheHits() const {
+    return p->cache.hits();
+}
+
+uint64_t MediaStore::getCacheMisses() const {
+    return p->cache.misses();
 }
 
 size_t MediaStore::size() const {
-    std::lock_guard<std::mutex> lock(p->dbMutex);
-    return p->size();
+    auto reader = p->acquireReader();
+    return reader->size();
 }
 
 void MediaStore::pruneDeleted() {
+    pruneDeleted(vector<string>());
+}
+
+void MediaStore::pruneDeleted(const std::vector<std::string> &skip_directories) {
+    vector<string> filenames;
+    {
+        std::lock_guard<std::mutex> lock(p->dbMutex);
+        filenames = p->listFilenames();
+    }
+    for (const auto &directory : skip_directories) {
+        const string prefix = normalize_directory(directory) + "/";
+        filenames.erase(std::remove_if(filenames.begin(), filenames.end(),
+                                       [&prefix](const string &filename) {
+                                           return filename.compare(0, prefix.size(), prefix) == 0;
+                                       }),
+                        filenames.end());
+    }
+    // Checking the file system is slow, so do it without holding
+    // the lock.  The checks are mostly waiting on I/O, so use at
+    // least a few threads even on a single core.
+    PrunePlan plan = plan_prune(filenames, std::max(4u, std::thread::hardware_concurrency()));
+    std::lock_guard<std::mutex> lock(p->dbMutex);
+    p->prune(plan);
+}
+
+bool MediaStore::runMaintenance(int budget_ms) {
+    if (p->access_type != MS_READ_WRITE) {
+        throw runtime_error("Maintenance needs a read-write store");
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget_ms);
+    std::lock_guard<std::mutex> lock(p->dbMutex);
+    while (p->maintain()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+    }
+    return true;
+}
+
+DatabaseStats MediaStore::getDatabaseStats() const {
+    auto reader = p->acquireReader();
+    return reader->getDatabaseStats();
+}
+
+void MediaStore::publishSnapshot() {
     std::lock_guard<std::mutex> lock(p->dbMutex);
-    p->pruneDeleted();
+    p->publishSnapshot();
 }
 
 void MediaStore::archiveItems(const std::string &prefix) {
@@ -1145,4 +3617,15 @@ void MediaStoreTransaction::commit() {
     p->begin();
 }
 
+void MediaStoreTransaction::commitAndPublish() {
+    std::lock_guard<std::mutex> lock(p->dbMutex);
+    p->commit();
+    try {
+        p->publishSnapshot();
+    } catch (const std::exception &e) {
+        fprintf(stderr, "MediaStoreTransaction: could not publish snapshot: %s\n", e.what());
+    }
+    p->begin();
+}
+
 }
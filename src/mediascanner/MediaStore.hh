@@ -21,6 +21,7 @@
 #define MEDIASTORE_HH_
 
 #include "MediaStoreBase.hh"
+#include<cstdint>
 #include<vector>
 #include<string>
 
@@ -31,12 +32,21 @@ enum OpenType {
     MS_READ_WRITE
 };
 
+// The state of the database file, as reported after maintenance.
+struct DatabaseStats {
+    int64_t size = 0;             // In bytes
+    int64_t freelist_pages = 0;   // Unused pages inside the file
+    int64_t fts_segments = 0;     // Segments in the search index
+};
+
 struct MediaStorePrivate;
+class KnownFiles;
 class MediaStoreTransaction;
 
 class MediaStore final : public virtual MediaStoreBase {
 private:
     MediaStorePrivate *p;
+    friend KnownFiles getKnownFiles(const MediaStore &store, const std::string &directory);
 
 public:
     MediaStore(OpenType access, const std::string &retireprefix="");
@@ -47,12 +57,22 @@ public:
 
     void insert(const MediaFile &m) const;
     void remove(const std::string &fname) const;
+    // Insert or remove many files at once, using a single prepared
+    // statement within one transaction.
+    void insertBatch(const std::vector<MediaFile> &files) const;
+    void removeBatch(const std::vector<std::string> &filenames) const;
 
     // Maintain a list of files known to crash GStreamer
     // metadata scanner.
     void insert_broken_file(const std::string &fname, const std::string &etag) const;
     void remove_broken_file(const std::string &fname) const;
     bool is_broken_file(const std::string &fname, const std::string &etag) const;
+    // Bracket the extraction of a file's metadata.  If the process
+    // dies in between, the next read-write store opened on the
+    // database adds the file to the broken files.  Unlike
+    // insert_broken_file(), this does not write to the database.
+    void beginExtraction(const std::string &fname, const std::string &etag) const;
+    void endExtraction(const std::string &fname) const;
     virtual MediaFile lookup(const std::string &filename) const override;
     virtual std::vector<MediaFile> query(const std::string &q, MediaType type, const Filter &filter) const override;
     virtual std::vector<Album> queryAlbums(const std::string &core_term, const Filter &filter) const override;
@@ -65,9 +85,66 @@ public:
     virtual std::vector<std::string>listAlbumArtists(const Filter &filter) const override;
     virtual std::vector<std::string>listGenres(const Filter &filter) const override;
     virtual bool hasMedia(MediaType type) const override;
+    virtual Folder listFolder(const std::string &path, const Filter &filter) const override;
+    virtual MediaFileBatch queryBatch(const std::string &q, MediaType type, const Filter &filter) const override;
+    virtual MediaFileBatch listSongsBatch(const Filter &filter) const override;
+    virtual std::vector<MediaFile> listMedia(MediaType type, const Filter &filter) const override;
+    virtual MediaFileBatch listMediaBatch(MediaType type, const Filter &filter) const override;
+    virtual int64_t count(MediaType type, const Filter &filter) const override;
+    virtual Aggregate aggregate(const Filter &filter) const override;
+    virtual std::vector<Facet> facets(FacetField field, const Filter &filter) const override;
+    virtual std::vector<MediaFile> lookupMany(const std::vector<std::string> &filenames) const override;
+    virtual void forEachMedia(const std::string &q, MediaType type, const Filter &filter,
+                              const std::function<bool(const MediaFile&)> &callback) const override;
+    virtual void forEachSong(const Filter &filter,
+                             const std::function<bool(const MediaFile&)> &callback) const override;
+    virtual int64_t getChangeSequence() const override;
+    virtual std::vector<MediaChange> getChangesSince(int64_t sequence) const override;
+    // The types of the media changed after a sequence number, without
+    // reading the changes themselves.  Throws as getChangesSince().
+    std::vector<MediaType> getChangedTypesSince(int64_t sequence) const;
+    virtual std::vector<MediaFile> queryBoundingBox(double min_latitude, double min_longitude,
+                                                    double max_latitude, double max_longitude,
+                                                    MediaType type, const Filter &filter) const override;
+    virtual std::vector<MediaFile> queryNearest(double latitude, double longitude,
+                                                MediaType type, const Filter &filter) const override;
+    virtual std::vector<TimelineEntry> timeline(MediaType type, TimelineInterval interval,
+                                                const Filter &filter) const override;
+    // Drop journal entries beyond the newest max_changes, or more
+    // than max_age seconds old.
+    void trimChanges(size_t max_changes, int max_age);
+
+    // Keep the results of up to entries recent queries, and answer
+    // repeated queries from them until the database changes.  Only
+    // read only stores cache; the default size of 0 turns it off.
+    void setCacheSize(size_t entries);
+    uint64_t getCacheHits() const;
+    uint64_t getCacheMisses() const;
+
+    // Do database maintenance for about budget_ms milliseconds, in
+    // steps small enough not to hold up other work: merging the
+    // search index's segments, refreshing the query planner's
+    // statistics and returning free pages to the file system.  Free
+    // pages are only returned from database files made with
+    // incremental vacuum, which older files are converted to when
+    // their schema is upgraded.  Returns true once every task is
+    // done, after which the next call starts over.
+    bool runMaintenance(int budget_ms);
+    DatabaseStats getDatabaseStats() const;
 
     size_t size() const;
+    // Copy the committed state of a read-write store to the snapshot
+    // file opened by read-only stores.  Does nothing if there were no
+    // changes since the last snapshot, or inside a transaction.  This
+    // copies the whole database, so it is up to the caller to choose
+    // when.
+    void publishSnapshot();
+    // Remove the media whose files are gone from disk or in scan
+    // blocked directories.  The second form leaves alone the files
+    // below the given directories, for when the caller walks those
+    // itself.
     void pruneDeleted();
+    void pruneDeleted(const std::vector<std::string> &skip_directories);
     void archiveItems(const std::string &prefix);
     void restoreItems(const std::string &prefix);
     void removeSubtree(const std::string &directory);
@@ -86,6 +163,10 @@ public:
     MediaStoreTransaction& operator=(MediaStoreTransaction &&other);
 
     void commit();
+    // Commit and publish a snapshot of the store before starting the
+    // next transaction, which publishSnapshot() cannot do while one
+    // is open.
+    void commitAndPublish();
 private:
     MediaStoreTransaction(MediaStorePrivate *p);
 
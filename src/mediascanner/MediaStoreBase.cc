@@ -18,6 +18,13 @@
  */
 
 #include "MediaStoreBase.hh"
+#include "Filter.hh"
+#include "Folder.hh"
+#include "MediaChange.hh"
+#include "MediaFile.hh"
+#include "MediaFileBatch.hh"
+
+#include <stdexcept>
 
 namespace mediascanner {
 
@@ -27,4 +34,93 @@ MediaStoreBase::MediaStoreBase() {
 MediaStoreBase::~MediaStoreBase() {
 }
 
+MediaFileBatch MediaStoreBase::queryBatch(const std::string &q, MediaType type, const Filter &filter) const {
+    return MediaFileBatch(query(q, type, filter));
+}
+
+MediaFileBatch MediaStoreBase::listSongsBatch(const Filter &filter) const {
+    return MediaFileBatch(listSongs(filter));
+}
+
+Folder MediaStoreBase::listFolder(const std::string &, const Filter &) const {
+    throw std::runtime_error("Folders not supported");
+}
+
+int64_t MediaStoreBase::getChangeSequence() const {
+    throw std::runtime_error("Change journal not supported");
+}
+
+std::vector<MediaChange> MediaStoreBase::getChangesSince(int64_t) const {
+    throw std::runtime_error("Change journal not supported");
+}
+
+std::vector<MediaFile> MediaStoreBase::queryBoundingBox(double, double, double, double,
+                                                        MediaType, const Filter &) const {
+    throw std::runtime_error("Location queries not supported");
+}
+
+std::vector<MediaFile> MediaStoreBase::queryNearest(double, double, MediaType, const Filter &) const {
+    throw std::runtime_error("Location queries not supported");
+}
+
+std::vector<TimelineEntry> MediaStoreBase::timeline(MediaType, TimelineInterval, const Filter &) const {
+    throw std::runtime_error("Timeline not supported");
+}
+
+std::vector<MediaFile> MediaStoreBase::listMedia(MediaType type, const Filter &filter) const {
+    if (filter.getOrder() != MediaOrder::Default && filter.getOrder() != MediaOrder::Rank) {
+        return query("", type, filter);
+    }
+    Filter ordered(filter);
+    ordered.setOrder(MediaOrder::Title);
+    return query("", type, ordered);
+}
+
+MediaFileBatch MediaStoreBase::listMediaBatch(MediaType type, const Filter &filter) const {
+    return MediaFileBatch(listMedia(type, filter));
+}
+
+int64_t MediaStoreBase::count(MediaType, const Filter &) const {
+    throw std::runtime_error("Counting not supported");
+}
+
+Aggregate MediaStoreBase::aggregate(const Filter &) const {
+    throw std::runtime_error("Counting not supported");
+}
+
+std::vector<Facet> MediaStoreBase::facets(FacetField, const Filter &) const {
+    throw std::runtime_error("Facets not supported");
+}
+
+std::vector<MediaFile> MediaStoreBase::lookupMany(const std::vector<std::string> &filenames) const {
+    std::vector<MediaFile> result;
+    result.reserve(filenames.size());
+    for (const auto &filename : filenames) {
+        try {
+            result.push_back(lookup(filename));
+        } catch (const std::exception &) {
+            result.emplace_back();
+        }
+    }
+    return result;
+}
+
+void MediaStoreBase::forEachMedia(const std::string &q, MediaType type, const Filter &filter,
+                                  const std::function<bool(const MediaFile&)> &callback) const {
+    for (const auto &media : query(q, type, filter)) {
+        if (!callback(media)) {
+            break;
+        }
+    }
+}
+
+void MediaStoreBase::forEachSong(const Filter &filter,
+                                 const std::function<bool(const MediaFile&)> &callback) const {
+    for (const auto &media : listSongs(filter)) {
+        if (!callback(media)) {
+            break;
+        }
+    }
+}
+
 }
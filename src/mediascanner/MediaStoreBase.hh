@@ -21,6 +21,8 @@
 #define MEDIASTOREBASE_HH_
 
 #include"scannercore.hh"
+#include<cstdint>
+#include<functional>
 #include<vector>
 #include<string>
 
@@ -29,6 +31,69 @@ namespace mediascanner {
 class MediaFile;
 class Album;
 class Filter;
+class Folder;
+class MediaFileBatch;
+class MediaChange;
+
+// The number of media dated within one bucket of a timeline, which
+// begins at start seconds since the epoch.
+struct TimelineEntry {
+    TimelineEntry() = default;
+    TimelineEntry(int64_t start, int count) : start(start), count(count) {}
+
+    int64_t start = 0;
+    int count = 0;
+
+    bool operator==(const TimelineEntry &other) const {
+        return start == other.start && count == other.count;
+    }
+    bool operator!=(const TimelineEntry &other) const {
+        return !(*this == other);
+    }
+};
+
+// Totals over the songs matching a filter: how many there are, their
+// total duration in seconds, and how many albums and artists they are
+// from.
+struct Aggregate {
+    Aggregate() = default;
+    Aggregate(int64_t count, int64_t duration, int64_t albums, int64_t artists)
+        : count(count), duration(duration), albums(albums), artists(artists) {}
+
+    int64_t count = 0;
+    int64_t duration = 0;
+    int64_t albums = 0;
+    int64_t artists = 0;
+
+    bool operator==(const Aggregate &other) const {
+        return count == other.count && duration == other.duration &&
+            albums == other.albums && artists == other.artists;
+    }
+    bool operator!=(const Aggregate &other) const {
+        return !(*this == other);
+    }
+};
+
+// The songs sharing one value of a facet: how many there are, how
+// many albums they are from and their total duration in seconds.
+struct Facet {
+    Facet() = default;
+    Facet(const std::string &value, int64_t track_count, int64_t album_count, int64_t duration)
+        : value(value), track_count(track_count), album_count(album_count), duration(duration) {}
+
+    std::string value;
+    int64_t track_count = 0;
+    int64_t album_count = 0;
+    int64_t duration = 0;
+
+    bool operator==(const Facet &other) const {
+        return value == other.value && track_count == other.track_count &&
+            album_count == other.album_count && duration == other.duration;
+    }
+    bool operator!=(const Facet &other) const {
+        return !(*this == other);
+    }
+};
 
 class MediaStoreBase {
 public:
@@ -50,6 +115,72 @@ public:
     virtual std::vector<std::string>listAlbumArtists(const Filter &filter) const = 0;
     virtual std::vector<std::string>listGenres(const Filter &filter) const = 0;
     virtual bool hasMedia(MediaType type) const = 0;
+    // The media directly in a directory and its subdirectories that
+    // hold media.  The default implementation throws.
+    virtual Folder listFolder(const std::string &path, const Filter &filter) const;
+    // The same results as query() and listSongs(), stored by column.
+    // The default implementations convert the MediaFile results.
+    virtual MediaFileBatch queryBatch(const std::string &q, MediaType type, const Filter &filter) const;
+    virtual MediaFileBatch listSongsBatch(const Filter &filter) const;
+    // Call callback on each result of query() or listSongs() in turn,
+    // stopping early if it returns false.  MediaStore reads the rows
+    // from the database as the callback asks for them rather than
+    // building the whole list first; the default implementations do
+    // build the list.  The callback runs while MediaStore holds a
+    // database connection, so it must not call back into the store.
+    virtual void forEachMedia(const std::string &q, MediaType type, const Filter &filter,
+                              const std::function<bool(const MediaFile&)> &callback) const;
+    virtual void forEachSong(const Filter &filter,
+                             const std::function<bool(const MediaFile&)> &callback) const;
+    // The sequence number of the latest change, and the changes made
+    // after a given sequence number, oldest first.  getChangesSince()
+    // throws if the journal no longer goes back that far, in which
+    // case the caller should reload everything.  Changes are to file
+    // names: replacing a file's data is an Update change, even
+    // though the store gives it a new row.  The default
+    // implementations throw.
+    virtual int64_t getChangeSequence() const;
+    virtual std::vector<MediaChange> getChangesSince(int64_t sequence) const;
+    // Media whose location is inside a box, in degrees.  The box
+    // crosses the 180th meridian if min_longitude is greater than
+    // max_longitude.  A type of AllMedia matches media of any type.
+    // Uses the filter's order, cursor, offset and limit.
+    virtual std::vector<MediaFile> queryBoundingBox(double min_latitude, double min_longitude,
+                                                    double max_latitude, double max_longitude,
+                                                    MediaType type, const Filter &filter) const;
+    // Media with a location, nearest to a point first.  Uses the
+    // filter's offset and limit.  The default implementations throw.
+    virtual std::vector<MediaFile> queryNearest(double latitude, double longitude,
+                                                MediaType type, const Filter &filter) const;
+    // How many media of a type were dated in each day, month or year,
+    // oldest first, leaving out those with none.  Buckets are in UTC.
+    // Uses the filter's date and modification time ranges.  The
+    // default implementation throws.
+    virtual std::vector<TimelineEntry> timeline(MediaType type, TimelineInterval interval,
+                                                const Filter &filter) const;
+    // Every media of a type in the filter's order, title if it has
+    // none, resuming from its cursor.  MediaStore reads them in index
+    // order rather than sorting.  The default implementations call
+    // query() with no search term.
+    virtual std::vector<MediaFile> listMedia(MediaType type, const Filter &filter) const;
+    virtual MediaFileBatch listMediaBatch(MediaType type, const Filter &filter) const;
+    // How many media of a type listSongs() or listMedia() would
+    // return with no limit, and the totals over the songs listSongs()
+    // would return, without reading the rows.  The default
+    // implementations throw.
+    virtual int64_t count(MediaType type, const Filter &filter) const;
+    virtual Aggregate aggregate(const Filter &filter) const;
+    // Each value of a field among the songs listSongs() would return,
+    // in order, with the songs' totals.  Years are those of the
+    // songs' dates in UTC, leaving out songs without one.  Uses the
+    // filter's cursor, offset and limit over the values.  The default
+    // implementation throws.
+    virtual std::vector<Facet> facets(FacetField field, const Filter &filter) const;
+    // lookup() for each of a list of files, in the same order.  Files
+    // not in the store come back as a MediaFile with an empty file
+    // name rather than failing the whole call.  The default
+    // implementation calls lookup() for each file.
+    virtual std::vector<MediaFile> lookupMany(const std::vector<std::string> &filenames) const;
 };
 
 }
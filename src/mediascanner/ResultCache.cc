@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "internal/ResultCache.hh"
+
+#include <functional>
+
+using namespace std;
+
+namespace mediascanner {
+
+bool ResultCacheKey::operator==(const ResultCacheKey &other) const {
+    return method == other.method && type == other.type &&
+        q == other.q && filter == other.filter;
+}
+
+size_t ResultCacheKeyHash::operator()(const ResultCacheKey &key) const {
+    // Equal keys must hash the same, but the hash need not cover
+    // every field of the filter.
+    size_t h = hash<string>()(key.q);
+    h = h * 31 + static_cast<size_t>(key.method);
+    h = h * 31 + static_cast<size_t>(key.type);
+    h = h * 31 + static_cast<size_t>(key.filter.getOffset());
+    h = h * 31 + static_cast<size_t>(key.filter.getLimit());
+    if (key.filter.hasArtist()) {
+        h = h * 31 + hash<string>()(key.filter.getArtist());
+    }
+    if (key.filter.hasAlbum()) {
+        h = h * 31 + hash<string>()(key.filter.getAlbum());
+    }
+    if (key.filter.hasCursor()) {
+        h = h * 31 + hash<string>()(key.filter.getCursor());
+    }
+    if (key.filter.hasDateRange()) {
+        h = h * 31 + static_cast<size_t>(key.filter.getDateStart());
+        h = h * 31 + static_cast<size_t>(key.filter.getDateEnd());
+    }
+    return h;
+}
+
+SnapshotId::SnapshotId(const struct stat &st)
+    : dev(st.st_dev), ino(st.st_ino), size(st.st_size),
+      mtime_ns(st.st_mtim.tv_sec * INT64_C(1000000000) + st.st_mtim.tv_nsec),
+      ctime_ns(st.st_ctim.tv_sec * INT64_C(1000000000) + st.st_ctim.tv_nsec) {
+}
+
+bool SnapshotId::operator==(const SnapshotId &other) const {
+    return dev == other.dev && ino == other.ino && size == other.size &&
+        mtime_ns == other.mtime_ns && ctime_ns == other.ctime_ns;
+}
+
+bool SnapshotId::operator!=(const SnapshotId &other) const {
+    return !(*this == other);
+}
+
+bool DataVersion::operator==(const DataVersion &other) const {
+    return snapshot == other.snapshot &&
+        connection == other.connection && data_version == other.data_version;
+}
+
+bool DataVersion::operator!=(const DataVersion &other) const {
+    return !(*this == other);
+}
+
+void ResultCache::setCapacity(size_t capacity) {
+    lock_guard<std::mutex> lock(cacheMutex);
+    capacity_ = capacity;
+    while (entries.size() > capacity_) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+size_t ResultCache::capacity() const {
+    lock_guard<std::mutex> lock(cacheMutex);
+    return capacity_;
+}
+
+size_t ResultCache::size() const {
+    lock_guard<std::mutex> lock(cacheMutex);
+    return entries.size();
+}
+
+void ResultCache::setVersion(const DataVersion &version) {
+    if (version != this->version) {
+        entries.clear();
+        index.clear();
+        this->version = version;
+    }
+}
+
+shared_ptr<const void> ResultCache::get(const ResultCacheKey &key, const DataVersion &version) {
+    lock_guard<std::mutex> lock(cacheMutex);
+    if (capacity_ == 0) {
+        return nullptr;
+    }
+    setVersion(version);
+    auto it = index.find(key);
+    if (it == index.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+void ResultCache::put(const ResultCacheKey &key, const DataVersion &version,
+                      shared_ptr<const void> result) {
+    lock_guard<std::mutex> lock(cacheMutex);
+    if (capacity_ == 0) {
+        return;
+    }
+    // The result is stale if the data changed while it was read.
+    if (version != this->version) {
+        return;
+    }
+    auto it = index.find(key);
+    if (it != index.end()) {
+        // Another thread read the same result.
+        it->second->second = move(result);
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    entries.emplace_front(key, move(result));
+    index.emplace(key, entries.begin());
+    if (entries.size() > capacity_) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+uint64_t ResultCache::hits() const {
+    lock_guard<std::mutex> lock(cacheMutex);
+    return hits_;
+}
+
+uint64_t ResultCache::misses() const {
+    lock_guard<std::mutex> lock(cacheMutex);
+    return misses_;
+}
+
+}
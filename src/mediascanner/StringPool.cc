@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal/StringPool.hh"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+namespace mediascanner {
+
+struct InternedEntry {
+    const string value;
+    // Lookups take references with the pool's mutex held, and the
+    // last reference is only dropped with it held, so a lookup never
+    // finds an entry that is being freed.
+    atomic<long> refs {1};
+
+    explicit InternedEntry(const string &value) : value(value) {}
+};
+
+namespace {
+
+// Entries are keyed by a pointer to their own value, so a lookup
+// can use the caller's string without copying it.
+struct ValueHash {
+    size_t operator()(const string *s) const {
+        return hash<string>()(*s);
+    }
+};
+
+struct ValueEqual {
+    bool operator()(const string *a, const string *b) const {
+        return *a == *b;
+    }
+};
+
+struct StringPool {
+    mutex lock;
+    unordered_map<const string*, InternedEntry*, ValueHash, ValueEqual> entries;
+
+    // Never destroyed, so strings may outlive static destructors.
+    static StringPool &get() {
+        static StringPool *pool = new StringPool;
+        return *pool;
+    }
+
+    InternedEntry *acquire(const string &value) {
+        lock_guard<mutex> guard(lock);
+        auto it = entries.find(&value);
+        if (it != entries.end()) {
+            it->second->refs.fetch_add(1, memory_order_relaxed);
+            return it->second;
+        }
+        InternedEntry *entry = new InternedEntry(value);
+        entries.emplace(&entry->value, entry);
+        return entry;
+    }
+
+    void release_last(InternedEntry *entry) {
+        lock_guard<mutex> guard(lock);
+        if (entry->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+            entries.erase(&entry->value);
+            delete entry;
+        }
+    }
+};
+
+void acquire(InternedEntry *entry) {
+    if (entry) {
+        entry->refs.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void release(InternedEntry *entry) {
+    if (!entry) {
+        return;
+    }
+    // Drop any reference but the last without taking the lock.
+    long refs = entry->refs.load(memory_order_relaxed);
+    while (refs > 1) {
+        if (entry->refs.compare_exchange_weak(refs, refs - 1, memory_order_acq_rel)) {
+            return;
+        }
+    }
+    StringPool::get().release_last(entry);
+}
+
+}
+
+InternedString::InternedString(const string &value) {
+    if (!value.empty()) {
+        entry = StringPool::get().acquire(value);
+    }
+}
+
+InternedString::InternedString(const InternedString &other) noexcept
+    : entry(other.entry) {
+    acquire(entry);
+}
+
+InternedString::InternedString(InternedString &&other) noexcept
+    : entry(other.entry) {
+    other.entry = nullptr;
+}
+
+InternedString::~InternedString() {
+    release(entry);
+}
+
+InternedString &InternedString::operator=(const InternedString &other) noexcept {
+    acquire(other.entry);
+    release(entry);
+    entry = other.entry;
+    return *this;
+}
+
+InternedString &InternedString::operator=(InternedString &&other) noexcept {
+    if (this != &other) {
+        release(entry);
+        entry = other.entry;
+        other.entry = nullptr;
+    }
+    return *this;
+}
+
+const string &InternedString::str() const noexcept {
+    static const string empty_string;
+    return entry ? entry->value : empty_string;
+}
+
+size_t InternedString::pool_size() {
+    StringPool &pool = StringPool::get();
+    lock_guard<mutex> guard(pool.lock);
+    return pool.entries.size();
+}
+
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal/fts.hh"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "mozilla/fts3_tokenizer.h"
+#include "internal/sqliteutils.hh"
+
+extern "C" void sqlite3Fts3PorterTokenizerModule(
+    sqlite3_tokenizer_module const**ppModule);
+
+using namespace std;
+
+namespace mediascanner {
+
+namespace {
+
+// An instance of the FTS3 mozporter tokenizer.
+class PorterTokenizer final {
+public:
+    PorterTokenizer() {
+        sqlite3Fts3PorterTokenizerModule(&module);
+        if (module->xCreate(0, nullptr, &tokenizer) != SQLITE_OK) {
+            throw runtime_error("Could not create mozporter tokenizer");
+        }
+        tokenizer->pModule = module;
+    }
+    ~PorterTokenizer() {
+        module->xDestroy(tokenizer);
+    }
+    PorterTokenizer(const PorterTokenizer &other) = delete;
+    PorterTokenizer& operator=(const PorterTokenizer &other) = delete;
+
+    // Call emit with each token and its start and end offsets,
+    // stopping early if it returns anything but SQLITE_OK.
+    // SQLITE_DONE stops without an error.
+    int tokenize(const string &input,
+                 const function<int(const char *token, int length, int start, int end)> &emit) const {
+        sqlite3_tokenizer_cursor *cursor = nullptr;
+        int rc = module->xOpen(tokenizer, input.data(), input.size(), &cursor);
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
+        cursor->pTokenizer = tokenizer;
+        const char *token;
+        int length, start, end, position;
+        while ((rc = module->xNext(cursor, &token, &length, &start, &end, &position)) == SQLITE_OK) {
+            rc = emit(token, length, start, end);
+            if (rc != SQLITE_OK) {
+                break;
+            }
+        }
+        module->xClose(cursor);
+        return rc == SQLITE_DONE ? SQLITE_OK : rc;
+    }
+
+private:
+    const sqlite3_tokenizer_module *module = nullptr;
+    sqlite3_tokenizer *tokenizer = nullptr;
+};
+
+int fts5_create(void * /*user_data*/, const char ** /*args*/, int /*num_args*/, Fts5Tokenizer **out) {
+    try {
+        *out = reinterpret_cast<Fts5Tokenizer*>(new PorterTokenizer);
+    } catch (const std::exception &e) {
+        return SQLITE_ERROR;
+    }
+    return SQLITE_OK;
+}
+
+void fts5_delete(Fts5Tokenizer *tokenizer) {
+    delete reinterpret_cast<PorterTokenizer*>(tokenizer);
+}
+
+int fts5_tokenize(Fts5Tokenizer *tokenizer, void *ctx, int flags,
+                  const char *text, int length,
+                  int (*token_callback)(void *ctx, int flags, const char *token, int length, int start, int end)) {
+    string input(text, length);
+    // The FTS5 query parser strips the '*' from prefix queries, but
+    // the tokenizer looks for it to keep a short final word.
+    if (flags & FTS5_TOKENIZE_PREFIX) {
+        input += '*';
+    }
+    // make_fts5_query() quotes the text of each query token
+    // separately, but a CJK bigram followed by '*' also yields its
+    // last character.  Only the first token is wanted: more would
+    // make a phrase.
+    const bool first_only = flags & FTS5_TOKENIZE_QUERY;
+    try {
+        return reinterpret_cast<PorterTokenizer*>(tokenizer)->tokenize(
+            input, [&](const char *token, int token_length, int start, int end) {
+                int rc = token_callback(ctx, 0, token, token_length, start, std::min(end, length));
+                return rc == SQLITE_OK && first_only ? SQLITE_DONE : rc;
+            });
+    } catch (const std::bad_alloc &e) {
+        return SQLITE_NOMEM;
+    }
+}
+
+}
+
+void register_fts5_tokenizer(sqlite3 *db) {
+    fts5_api *api = nullptr;
+    Statement query(db, "SELECT fts5(?)");
+    query.bindPointer(1, &api, "fts5_api_ptr");
+    query.step();
+    if (api == nullptr) {
+        throw runtime_error("Could not get FTS5 API");
+    }
+    fts5_tokenizer tokenizer = {fts5_create, fts5_delete, fts5_tokenize};
+    if (api->xCreateTokenizer(api, "mozporter", nullptr, &tokenizer, nullptr) != SQLITE_OK) {
+        throw runtime_error(sqlite3_errmsg(db));
+    }
+}
+
+void register_fts3_tokenizer(sqlite3 *db) {
+    // Passing the module as a pointer is only allowed while enabled.
+    if (sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 1, nullptr) != SQLITE_OK) {
+        throw runtime_error(sqlite3_errmsg(db));
+    }
+    try {
+        Statement query(db, "SELECT fts3_tokenizer(?, ?)");
+        query.bind(1, "mozporter");
+        const sqlite3_tokenizer_module *module = nullptr;
+        sqlite3Fts3PorterTokenizerModule(&module);
+        query.bind(2, &module, sizeof(module));
+        query.step();
+    } catch (...) {
+        sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 0, nullptr);
+        throw;
+    }
+    sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 0, nullptr);
+}
+
+string make_fts5_query(const string &term) {
+    // Find the words the tokenizer would index, treating the last as
+    // a prefix as the FTS4 queries did.  Each is quoted separately,
+    // as an index built with detail=column cannot match phrases.
+    vector<pair<int, int>> words;
+    PorterTokenizer tokenizer;
+    int rc = tokenizer.tokenize(term + "*", [&](const char *, int, int start, int end) {
+            end = std::min<int>(end, term.size());
+            // Skip the last character of a CJK bigram, which the
+            // tokenizer repeats when it ends the query.
+            if (words.empty() || end > words.back().second) {
+                words.emplace_back(start, end);
+            }
+            return SQLITE_OK;
+        });
+    if (rc != SQLITE_OK) {
+        throw runtime_error(sqlite3_errstr(rc));
+    }
+
+    string query;
+    for (const auto &word : words) {
+        if (!query.empty()) {
+            query += ' ';
+        }
+        query += '"';
+        for (int i = word.first; i < word.second; i++) {
+            if (term[i] == '"') {
+                query += '"';
+            }
+            query += term[i];
+        }
+        query += '"';
+        if (word.second == (int)term.size()) {
+            query += '*';
+        }
+    }
+    return query;
+}
+
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXTRACTIONJOURNAL_HH
+#define EXTRACTIONJOURNAL_HH
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mediascanner {
+
+// The files whose metadata is being extracted, kept in a few fixed
+// size slots of a memory mapped file.  The kernel keeps the pages of
+// the file when the process dies, so whatever is left in it when it
+// is next opened was being extracted by a process that crashed.
+//
+// Recording a file costs a copy into the mapping, rather than a
+// write to the database.  It does not survive a power failure, which
+// is not what it guards against.
+class ExtractionJournal final {
+public:
+    // An empty path keeps the slots in memory only.
+    explicit ExtractionJournal(const std::string &path);
+    ~ExtractionJournal();
+
+    ExtractionJournal(const ExtractionJournal &other) = delete;
+    ExtractionJournal &operator=(const ExtractionJournal &other) = delete;
+
+    // Returns false if the file does not fit in a slot, or all are
+    // taken.
+    bool begin(const std::string &filename, const std::string &etag);
+    void end(const std::string &filename);
+
+    // The files and etags left by a previous process.  Their slots
+    // are cleared.
+    std::vector<std::pair<std::string, std::string>> takeLeftovers();
+
+private:
+    struct Slot;
+    std::mutex slotsMutex;
+    Slot *slots = nullptr;
+    bool mapped = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KNOWNFILES_HH
+#define KNOWNFILES_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mediascanner {
+
+class MediaStore;
+
+// The files below a directory that a store already knows about, as
+// returned by getKnownFiles(): the etag each has in the
+// media table, and the etag it had when it last failed to scan.
+// Loading them all with one query lets a rescan skip unchanged
+// files without asking the store about each.
+//
+// check() notes which files it was asked about, so once a scan has
+// walked the whole directory getUnseen() lists the files that are
+// no longer there.
+class KnownFiles final {
+public:
+    enum Status {
+        New,        // Not in the store
+        Changed,    // In the store with a different etag
+        Unchanged,  // In the store with the same etag
+        Broken,     // Failed to scan with the same etag
+    };
+
+    KnownFiles();
+    KnownFiles(KnownFiles &&other);
+    ~KnownFiles();
+
+    KnownFiles(const KnownFiles &other) = delete;
+    KnownFiles &operator=(const KnownFiles &other) = delete;
+    KnownFiles &operator=(KnownFiles &&other);
+
+    size_t size() const noexcept;
+
+    // Compare a file found by the scanner with what the store has,
+    // and mark it as seen.  A file that failed to scan before is
+    // Broken rather than Unchanged.
+    Status check(const std::string &filename, const std::string &etag);
+
+    // The files in the media table that check() was not asked about.
+    std::vector<std::string> getUnseen() const;
+
+    // Add a file, in byte order of filename.  Either etag may be
+    // null: the file is then not in the media table, or has not
+    // failed to scan.
+    void add(const std::string &filename, const char *etag, const char *broken_etag);
+
+private:
+    struct Private;
+    Private *p;
+};
+
+// The etags of every file below directory in the store's media and
+// broken files tables, so a scan can check them all at once.
+KnownFiles getKnownFiles(const MediaStore &store, const std::string &directory);
+
+}
+
+#endif
@@ -23,18 +23,21 @@
 #include <cstdint>
 #include <string>
 
+#include "StringPool.hh"
+
 namespace mediascanner {
 
 struct MediaFilePrivate {
     std::string filename;
-    std::string content_type;
     std::string etag;
     std::string title;
     std::string date; // ISO date string.  Should this be time since epoch?
-    std::string author;
-    std::string album;
-    std::string album_artist;
-    std::string genre;
+    // Fields that repeat across many files are interned.
+    InternedString content_type;
+    InternedString author;
+    InternedString album;
+    InternedString album_artist;
+    InternedString genre;
     int disc_number = 0;
     int track_number = 0;
     int duration = 0; // In seconds.
@@ -58,6 +61,11 @@ struct MediaFilePrivate {
     void setFallbackMetadata();
 };
 
+// The art URI of a media file, for MediaFile and MediaFileBatch.
+std::string make_art_uri(MediaType type, bool has_thumbnail,
+                         const std::string &filename,
+                         const std::string &author, const std::string &album);
+
 }
 
 #endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RESULTCACHE_HH
+#define RESULTCACHE_HH
+
+#include "../Filter.hh"
+#include "../scannercore.hh"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace mediascanner {
+
+// The MediaStore methods whose results can be cached.
+enum class CachedMethod {
+    Query,
+    QueryBatch,
+    QueryAlbums,
+    QueryArtists,
+    ListSongs,
+    ListSongsBatch,
+    ListMedia,
+    ListMediaBatch,
+    ListAlbums,
+    ListArtists,
+    ListAlbumArtists,
+    ListGenres,
+    ListFolder,
+    HasMedia,
+    Count,
+    Aggregate,
+    Facets,
+};
+
+// The arguments of a cached call.  Methods that take no query string
+// or media type leave them empty.
+struct ResultCacheKey {
+    CachedMethod method;
+    std::string q;
+    MediaType type;
+    Filter filter;
+
+    bool operator==(const ResultCacheKey &other) const;
+};
+
+struct ResultCacheKeyHash {
+    size_t operator()(const ResultCacheKey &key) const;
+};
+
+// Identifies a published snapshot file.  The inode alone is not
+// enough: once a snapshot is replaced its inode number is free to be
+// reused by a later one, so the size and times are compared too.
+struct SnapshotId {
+    dev_t dev = 0;
+    ino_t ino = 0;          // 0 if there is no snapshot
+    int64_t size = 0;
+    int64_t mtime_ns = 0;
+    int64_t ctime_ns = 0;
+
+    SnapshotId() = default;
+    explicit SnapshotId(const struct stat &st);
+    bool operator==(const SnapshotId &other) const;
+    bool operator!=(const SnapshotId &other) const;
+};
+
+// Identifies the database contents a result was read from.  A
+// published snapshot never changes, so identifying it is enough;
+// when a reader uses the database itself, the version is the
+// connection's PRAGMA data_version, which only means something for
+// that connection.
+struct DataVersion {
+    SnapshotId snapshot;
+    const void *connection = nullptr;
+    int64_t data_version = 0;
+
+    bool operator==(const DataVersion &other) const;
+    bool operator!=(const DataVersion &other) const;
+};
+
+// A size bounded cache of query results, evicting the least recently
+// used.  Results are type erased: the method in the key determines
+// what each holds.  Every result belongs to the same data version;
+// asking with a different version empties the cache.  Thread safe.
+class ResultCache final {
+public:
+    ResultCache() = default;
+    ResultCache(const ResultCache &other) = delete;
+    ResultCache& operator=(const ResultCache &other) = delete;
+
+    // A capacity of 0 turns the cache off.
+    void setCapacity(size_t capacity);
+    size_t capacity() const;
+    size_t size() const;
+
+    // Returns nullptr, counting a miss, if there is no result for the
+    // key at this version.
+    std::shared_ptr<const void> get(const ResultCacheKey &key, const DataVersion &version);
+    void put(const ResultCacheKey &key, const DataVersion &version,
+             std::shared_ptr<const void> result);
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    typedef std::pair<ResultCacheKey, std::shared_ptr<const void>> Entry;
+
+    void setVersion(const DataVersion &version);
+
+    mutable std::mutex cacheMutex;
+    size_t capacity_ = 0;
+    DataVersion version;
+    // Most recently used first.
+    std::list<Entry> entries;
+    std::unordered_map<ResultCacheKey, std::list<Entry>::iterator, ResultCacheKeyHash> index;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+}
+
+#endif
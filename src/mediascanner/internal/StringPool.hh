@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRINGPOOL_HH
+#define STRINGPOOL_HH
+
+#include <string>
+
+namespace mediascanner {
+
+struct InternedEntry;
+
+// An immutable string shared through a process-wide pool, so that
+// values repeated across many media files (artists, albums, genres,
+// content types) are stored once.  Copies share the pooled string
+// and the entry is freed with its last reference.  It is the size
+// of a pointer, and the empty string needs no entry at all.
+class InternedString final {
+public:
+    InternedString() noexcept = default;
+    explicit InternedString(const std::string &value);
+    InternedString(const InternedString &other) noexcept;
+    InternedString(InternedString &&other) noexcept;
+    ~InternedString();
+
+    InternedString &operator=(const InternedString &other) noexcept;
+    InternedString &operator=(InternedString &&other) noexcept;
+
+    const std::string &str() const noexcept;
+    bool empty() const noexcept { return entry == nullptr; }
+
+    // Equal values share an entry.
+    bool operator==(const InternedString &other) const noexcept {
+        return entry == other.entry;
+    }
+    bool operator!=(const InternedString &other) const noexcept {
+        return entry != other.entry;
+    }
+
+    // The number of distinct strings in the pool.
+    static size_t pool_size();
+
+private:
+    InternedEntry *entry = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FTS_HH
+#define FTS_HH
+
+#include <string>
+
+struct sqlite3;
+
+namespace mediascanner {
+
+// Register the mozporter tokenizer with the connection's FTS5
+// module.  It wraps the FTS3 tokenizer in mozilla/fts3_porter.c, so
+// the index holds the same terms as the old FTS4 table did.
+void register_fts5_tokenizer(sqlite3 *db);
+
+// Register the tokenizer with the connection's FTS3 module, as used
+// by the FTS4 index of schema versions before 14.  Only needed to
+// migrate such a database.
+void register_fts3_tokenizer(sqlite3 *db);
+
+// Turn a search term typed by the user into an FTS5 query matching
+// every word in it, the last as a prefix.  Returns an empty string
+// if the term has nothing to search for.
+std::string make_fts5_query(const std::string &term);
+
+}
+
+#endif
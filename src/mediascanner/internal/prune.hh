@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PRUNE_HH
+#define PRUNE_HH
+
+#include <string>
+#include <vector>
+
+namespace mediascanner {
+
+// The media that should be removed from the database because it
+// has been deleted from disk or is in a scan blocked directory.
+struct PrunePlan {
+    // Directories that are gone or scan blocked: everything below
+    // them should be removed.
+    std::vector<std::string> subtrees;
+    // Files missing from directories that still exist.
+    std::vector<std::string> files;
+};
+
+// Check the given files against the file system.  Each directory is
+// listed once rather than checking every file, and directories are
+// checked in parallel on num_threads threads.
+PrunePlan plan_prune(const std::vector<std::string> &filenames, unsigned int num_threads);
+
+}
+
+#endif
@@ -22,17 +22,120 @@
 
 #include <sqlite3.h>
 #include <cstdint>
+#include <list>
+#include <map>
 #include <stdexcept>
 #include <string>
 
 namespace mediascanner {
 
+/* Prepared statements that are kept around between uses, keyed by
+ * their SQL text.  Statements are handed out by the Statement
+ * constructor and reset when it releases them.  The cache holds at
+ * most "capacity" statements: when it is full, the least recently
+ * used statement that is not in use is finalized. */
+class StatementCache final {
+public:
+    struct Entry {
+        sqlite3_stmt *statement = nullptr;
+        bool in_use = false;
+    };
+
+    explicit StatementCache(sqlite3 *db, size_t capacity=64)
+        : db(db), capacity(capacity) {}
+    ~StatementCache() {
+        clear();
+    }
+    StatementCache(const StatementCache &other) = delete;
+    StatementCache& operator=(const StatementCache &other) = delete;
+
+    sqlite3 *getDb() const {
+        return db;
+    }
+
+    // Returns nullptr if the cached statement is already in use, in
+    // which case the caller should prepare a private copy.
+    Entry *acquire(const std::string &sql) {
+        auto found = index.find(sql);
+        if (found != index.end()) {
+            // Move to the front of the recently used list.
+            lru.splice(lru.begin(), lru, found->second);
+        } else {
+            Entry entry;
+            int rc = sqlite3_prepare_v2(db, sql.c_str(), sql.size(),
+                                        &entry.statement, nullptr);
+            if (rc != SQLITE_OK) {
+                throw std::runtime_error(sqlite3_errmsg(db));
+            }
+            lru.emplace_front(sql, entry);
+            index[sql] = lru.begin();
+        }
+        Entry &entry = lru.front().second;
+        if (entry.in_use) {
+            return nullptr;
+        }
+        entry.in_use = true;
+        evict();
+        return &entry;
+    }
+
+    void release(Entry *entry) {
+        // Errors from the last step have already been reported.
+        sqlite3_reset(entry->statement);
+        sqlite3_clear_bindings(entry->statement);
+        entry->in_use = false;
+    }
+
+    void clear() {
+        for (auto &i : lru) {
+            sqlite3_finalize(i.second.statement);
+        }
+        lru.clear();
+        index.clear();
+    }
+
+    size_t size() const {
+        return lru.size();
+    }
+
+private:
+    void evict() {
+        // Statements in use are skipped, so the cache can briefly
+        // grow past its capacity while many of them are active.
+        auto i = lru.end();
+        while (lru.size() > capacity && i != lru.begin()) {
+            --i;
+            if (i->second.in_use) {
+                continue;
+            }
+            sqlite3_finalize(i->second.statement);
+            index.erase(i->first);
+            i = lru.erase(i);
+        }
+    }
+
+    typedef std::list<std::pair<std::string, Entry>> EntryList;
+
+    sqlite3 *db;
+    size_t capacity;
+    // Most recently used first.
+    EntryList lru;
+    std::map<std::string, EntryList::iterator> index;
+};
+
 class Statement {
 public:
     Statement(sqlite3 *db, const char *sql) {
-        rc = sqlite3_prepare_v2(db, sql, -1, &statement, nullptr);
-        if (rc != SQLITE_OK) {
-            throw std::runtime_error(sqlite3_errmsg(db));
+        prepare(db, sql);
+    }
+
+    Statement(StatementCache &cache, const std::string &sql)
+        : cache(&cache), entry(cache.acquire(sql)) {
+        if (entry) {
+            statement = entry->statement;
+            rc = SQLITE_OK;
+        } else {
+            prepare(cache.getDb(), sql.c_str());
         }
     }
 
@@ -77,21 +180,29 @@ public:
             throw std::runtime_error(sqlite3_errstr(rc));
     }
 
+    void bindNull(int pos) {
+        rc = sqlite3_bind_null(statement, pos);
+        if (rc != SQLITE_OK)
+            throw std::runtime_error(sqlite3_errstr(rc));
+    }
+
+    // Bind a pointer for use by an extension, such as the fts5()
+    // function.
+    void bindPointer(int pos, void *ptr, const char *type) {
+        rc = sqlite3_bind_pointer(statement, pos, ptr, type, nullptr);
+        if (rc != SQLITE_OK)
+            throw std::runtime_error(sqlite3_errstr(rc));
+    }
+
     bool step() {
         // Sqlite docs list a few cases where you need to to a rollback
         // if a calling step fails. We don't match those cases but if
         // we change queries that may start to happen.
         // https://sqlite.org/c3ref/step.html
         //
-        // The proper fix would probably be to move to a WAL log, but
-        // it seems to require write access to the mediastore dir
-        // even for readers, which is problematic for confined apps.
-        int retry_count=0;
-        const int max_retries = 100;
-        do {
-            rc = sqlite3_step(statement);
-            retry_count++;
-        } while(rc == SQLITE_BUSY && retry_count < max_retries);
+        // Waiting on a locked database is left to the busy handler
+        // installed on the connection.
+        rc = sqlite3_step(statement);
         switch (rc) {
         case SQLITE_DONE:
             return false;
@@ -102,12 +213,28 @@ public:
         }
     }
 
+    // Prepare the statement to be stepped again with new bindings.
+    void reset() {
+        sqlite3_reset(statement);
+        rc = SQLITE_OK;
+    }
+
     std::string getText(int column) {
         if (rc != SQLITE_ROW)
             throw std::runtime_error("Statement hasn't been executed, or no more results");
         return (const char *)sqlite3_column_text(statement, column);
     }
 
+    // The column's text without copying it, valid until the statement
+    // is stepped again or reset.  Its length goes in length.
+    const char *getTextPointer(int column, size_t &length) {
+        if (rc != SQLITE_ROW)
+            throw std::runtime_error("Statement hasn't been executed, or no more results");
+        const char *text = (const char *)sqlite3_column_text(statement, column);
+        length = sqlite3_column_bytes(statement, column);
+        return text ? text : "";
+    }
+
     int getInt(int column) {
         if (rc != SQLITE_ROW)
             throw std::runtime_error("Statement hasn't been executed, or no more results");
@@ -127,6 +254,11 @@ public:
     }
 
     void finalize() {
+        if (entry != nullptr) {
+            cache->release(entry);
+            entry = nullptr;
+            statement = nullptr;
+        }
         if (statement != nullptr) {
             rc = sqlite3_finalize(statement);
             if (rc != SQLITE_OK) {
@@ -139,8 +271,17 @@ public:
     }
 
 private:
-    sqlite3_stmt *statement;
+    void prepare(sqlite3 *db, const char *sql) {
+        rc = sqlite3_prepare_v2(db, sql, -1, &statement, nullptr);
+        if (rc != SQLITE_OK) {
+            throw std::runtime_error(sqlite3_errmsg(db));
+        }
+    }
+
+    sqlite3_stmt *statement = nullptr;
     int rc;
+    StatementCache *cache = nullptr;
+    StatementCache::Entry *entry = nullptr;
 };
 
 }
@@ -20,7 +20,9 @@
 #ifndef SCAN_UTILS_H
 #define SCAN_UTILS_H
 
+#include<cstdint>
 #include<string>
+#include<vector>
 
 namespace mediascanner {
 
@@ -34,6 +36,16 @@ bool has_scanblock(const std::string &path);
 std::string make_album_art_uri(const std::string &artist, const std::string &album);
 std::string make_thumbnail_uri(const std::string &uri);
 
+// Pack a list of sort keys into an opaque pagination cursor and back.
+std::string encode_cursor(const std::vector<std::string> &keys);
+std::vector<std::string> decode_cursor(const std::string &cursor);
+
+// Convert an ISO 8601 date, as the extractors write them, to seconds
+// since the epoch.  The date may be just a year, or a year and
+// month; times without a zone are taken as UTC.  Returns false if
+// the date is not in one of those forms.
+bool parse_date(const std::string &date, int64_t &seconds);
+
 }
 
 #endif
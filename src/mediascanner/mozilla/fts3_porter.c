@@ -65,6 +65,20 @@
 
 #include "fts3_tokenizer.h"
 
+/*
+ * The ASCII fast path below classifies and folds 32 bytes at a time
+ *  with AVX2 or 16 with SSE2, whichever the compiler was told it may
+ *  use.  MOZPORTER_NO_SIMD forces the scalar version.
+ */
+#if !defined(MOZPORTER_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define PORTER_SSE2 1
+#endif
+#if !defined(MOZPORTER_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define PORTER_AVX2 1
+#endif
+
 /* need some defined to compile without sqlite3 code */
 
 #define sqlite3_malloc malloc
@@ -161,11 +175,118 @@ typedef unsigned char u8;
 
 /* end of compatible block to complie codes */
 
+/**
+ * ASCII fast path.
+ *
+ * Most of what we index is plain ASCII, for which the general path below
+ *  decodes every character as UTF-8 and looks it up in the normalization
+ *  table only to find it is a letter, a digit or a delimiter, and to fold
+ *  [A-Z] to lower case.  These helpers do the same for whole runs of ASCII
+ *  bytes, and stop at the first byte with the high bit set so that the
+ *  caller can hand it to the Unicode/CJK code.
+ *
+ * A token character is one of [0-9A-Za-z_], as in porterIdChar below.
+ *  Any other ASCII byte is a delimiter.
+ */
+#define IS_ASCII_ID(c) (((c)>='0'&&(c)<='9') || ((c)>='A'&&(c)<='Z') || \
+                        ((c)>='a'&&(c)<='z') || (c)=='_')
+
+#ifdef PORTER_SSE2
+/* Bit i is set if byte i of v is an ASCII token character.  The compares
+ * are signed, so bytes of 0x80 and up never match. */
+static inline unsigned int asciiIdMask16(__m128i v){
+  /* Setting 0x20 folds [A-Z] onto [a-z] and nothing else onto them. */
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0'-1)),
+                                _mm_cmplt_epi8(v, _mm_set1_epi8('9'+1)));
+  __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a'-1)),
+                                _mm_cmplt_epi8(lower, _mm_set1_epi8('z'+1)));
+  __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+  return (unsigned int)_mm_movemask_epi8(
+      _mm_or_si128(_mm_or_si128(digit, alpha), under));
+}
+#endif
+
+#ifdef PORTER_AVX2
+static inline unsigned int asciiIdMask32(__m256i v){
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  __m256i digit = _mm256_and_si256(
+      _mm256_cmpgt_epi8(v, _mm256_set1_epi8('0'-1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8('9'+1), v));
+  __m256i alpha = _mm256_and_si256(
+      _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a'-1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8('z'+1), lower));
+  __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+  return (unsigned int)_mm256_movemask_epi8(
+      _mm256_or_si256(_mm256_or_si256(digit, alpha), under));
+}
+#endif
+
+/**
+ * Return the length of the run of ASCII token characters (if wantId) or
+ *  of ASCII delimiters (if not) at the start of z[0..n-1].
+ */
+static int asciiSpan(const unsigned char *z, int n, int wantId){
+  int i = 0;
+#ifdef PORTER_AVX2
+  for( ; i+32<=n; i+=32 ){
+    __m256i v = _mm256_loadu_si256((const __m256i *)(z+i));
+    unsigned int id = asciiIdMask32(v);
+    unsigned int hit = wantId ? id : ~(unsigned int)_mm256_movemask_epi8(v) & ~id;
+    if( hit!=0xffffffffu ) return i + __builtin_ctz(~hit);
+  }
+#endif
+#ifdef PORTER_SSE2
+  for( ; i+16<=n; i+=16 ){
+    __m128i v = _mm_loadu_si128((const __m128i *)(z+i));
+    unsigned int id = asciiIdMask16(v);
+    unsigned int hit = wantId ? id : ~(unsigned int)_mm_movemask_epi8(v) & ~id & 0xffff;
+    if( hit!=0xffff ) return i + __builtin_ctz(~hit);
+  }
+#endif
+  for( ; i<n; i++ ){
+    if( z[i]>=0x80 || IS_ASCII_ID(z[i])!=wantId ) break;
+  }
+  return i;
+}
+
+/**
+ * Copy zIn[0..n-1], which must be ASCII, to zOut folding [A-Z] to lower
+ *  case.  This is what normalize_character() does to ASCII.
+ */
+static void asciiFold(unsigned char *zOut, const unsigned char *zIn, int n){
+  int i = 0;
+#ifdef PORTER_AVX2
+  for( ; i+32<=n; i+=32 ){
+    __m256i v = _mm256_loadu_si256((const __m256i *)(zIn+i));
+    __m256i upper = _mm256_and_si256(
+        _mm256_cmpgt_epi8(v, _mm256_set1_epi8('A'-1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('Z'+1), v));
+    v = _mm256_add_epi8(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+    _mm256_storeu_si256((__m256i *)(zOut+i), v);
+  }
+#endif
+#ifdef PORTER_SSE2
+  for( ; i+16<=n; i+=16 ){
+    __m128i v = _mm_loadu_si128((const __m128i *)(zIn+i));
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A'-1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('Z'+1)));
+    v = _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+    _mm_storeu_si128((__m128i *)(zOut+i), v);
+  }
+#endif
+  for( ; i<n; i++ ){
+    unsigned char c = zIn[i];
+    zOut[i] = (c>='A' && c<='Z') ? c + ('a'-'A') : c;
+  }
+}
+
 /*
 ** Class derived from sqlite3_tokenizer
 */
 typedef struct porter_tokenizer {
   sqlite3_tokenizer base;      /* Base class */
+  int bAsciiFastPath;          /* use the ASCII fast path */
 } porter_tokenizer;
 
 /*
@@ -177,6 +298,7 @@ typedef struct porter_tokenizer_cursor {
   int nInput;                  /* size of the input */
   int iOffset;                 /* current position in zInput */
   int iToken;                  /* index of next token to be returned */
+  int bAsciiFastPath;          /* use the ASCII fast path */
   unsigned char *zToken;       /* storage for current token */
   int nAllocated;              /* space allocated to zToken buffer */
   /**
@@ -210,15 +332,24 @@ extern unsigned int normalize_character(const unsigned int c);
 
 /*
 ** Create a new tokenizer instance.
+**
+** The argument "no_ascii_fastpath" turns off the ASCII fast path, so
+** every character takes the general path.  This is only useful to
+** check or benchmark the fast path against it.
 */
 static int porterCreate(
-  int UNUSED argc, const char UNUSED * const *argv,
+  int argc, const char * const *argv,
   sqlite3_tokenizer **ppTokenizer
 ){
   porter_tokenizer *t;
+  int i;
   t = (porter_tokenizer *) sqlite3_malloc(sizeof(*t));
   if( t==NULL ) return SQLITE_NOMEM;
   memset(t, 0, sizeof(*t));
+  t->bAsciiFastPath = 1;
+  for( i=0; i<argc; i++ ){
+    if( strcmp(argv[i], "no_ascii_fastpath")==0 ) t->bAsciiFastPath = 0;
+  }
   *ppTokenizer = &t->base;
   return SQLITE_OK;
 }
@@ -238,7 +369,7 @@ static int porterDestroy(sqlite3_tokenizer *pTokenizer){
 ** *ppCursor.
 */
 static int porterOpen(
-  sqlite3_tokenizer UNUSED *pTokenizer,  /* The tokenizer */
+  sqlite3_tokenizer *pTokenizer,         /* The tokenizer */
   const char *zInput, int nInput,        /* String to be tokenized */
   sqlite3_tokenizer_cursor **ppCursor    /* OUT: Tokenization cursor */
 ){
@@ -257,6 +388,7 @@ static int porterOpen(
   }
   c->iOffset = 0;                 /* start tokenizing at the beginning */
   c->iToken = 0;
+  c->bAsciiFastPath = ((porter_tokenizer *) pTokenizer)->bAsciiFastPath;
   c->zToken = NULL;               /* no space allocated, yet. */
   c->nAllocated = 0;
   c->iPrevBigramOffset = 0;
@@ -491,9 +623,12 @@ static int isVoicedSoundMark(const unsigned int c)
  *     nBytesIn * MAX_UTF8_GROWTH_FACTOR in order to compensate for
  *     normalization that results in a larger utf-8 encoding.
  * @param pnBytesOut Integer to write the number of bytes in zOut into.
+ * @param isAscii Whether zIn is known to be all ASCII, in which case every
+ *     byte is a character and the copy is a plain case fold.
  */
 static void copy_stemmer(const unsigned char *zIn, const int nBytesIn,
-                         unsigned char *zOut, int *pnBytesOut){
+                         unsigned char *zOut, int *pnBytesOut,
+                         int isAscii){
   const unsigned char *zInTerm = zIn + nBytesIn;
   unsigned char *zOutStart = zOut;
   unsigned int c;
@@ -501,6 +636,21 @@ static void copy_stemmer(const unsigned char *zIn, const int nBytesIn,
   unsigned char *zFrontEnd = NULL, *zBackStart = NULL;
   unsigned int trashC;
 
+  if (isAscii) {
+    if (nBytesIn > 2 * COPY_STEMMER_COPY_HALF_LEN) {
+      asciiFold(zOut, zIn, COPY_STEMMER_COPY_HALF_LEN);
+      asciiFold(zOut + COPY_STEMMER_COPY_HALF_LEN,
+                zInTerm - COPY_STEMMER_COPY_HALF_LEN,
+                COPY_STEMMER_COPY_HALF_LEN);
+      *pnBytesOut = 2 * COPY_STEMMER_COPY_HALF_LEN;
+    } else {
+      asciiFold(zOut, zIn, nBytesIn);
+      *pnBytesOut = nBytesIn;
+    }
+    zOut[*pnBytesOut] = 0;
+    return;
+  }
+
   /* copy normalized character */
   while (zIn < zInTerm) {
     READ_UTF8(zIn, zInTerm, c);
@@ -554,12 +704,15 @@ static void copy_stemmer(const unsigned char *zIn, const int nBytesIn,
 **
 ** Stemming never increases the length of the word.  So there is
 ** no chance of overflowing the zOut buffer.
+**
+** If isAscii is set, zIn is known to hold only ASCII characters.
 */
 static void porter_stemmer(
   const unsigned char *zIn,
   unsigned int nIn,
   unsigned char *zOut,
-  int *pnOut
+  int *pnOut,
+  int isAscii
 ){
   unsigned int i, j, c;
   char zReverse[28];
@@ -570,18 +723,23 @@ static void porter_stemmer(
   if( nIn<3 || nIn>=sizeof(zReverse)-7 ){
     /* The word is too big or too small for the porter stemmer.
     ** Fallback to the copy stemmer */
-    copy_stemmer(zIn, nIn, zOut, pnOut);
+    copy_stemmer(zIn, nIn, zOut, pnOut, isAscii);
     return;
   }
   for (j = sizeof(zReverse) - 6; zTmp < zTerm; j--) {
-    READ_UTF8(zTmp, zTerm, c);
-    c = normalize_character(c);
+    if (isAscii) {
+      c = *(zTmp++);
+      if( c>='A' && c<='Z' ) c += 'a' - 'A';
+    } else {
+      READ_UTF8(zTmp, zTerm, c);
+      c = normalize_character(c);
+    }
     if( c>='a' && c<='z' ){
       zReverse[j] = c;
     }else{
       /* The use of a character not in [a-zA-Z] means that we fallback
       ** to the copy stemmer */
-      copy_stemmer(zIn, nIn, zOut, pnOut);
+      copy_stemmer(zIn, nIn, zOut, pnOut, isAscii);
       return;
     }
   }
@@ -1004,6 +1162,7 @@ static int porterNext(
   const unsigned char *z = (unsigned char *) c->zInput;
   int len = 0;
   int state;
+  int isAscii;
 
   while( c->iOffset < c->nInput ){
     int iStartOffset, numChars;
@@ -1036,8 +1195,17 @@ static int porterNext(
     if (c->iPrevBigramOffset == 0) {
       /* Scan past delimiter characters */
       state = BIGRAM_RESET; /* reset */
-      while (c->iOffset < c->nInput &&
-             isDelim(z + c->iOffset, z + c->nInput, &len, &state)) {
+      while (c->iOffset < c->nInput) {
+        if (c->bAsciiFastPath) {
+          // Every ASCII delimiter leaves the state at BIGRAM_RESET, so
+          //  skip them all at once.  If what follows is ASCII, it is the
+          //  start of an ALPHA token.
+          c->iOffset += asciiSpan(z + c->iOffset, c->nInput - c->iOffset, 0);
+          if (c->iOffset == c->nInput || z[c->iOffset] < 0x80)
+            break;
+        }
+        if (!isDelim(z + c->iOffset, z + c->nInput, &len, &state))
+          break;
         c->iOffset += len;
       }
 
@@ -1056,6 +1224,7 @@ static int porterNext(
     //  pass as defined above, we will have eaten all the delimiters, and in
     //  a CJK pass we are guaranteed that the first character is CJK.)
     state = BIGRAM_RESET; /* state is reset */
+    isAscii = c->bAsciiFastPath;
     // Advance until it is time to emit a token.
     // For ALPHA characters, this means advancing until we encounter a delimiter
     //  or a CJK character.  iOffset will be pointing at the delimiter or CJK
@@ -1068,10 +1237,33 @@ static int porterNext(
     //  when we don't terminate.  However, if we terminate, len still contains
     //  the number of bytes in the character found at iOffset.  (This is useful
     //  in the CJK case.)
-    while (c->iOffset < c->nInput &&
-           !isDelim(z + c->iOffset, z + c->nInput, &len, &state)) {
+    // The ASCII fast path consumes runs of ASCII token characters in the
+    //  RESET and ALPHA states, where isDelim would keep returning 0 and
+    //  leave the state at BIGRAM_ALPHA, and stops at an ASCII delimiter
+    //  just as isDelim would.  Anything else goes to isDelim, so a
+    //  character it lets us advance over is not ASCII.
+    while (c->iOffset < c->nInput) {
+      if (c->bAsciiFastPath &&
+          (state == BIGRAM_RESET || state == BIGRAM_ALPHA)) {
+        int run = asciiSpan(z + c->iOffset, c->nInput - c->iOffset, 1);
+        if (run > 0) {
+          c->iOffset += run;
+          numChars += run;
+          state = BIGRAM_ALPHA;
+          if (c->iOffset == c->nInput)
+            break;
+        }
+        // An ASCII byte after an ALPHA run can only be a delimiter.
+        if (state == BIGRAM_ALPHA && z[c->iOffset] < 0x80) {
+          state = BIGRAM_RESET;
+          break;
+        }
+      }
+      if (isDelim(z + c->iOffset, z + c->nInput, &len, &state))
+        break;
       c->iOffset += len;
       numChars++;
+      isAscii = 0;
     }
 
     if (state == BIGRAM_USE) {
@@ -1125,9 +1317,9 @@ static int porterNext(
 
       if (state == BIGRAM_USE) {
         /* This is by bigram. So it is unnecessary to convert word */
-        copy_stemmer(&z[iStartOffset], n, c->zToken, pnBytes);
+        copy_stemmer(&z[iStartOffset], n, c->zToken, pnBytes, 0);
       } else {
-        porter_stemmer(&z[iStartOffset], n, c->zToken, pnBytes);
+        porter_stemmer(&z[iStartOffset], n, c->zToken, pnBytes, isAscii);
       }
       *pzToken = (const char*)c->zToken;
       *piStartOffset = iStartOffset;
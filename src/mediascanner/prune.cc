@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal/prune.hh"
+#include "internal/utils.hh"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+
+using namespace std;
+
+namespace mediascanner {
+
+namespace {
+
+struct Directory {
+    string path;
+    // Index of the parent directory, or -1 for the root.
+    long parent = -1;
+    // Base names of the files in the database in this directory.
+    vector<string> files;
+
+    // Filled in by check_directory()
+    bool exists = false;
+    bool blocked = false;
+    vector<string> missing;
+};
+
+string parent_dir(const string &path) {
+    auto slash = path.rfind('/');
+    if (slash == 0 || slash == string::npos) {
+        return "/";
+    }
+    return path.substr(0, slash);
+}
+
+void check_directory(Directory &dir) {
+    struct stat st;
+    if (stat(dir.path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return;
+    }
+    dir.exists = true;
+    dir.blocked = has_scanblock(dir.path);
+    if (dir.blocked || dir.files.empty()) {
+        return;
+    }
+
+    unique_ptr<DIR, int(*)(DIR*)> d(opendir(dir.path.c_str()), closedir);
+    if (!d) {
+        // Can't tell which files remain, so keep them all.
+        return;
+    }
+    unordered_set<string> present;
+    unordered_set<string> symlinks;
+    while (struct dirent *entry = readdir(d.get())) {
+        present.insert(entry->d_name);
+        if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+            symlinks.insert(entry->d_name);
+        }
+    }
+    const string prefix = dir.path == "/" ? "/" : dir.path + "/";
+    for (const auto &name : dir.files) {
+        if (present.find(name) == present.end()) {
+            dir.missing.push_back(prefix + name);
+        } else if (symlinks.find(name) != symlinks.end() &&
+                   access((prefix + name).c_str(), F_OK) != 0) {
+            // A dangling symlink
+            dir.missing.push_back(prefix + name);
+        }
+    }
+}
+
+}
+
+PrunePlan plan_prune(const vector<string> &filenames, unsigned int num_threads) {
+    // Group the files by directory, adding every ancestor directory
+    // so scan blocks anywhere up the tree are found.
+    map<string, vector<string>> by_dir;
+    for (const auto &filename : filenames) {
+        auto slash = filename.rfind('/');
+        if (slash == string::npos) {
+            continue;
+        }
+        const string dir = slash == 0 ? "/" : filename.substr(0, slash);
+        by_dir[dir].push_back(filename.substr(slash + 1));
+    }
+    vector<string> ancestors;
+    for (const auto &entry : by_dir) {
+        string dir = entry.first;
+        while (dir != "/") {
+            dir = parent_dir(dir);
+            ancestors.push_back(dir);
+        }
+    }
+    for (const auto &dir : ancestors) {
+        by_dir[dir];
+    }
+
+    // A parent's path is a prefix of its children's, so it sorts
+    // before them.
+    vector<Directory> dirs(by_dir.size());
+    map<string, long> index;
+    long i = 0;
+    for (auto &entry : by_dir) {
+        Directory &dir = dirs[i];
+        dir.path = entry.first;
+        dir.files = move(entry.second);
+        if (dir.path != "/") {
+            dir.parent = index.at(parent_dir(dir.path));
+        }
+        index[dir.path] = i++;
+    }
+
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t n = next++; n < dirs.size(); n = next++) {
+            check_directory(dirs[n]);
+        }
+    };
+    vector<thread> threads;
+    for (unsigned int t = 1; t < num_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    PrunePlan plan;
+    vector<bool> gone(dirs.size());
+    for (size_t n = 0; n < dirs.size(); n++) {
+        const Directory &dir = dirs[n];
+        const bool parent_gone = dir.parent >= 0 && gone[dir.parent];
+        gone[n] = parent_gone || !dir.exists || dir.blocked;
+        if (gone[n]) {
+            if (!parent_gone) {
+                plan.subtrees.push_back(dir.path);
+            }
+        } else {
+            plan.files.insert(plan.files.end(), dir.missing.begin(), dir.missing.end());
+        }
+    }
+    return plan;
+}
+
+}
@@ -38,6 +38,28 @@ enum class MediaOrder {
     Modified,
 };
 
+// The length of the buckets a timeline counts media in.
+enum class TimelineInterval {
+    Day,
+    Month,
+    Year,
+};
+
+// The song attributes facets() can count by.
+enum class FacetField {
+    Artist,
+    AlbumArtist,
+    Genre,
+    Year,
+};
+
+// What happened to a media file, as recorded in the change journal.
+enum class ChangeKind {
+    Insert,
+    Update,
+    Delete,
+};
+
 }
 
 #endif
@@ -152,5 +152,139 @@ std::string make_thumbnail_uri(const std::string &uri) {
     return string("image://thumbnailer/") + uri;
 }
 
+// Each key is stored as its length, a colon and then the key
+// itself, so keys may contain any character.
+string encode_cursor(const vector<string> &keys) {
+    string cursor;
+    for (const auto &key : keys) {
+        cursor += to_string(key.size());
+        cursor += ':';
+        cursor += key;
+    }
+    return cursor;
 }
 
+vector<string> decode_cursor(const string &cursor) {
+    vector<string> keys;
+    size_t pos = 0;
+    while (pos < cursor.size()) {
+        size_t colon = cursor.find(':', pos);
+        if (colon == string::npos || colon == pos || colon - pos > 9) {
+            throw runtime_error("Malformed cursor");
+        }
+        size_t length = 0;
+        for (size_t i = pos; i < colon; i++) {
+            if (cursor[i] < '0' || cursor[i] > '9') {
+                throw runtime_error("Malformed cursor");
+            }
+            length = length * 10 + (cursor[i] - '0');
+        }
+        if (length > cursor.size() - colon - 1) {
+            throw runtime_error("Malformed cursor");
+        }
+        keys.push_back(cursor.substr(colon + 1, length));
+        pos = colon + 1 + length;
+    }
+    return keys;
+}
+
+// Days from 1970-01-01 to a date of the proleptic Gregorian
+// calendar, counting years from March so leap days come last.
+static int64_t days_from_civil(int64_t year, int month, int day) {
+    if (month <= 2) {
+        year--;
+    }
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+static bool read_digits(const char *&s, int count, int &value) {
+    value = 0;
+    for (int i = 0; i < count; i++, s++) {
+        if (*s < '0' || *s > '9') {
+            return false;
+        }
+        value = value * 10 + (*s - '0');
+    }
+    return true;
+}
+
+// Read a zone suffix of Z, +HH, +HHMM or +HH:MM.
+static bool read_zone(const char *&s, int &offset) {
+    offset = 0;
+    if (*s == 'Z') {
+        s++;
+        return true;
+    }
+    if (*s != '+' && *s != '-') {
+        return *s == '\0';
+    }
+    const int sign = *s++ == '-' ? -1 : 1;
+    int hours, minutes = 0;
+    if (!read_digits(s, 2, hours)) {
+        return false;
+    }
+    if (*s == ':') {
+        s++;
+        if (!read_digits(s, 2, minutes)) {
+            return false;
+        }
+    } else if (*s != '\0' && !read_digits(s, 2, minutes)) {
+        return false;
+    }
+    offset = sign * (hours * 3600 + minutes * 60);
+    return hours <= 23 && minutes <= 59;
+}
+
+bool parse_date(const std::string &date, int64_t &seconds) {
+    const char *s = date.c_str();
+    int year, month = 1, day = 1, hour = 0, minute = 0, second = 0, offset = 0;
+    if (!read_digits(s, 4, year)) {
+        return false;
+    }
+    if (*s == '-') {
+        s++;
+        if (!read_digits(s, 2, month)) {
+            return false;
+        }
+        if (*s == '-') {
+            s++;
+            if (!read_digits(s, 2, day)) {
+                return false;
+            }
+            if (*s == 'T' || *s == ' ') {
+                s++;
+                if (!read_digits(s, 2, hour) || *s++ != ':' || !read_digits(s, 2, minute)) {
+                    return false;
+                }
+                if (*s == ':') {
+                    s++;
+                    if (!read_digits(s, 2, second)) {
+                        return false;
+                    }
+                    // Fractions of a second are dropped.
+                    if (*s == '.') {
+                        do {
+                            s++;
+                        } while (*s >= '0' && *s <= '9');
+                    }
+                }
+                if (!read_zone(s, offset)) {
+                    return false;
+                }
+            }
+        }
+    }
+    if (*s != '\0' || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+    seconds = days_from_civil(year, month, day) * 86400 +
+        hour * 3600 + minute * 60 + second - offset;
+    return true;
+}
+
+}
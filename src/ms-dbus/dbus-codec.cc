@@ -20,23 +20,36 @@
 #include "dbus-codec.hh"
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include <core/dbus/object.h>
+#include <core/dbus/types/signature.h>
 
+#include <mediascanner/MediaChange.hh>
 #include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBatch.hh>
 #include <mediascanner/MediaFileBuilder.hh>
+#include <mediascanner/MediaStoreBase.hh>
 #include <mediascanner/Album.hh>
 #include <mediascanner/Filter.hh>
+#include <mediascanner/Folder.hh>
 
 using core::dbus::Message;
 using core::dbus::Codec;
 using core::dbus::types::Variant;
+using mediascanner::ChangeKind;
+using mediascanner::MediaChange;
 using mediascanner::MediaFile;
+using mediascanner::MediaFileBatch;
 using mediascanner::MediaFileBuilder;
+using mediascanner::TimelineEntry;
+using mediascanner::Aggregate;
+using mediascanner::Facet;
 using mediascanner::MediaOrder;
 using mediascanner::MediaType;
 using mediascanner::Album;
 using mediascanner::Filter;
+using mediascanner::Folder;
 using std::string;
 
 void Codec<MediaFile>::encode_argument(Message::Writer &out, const MediaFile &file) {
@@ -97,6 +110,142 @@ void Codec<MediaFile>::decode_argument(Message::Reader &in, MediaFile &file) {
         .setType((MediaType)type);
 }
 
+// The text fields in the order they are sent.
+static const MediaFileBatch::Field batch_text_fields[] = {
+    MediaFileBatch::FileName,
+    MediaFileBatch::ContentType,
+    MediaFileBatch::ETag,
+    MediaFileBatch::Title,
+    MediaFileBatch::Author,
+    MediaFileBatch::Album,
+    MediaFileBatch::AlbumArtist,
+    MediaFileBatch::Date,
+    MediaFileBatch::Genre,
+};
+static const int NUM_BATCH_TEXT_FIELDS = sizeof(batch_text_fields) / sizeof(batch_text_fields[0]);
+
+void Codec<MediaFileBatch>::encode_argument(Message::Writer &out, const MediaFileBatch &batch) {
+    auto w = out.open_array(core::dbus::types::Signature(
+        core::dbus::helper::TypeMapper<MediaFile>::signature()));
+    for (size_t row = 0; row < batch.size(); row++) {
+        auto entry = w.open_structure();
+        for (auto field : batch_text_fields) {
+            entry.push_stringn(batch.getText(row, field),
+                               batch.getTextLength(row, field));
+        }
+        core::dbus::encode_argument(entry, (int32_t)batch.getDiscNumber(row));
+        core::dbus::encode_argument(entry, (int32_t)batch.getTrackNumber(row));
+        core::dbus::encode_argument(entry, (int32_t)batch.getDuration(row));
+        core::dbus::encode_argument(entry, (int32_t)batch.getWidth(row));
+        core::dbus::encode_argument(entry, (int32_t)batch.getHeight(row));
+        core::dbus::encode_argument(entry, batch.getLatitude(row));
+        core::dbus::encode_argument(entry, batch.getLongitude(row));
+        core::dbus::encode_argument(entry, batch.getHasThumbnail(row));
+        core::dbus::encode_argument(entry, batch.getModificationTime(row));
+        core::dbus::encode_argument(entry, (int32_t)batch.getType(row));
+        w.close_structure(std::move(entry));
+    }
+    out.close_array(std::move(w));
+}
+
+void Codec<MediaFileBatch>::decode_argument(Message::Reader &in, MediaFileBatch &batch) {
+    batch.clear();
+    // Reused for every row, so only the first few rows allocate.
+    string text[NUM_BATCH_TEXT_FIELDS];
+    auto entries = in.pop_array();
+    while (entries.type() != core::dbus::ArgumentType::invalid) {
+        auto r = entries.pop_structure();
+        for (int i = 0; i < NUM_BATCH_TEXT_FIELDS; i++) {
+            r >> text[i];
+        }
+        int32_t disc_number, track_number, duration, width, height, type;
+        double latitude, longitude;
+        bool has_thumbnail;
+        uint64_t mtime;
+        r >> disc_number >> track_number >> duration
+          >> width >> height >> latitude >> longitude >> has_thumbnail
+          >> mtime >> type;
+        // appendText() wants the fields in MediaFileBatch::Field order.
+        for (int field = MediaFileBatch::FileName; field <= MediaFileBatch::Genre; field++) {
+            for (int i = 0; i < NUM_BATCH_TEXT_FIELDS; i++) {
+                if (batch_text_fields[i] == field) {
+                    batch.appendText(text[i].data(), text[i].size());
+                    break;
+                }
+            }
+        }
+        batch.appendNumbers(disc_number, track_number, duration,
+                            width, height, latitude, longitude,
+                            has_thumbnail, mtime, (MediaType)type);
+    }
+}
+
+void Codec<MediaChange>::encode_argument(Message::Writer &out, const MediaChange &change) {
+    auto w = out.open_structure();
+    core::dbus::encode_argument(w, change.getSequence());
+    core::dbus::encode_argument(w, static_cast<int32_t>(change.getKind()));
+    core::dbus::encode_argument(w, change.getFileName());
+    core::dbus::encode_argument(w, (int32_t)change.getType());
+    out.close_structure(std::move(w));
+}
+
+void Codec<MediaChange>::decode_argument(Message::Reader &in, MediaChange &change) {
+    auto r = in.pop_structure();
+    int64_t sequence;
+    int32_t kind, type;
+    string filename;
+    r >> sequence >> kind >> filename >> type;
+    change = MediaChange(sequence, static_cast<ChangeKind>(kind), filename, (MediaType)type);
+}
+
+void Codec<TimelineEntry>::encode_argument(Message::Writer &out, const TimelineEntry &entry) {
+    auto w = out.open_structure();
+    core::dbus::encode_argument(w, entry.start);
+    core::dbus::encode_argument(w, (int32_t)entry.count);
+    out.close_structure(std::move(w));
+}
+
+void Codec<TimelineEntry>::decode_argument(Message::Reader &in, TimelineEntry &entry) {
+    auto r = in.pop_structure();
+    int64_t start;
+    int32_t count;
+    r >> start >> count;
+    entry = TimelineEntry(start, count);
+}
+
+void Codec<Aggregate>::encode_argument(Message::Writer &out, const Aggregate &aggregate) {
+    auto w = out.open_structure();
+    core::dbus::encode_argument(w, aggregate.count);
+    core::dbus::encode_argument(w, aggregate.duration);
+    core::dbus::encode_argument(w, aggregate.albums);
+    core::dbus::encode_argument(w, aggregate.artists);
+    out.close_structure(std::move(w));
+}
+
+void Codec<Aggregate>::decode_argument(Message::Reader &in, Aggregate &aggregate) {
+    auto r = in.pop_structure();
+    int64_t count, duration, albums, artists;
+    r >> count >> duration >> albums >> artists;
+    aggregate = Aggregate(count, duration, albums, artists);
+}
+
+void Codec<Facet>::encode_argument(Message::Writer &out, const Facet &facet) {
+    auto w = out.open_structure();
+    core::dbus::encode_argument(w, facet.value);
+    core::dbus::encode_argument(w, facet.track_count);
+    core::dbus::encode_argument(w, facet.album_count);
+    core::dbus::encode_argument(w, facet.duration);
+    out.close_structure(std::move(w));
+}
+
+void Codec<Facet>::decode_argument(Message::Reader &in, Facet &facet) {
+    auto r = in.pop_structure();
+    std::string value;
+    int64_t track_count, album_count, duration;
+    r >> value >> track_count >> album_count >> duration;
+    facet = Facet(value, track_count, album_count, duration);
+}
+
 void Codec<Album>::encode_argument(Message::Writer &out, const Album &album) {
     auto w = out.open_structure();
     core::dbus::encode_argument(w, album.getTitle());
@@ -119,6 +268,41 @@ void Codec<Album>::decode_argument(Message::Reader &in, Album &album) {
     album = Album(title, artist, date, genre, art_file, has_thumbnail, artist_count);
 }
 
+void Codec<Folder>::encode_argument(Message::Writer &out, const Folder &folder) {
+    auto w = out.open_structure();
+    core::dbus::encode_argument(w, folder.getPath());
+    core::dbus::encode_argument(w, (int32_t)folder.getMediaCount());
+    auto subfolders = w.open_array(core::dbus::types::Signature("(si)"));
+    for (const auto &subfolder : folder.getSubfolders()) {
+        auto entry = subfolders.open_structure();
+        core::dbus::encode_argument(entry, subfolder.getPath());
+        core::dbus::encode_argument(entry, (int32_t)subfolder.getMediaCount());
+        subfolders.close_structure(std::move(entry));
+    }
+    w.close_array(std::move(subfolders));
+    core::dbus::encode_argument(w, folder.getMedia());
+    out.close_structure(std::move(w));
+}
+
+void Codec<Folder>::decode_argument(Message::Reader &in, Folder &folder) {
+    auto r = in.pop_structure();
+    string path;
+    int32_t media_count;
+    r >> path >> media_count;
+    std::vector<Folder> subfolders;
+    auto entries = r.pop_array();
+    while (entries.type() != core::dbus::ArgumentType::invalid) {
+        auto entry = entries.pop_structure();
+        string subfolder_path;
+        int32_t subfolder_count;
+        entry >> subfolder_path >> subfolder_count;
+        subfolders.emplace_back(subfolder_path, subfolder_count);
+    }
+    std::vector<MediaFile> media;
+    r >> media;
+    folder = Folder(path, media_count, subfolders, media);
+}
+
 void Codec<Filter>::encode_argument(Message::Writer &out, const Filter &filter) {
     auto w = out.open_array(core::dbus::types::Signature("{sv}"));
 
@@ -139,10 +323,27 @@ void Codec<Filter>::encode_argument(Message::Writer &out, const Filter &filter)
             w.open_dict_entry() << string("genre") << Variant::encode(filter.getGenre()));
     }
 
+    if (filter.hasDateRange()) {
+        w.close_dict_entry(
+            w.open_dict_entry() << string("date_start") << Variant::encode(filter.getDateStart()));
+        w.close_dict_entry(
+            w.open_dict_entry() << string("date_end") << Variant::encode(filter.getDateEnd()));
+    }
+    if (filter.hasModifiedRange()) {
+        w.close_dict_entry(
+            w.open_dict_entry() << string("modified_start") << Variant::encode(filter.getModifiedStart()));
+        w.close_dict_entry(
+            w.open_dict_entry() << string("modified_end") << Variant::encode(filter.getModifiedEnd()));
+    }
+
     w.close_dict_entry(
         w.open_dict_entry() << string("offset") << Variant::encode((int32_t)filter.getOffset()));
     w.close_dict_entry(
         w.open_dict_entry() << string("limit") << Variant::encode((int32_t)filter.getLimit()));
+    if (filter.hasCursor()) {
+        w.close_dict_entry(
+            w.open_dict_entry() << string("cursor") << Variant::encode(filter.getCursor()));
+    }
     w.close_dict_entry(
         w.open_dict_entry() << string("order") << Variant::encode(static_cast<int32_t>(filter.getOrder())));
     w.close_dict_entry(
@@ -155,6 +356,10 @@ void Codec<Filter>::decode_argument(Message::Reader &in, Filter &filter) {
     auto r = in.pop_array();
 
     filter.clear();
+    // A range is only set once both of its ends are seen.
+    bool have_date_start = false, have_date_end = false;
+    bool have_modified_start = false, have_modified_end = false;
+    int64_t date_start = 0, date_end = 0, modified_start = 0, modified_end = 0;
     while (r.type() != ArgumentType::invalid) {
         string key;
         Variant value;
@@ -172,10 +377,30 @@ void Codec<Filter>::decode_argument(Message::Reader &in, Filter &filter) {
             filter.setOffset(value.as<int32_t>());
         } else if (key == "limit") {
             filter.setLimit(value.as<int32_t>());
+        } else if (key == "cursor") {
+            filter.setCursor(value.as<string>());
         } else if (key == "order") {
             filter.setOrder(static_cast<MediaOrder>(value.as<int32_t>()));
         } else if (key == "reverse") {
             filter.setReverse(value.as<bool>());
+        } else if (key == "date_start") {
+            date_start = value.as<int64_t>();
+            have_date_start = true;
+        } else if (key == "date_end") {
+            date_end = value.as<int64_t>();
+            have_date_end = true;
+        } else if (key == "modified_start") {
+            modified_start = value.as<int64_t>();
+            have_modified_start = true;
+        } else if (key == "modified_end") {
+            modified_end = value.as<int64_t>();
+            have_modified_end = true;
         }
     }
+    if (have_date_start && have_date_end) {
+        filter.setDateRange(date_start, date_end);
+    }
+    if (have_modified_start && have_modified_end) {
+        filter.setModifiedRange(modified_start, modified_end);
+    }
 }
@@ -26,8 +26,14 @@
 
 namespace mediascanner {
 class MediaFile;
+class MediaFileBatch;
+class MediaChange;
+struct TimelineEntry;
+struct Aggregate;
+struct Facet;
 class Album;
 class Filter;
+class Folder;
 }
 
 namespace core {
@@ -39,12 +45,50 @@ struct Codec<mediascanner::MediaFile> {
     static void decode_argument(Message::Reader &in, mediascanner::MediaFile &file);
 };
 
+// Sent as an array of MediaFile structures, so either end may use
+// std::vector<MediaFile> instead.
+template <>
+struct Codec<mediascanner::MediaFileBatch> {
+    static void encode_argument(Message::Writer &out, const mediascanner::MediaFileBatch &batch);
+    static void decode_argument(Message::Reader &in, mediascanner::MediaFileBatch &batch);
+};
+
+template <>
+struct Codec<mediascanner::MediaChange> {
+    static void encode_argument(Message::Writer &out, const mediascanner::MediaChange &change);
+    static void decode_argument(Message::Reader &in, mediascanner::MediaChange &change);
+};
+
+template <>
+struct Codec<mediascanner::TimelineEntry> {
+    static void encode_argument(Message::Writer &out, const mediascanner::TimelineEntry &entry);
+    static void decode_argument(Message::Reader &in, mediascanner::TimelineEntry &entry);
+};
+
+template <>
+struct Codec<mediascanner::Aggregate> {
+    static void encode_argument(Message::Writer &out, const mediascanner::Aggregate &aggregate);
+    static void decode_argument(Message::Reader &in, mediascanner::Aggregate &aggregate);
+};
+
+template <>
+struct Codec<mediascanner::Facet> {
+    static void encode_argument(Message::Writer &out, const mediascanner::Facet &facet);
+    static void decode_argument(Message::Reader &in, mediascanner::Facet &facet);
+};
+
 template <>
 struct Codec<mediascanner::Album> {
     static void encode_argument(Message::Writer &out, const mediascanner::Album &album);
     static void decode_argument(Message::Reader &in, mediascanner::Album &album);
 };
 
+template <>
+struct Codec<mediascanner::Folder> {
+    static void encode_argument(Message::Writer &out, const mediascanner::Folder &folder);
+    static void decode_argument(Message::Reader &in, mediascanner::Folder &folder);
+};
+
 template <>
 struct Codec<mediascanner::Filter> {
     static void encode_argument(Message::Writer &out, const mediascanner::Filter &filter);
@@ -70,6 +114,91 @@ struct TypeMapper<mediascanner::MediaFile> {
     }
 };
 
+template<>
+struct TypeMapper<mediascanner::MediaFileBatch> {
+    constexpr static ArgumentType type_value() {
+        return ArgumentType::array;
+    }
+    constexpr static bool is_basic_type() {
+        return false;
+    }
+    constexpr static bool requires_signature() {
+        return true;
+    }
+    static const std::string &signature() {
+        static const std::string s = "a(sssssssssiiiiiddbti)";
+        return s;
+    }
+};
+
+template<>
+struct TypeMapper<mediascanner::MediaChange> {
+    constexpr static ArgumentType type_value() {
+        return ArgumentType::structure;
+    }
+    constexpr static bool is_basic_type() {
+        return false;
+    }
+    constexpr static bool requires_signature() {
+        return true;
+    }
+    static const std::string &signature() {
+        static const std::string s = "(xisi)";
+        return s;
+    }
+};
+
+template<>
+struct TypeMapper<mediascanner::TimelineEntry> {
+    constexpr static ArgumentType type_value() {
+        return ArgumentType::structure;
+    }
+    constexpr static bool is_basic_type() {
+        return false;
+    }
+    constexpr static bool requires_signature() {
+        return true;
+    }
+    static const std::string &signature() {
+        static const std::string s = "(xi)";
+        return s;
+    }
+};
+
+template<>
+struct TypeMapper<mediascanner::Aggregate> {
+    constexpr static ArgumentType type_value() {
+        return ArgumentType::structure;
+    }
+    constexpr static bool is_basic_type() {
+        return false;
+    }
+    constexpr static bool requires_signature() {
+        return true;
+    }
+    static const std::string &signature() {
+        static const std::string s = "(xxxx)";
+        return s;
+    }
+};
+
+template<>
+struct TypeMapper<mediascanner::Facet> {
+    constexpr static ArgumentType type_value() {
+        return ArgumentType::structure;
+    }
+    constexpr static bool is_basic_type() {
+        return false;
+    }
+    constexpr static bool requires_signature() {
+        return true;
+    }
+    static const std::string &signature() {
+        static const std::string s = "(sxxx)";
+        return s;
+    }
+};
+
 template<>
 struct TypeMapper<mediascanner::Album> {
     constexpr static ArgumentType type_value() {
@@ -87,6 +216,25 @@ struct TypeMapper<mediascanner::Album> {
     }
 };
 
+// Subfolders are sent as (path, media count) pairs, since D-Bus
+// signatures cannot be recursive.
+template<>
+struct TypeMapper<mediascanner::Folder> {
+    constexpr static ArgumentType type_value() {
+        return ArgumentType::structure;
+    }
+    constexpr static bool is_basic_type() {
+        return false;
+    }
+    constexpr static bool requires_signature() {
+        return true;
+    }
+    static const std::string &signature() {
+        static const std::string s = "(sia(si)a(sssssssssiiiiiddbti))";
+        return s;
+    }
+};
+
 template<>
 struct TypeMapper<mediascanner::Filter> {
     constexpr static ArgumentType type_value() {
@@ -209,6 +209,149 @@ struct MediaStoreInterface {
             return Interface::default_timeout();
         }
     };
+
+    struct ListFolder {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "ListFolder";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct GetChangeSequence {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "GetChangeSequence";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct GetChangesSince {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "GetChangesSince";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct QueryBoundingBox {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "QueryBoundingBox";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct QueryNearest {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "QueryNearest";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct Timeline {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "Timeline";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct ListMedia {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "ListMedia";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct Count {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "Count";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct Aggregate {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "Aggregate";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct Facets {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "Facets";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
+
+    struct LookupMany {
+        typedef MediaStoreInterface Interface;
+
+        inline static const std::string& name() {
+            static std::string s = "LookupMany";
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout() {
+            return Interface::default_timeout();
+        }
+    };
 };
 
 }
@@ -31,6 +31,8 @@ int main(int , char **) {
     bus->install_executor(core::dbus::asio::make_executor(bus));
 
     auto store = std::make_shared<MediaStore>(MS_READ_ONLY);
+    // Scopes and models repeat the same few queries between scans.
+    store->setCacheSize(64);
 
     dbus::ServiceSkeleton service(bus, store);
     service.run();
@@ -10,7 +10,10 @@
 
 #include <mediascanner/Album.hh>
 #include <mediascanner/Filter.hh>
+#include <mediascanner/Folder.hh>
+#include <mediascanner/MediaChange.hh>
 #include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBatch.hh>
 #include <mediascanner/MediaStore.hh>
 
 #include "dbus-interface.hh"
@@ -113,6 +116,61 @@ struct ServiceSkeleton::Private {
                 &Private::handle_has_media,
                 this,
                 std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::ListFolder>(
+            std::bind(
+                &Private::handle_list_folder,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::GetChangeSequence>(
+            std::bind(
+                &Private::handle_get_change_sequence,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::GetChangesSince>(
+            std::bind(
+                &Private::handle_get_changes_since,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::QueryBoundingBox>(
+            std::bind(
+                &Private::handle_query_bounding_box,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::QueryNearest>(
+            std::bind(
+                &Private::handle_query_nearest,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::Timeline>(
+            std::bind(
+                &Private::handle_timeline,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::ListMedia>(
+            std::bind(
+                &Private::handle_list_media,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::Count>(
+            std::bind(
+                &Private::handle_count,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::Aggregate>(
+            std::bind(
+                &Private::handle_aggregate,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::Facets>(
+            std::bind(
+                &Private::handle_facets,
+                this,
+                std::placeholders::_1));
+        object->install_method_handler<MediaStoreInterface::LookupMany>(
+            std::bind(
+                &Private::handle_lookup_many,
+                this,
+                std::placeholders::_1));
     }
 
     std::string get_client_apparmor_context(const Message::Ptr &message) {
@@ -217,7 +275,7 @@ struct ServiceSkeleton::Private {
 
         Message::Ptr reply;
         try {
-            auto results = store->query(query, (MediaType)type, filter);
+            auto results = store->queryBatch(query, (MediaType)type, filter);
             reply = Message::make_method_return(message);
             reply->writer() << results;
         } catch (const std::exception &e) {
@@ -315,7 +373,7 @@ struct ServiceSkeleton::Private {
         message->reader() >> filter;
         Message::Ptr reply;
         try {
-            auto results = store->listSongs(filter);
+            auto results = store->listSongsBatch(filter);
             reply = Message::make_method_return(message);
             reply->writer() << results;
         } catch (const std::exception &e) {
@@ -420,6 +478,232 @@ struct ServiceSkeleton::Private {
         }
         impl->access_bus()->send(reply);
     }
+
+    void handle_list_folder(const Message::Ptr &message) {
+        if (!check_access(message, AllMedia))
+            return;
+
+        std::string path;
+        Filter filter;
+        message->reader() >> path >> filter;
+        Message::Ptr reply;
+        try {
+            auto folder = store->listFolder(path, filter);
+            reply = Message::make_method_return(message);
+            reply->writer() << folder;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_get_change_sequence(const Message::Ptr &message) {
+        if (!check_access(message, AllMedia))
+            return;
+
+        Message::Ptr reply;
+        try {
+            int64_t sequence = store->getChangeSequence();
+            reply = Message::make_method_return(message);
+            reply->writer() << sequence;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_get_changes_since(const Message::Ptr &message) {
+        if (!check_access(message, AllMedia))
+            return;
+
+        int64_t sequence;
+        message->reader() >> sequence;
+        Message::Ptr reply;
+        try {
+            auto changes = store->getChangesSince(sequence);
+            reply = Message::make_method_return(message);
+            reply->writer() << changes;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_query_bounding_box(const Message::Ptr &message) {
+        double min_latitude, min_longitude, max_latitude, max_longitude;
+        int32_t type;
+        Filter filter;
+        message->reader() >> min_latitude >> min_longitude >> max_latitude
+                          >> max_longitude >> type >> filter;
+
+        if (!check_access(message, (MediaType)type))
+            return;
+
+        Message::Ptr reply;
+        try {
+            auto results = store->queryBoundingBox(
+                min_latitude, min_longitude, max_latitude, max_longitude,
+                (MediaType)type, filter);
+            reply = Message::make_method_return(message);
+            reply->writer() << results;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_query_nearest(const Message::Ptr &message) {
+        double latitude, longitude;
+        int32_t type;
+        Filter filter;
+        message->reader() >> latitude >> longitude >> type >> filter;
+
+        if (!check_access(message, (MediaType)type))
+            return;
+
+        Message::Ptr reply;
+        try {
+            auto results = store->queryNearest(
+                latitude, longitude, (MediaType)type, filter);
+            reply = Message::make_method_return(message);
+            reply->writer() << results;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_timeline(const Message::Ptr &message) {
+        int32_t type, interval;
+        Filter filter;
+        message->reader() >> type >> interval >> filter;
+
+        if (!check_access(message, (MediaType)type))
+            return;
+
+        Message::Ptr reply;
+        try {
+            auto results = store->timeline(
+                (MediaType)type, static_cast<TimelineInterval>(interval), filter);
+            reply = Message::make_method_return(message);
+            reply->writer() << results;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_list_media(const Message::Ptr &message) {
+        int32_t type;
+        Filter filter;
+        message->reader() >> type >> filter;
+
+        if (!check_access(message, (MediaType)type))
+            return;
+
+        Message::Ptr reply;
+        try {
+            auto results = store->listMediaBatch((MediaType)type, filter);
+            reply = Message::make_method_return(message);
+            reply->writer() << results;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_count(const Message::Ptr &message) {
+        int32_t type;
+        Filter filter;
+        message->reader() >> type >> filter;
+
+        if (!check_access(message, (MediaType)type))
+            return;
+
+        Message::Ptr reply;
+        try {
+            int64_t count = store->count((MediaType)type, filter);
+            reply = Message::make_method_return(message);
+            reply->writer() << count;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_aggregate(const Message::Ptr &message) {
+        if (!check_access(message, AudioMedia))
+            return;
+
+        Filter filter;
+        message->reader() >> filter;
+        Message::Ptr reply;
+        try {
+            auto aggregate = store->aggregate(filter);
+            reply = Message::make_method_return(message);
+            reply->writer() << aggregate;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_facets(const Message::Ptr &message) {
+        if (!check_access(message, AudioMedia))
+            return;
+
+        int32_t field;
+        Filter filter;
+        message->reader() >> field >> filter;
+        Message::Ptr reply;
+        try {
+            auto facets = store->facets(static_cast<FacetField>(field), filter);
+            reply = Message::make_method_return(message);
+            reply->writer() << facets;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
+
+    void handle_lookup_many(const Message::Ptr &message) {
+        if (!check_access(message, AllMedia))
+            return;
+
+        std::vector<std::string> filenames;
+        message->reader() >> filenames;
+        Message::Ptr reply;
+        try {
+            auto files = store->lookupMany(filenames);
+            reply = Message::make_method_return(message);
+            reply->writer() << files;
+        } catch (const std::exception &e) {
+            reply = Message::make_error(
+                message, MediaStoreInterface::Errors::Error::name(),
+                e.what());
+        }
+        impl->access_bus()->send(reply);
+    }
 };
 
 ServiceSkeleton::ServiceSkeleton(core::dbus::Bus::Ptr bus,
@@ -23,7 +23,10 @@
 
 #include <mediascanner/Album.hh>
 #include <mediascanner/Filter.hh>
+#include <mediascanner/Folder.hh>
+#include <mediascanner/MediaChange.hh>
 #include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBatch.hh>
 #include "dbus-interface.hh"
 #include "dbus-codec.hh"
 
@@ -60,6 +63,13 @@ std::vector<MediaFile> ServiceStub::query(const string &q, MediaType type, const
     return result.value();
 }
 
+MediaFileBatch ServiceStub::queryBatch(const string &q, MediaType type, const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::Query, MediaFileBatch>(q, (int32_t)type, filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
 std::vector<Album> ServiceStub::queryAlbums(const string &core_term, const Filter &filter) const {
     auto result = p->object->invoke_method_synchronously<MediaStoreInterface::QueryAlbums, std::vector<Album>>(core_term, filter);
     if (result.is_error())
@@ -95,6 +105,13 @@ std::vector<MediaFile> ServiceStub::listSongs(const Filter &filter) const {
     return result.value();
 }
 
+MediaFileBatch ServiceStub::listSongsBatch(const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::ListSongs, MediaFileBatch>(filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
 std::vector<Album> ServiceStub::listAlbums(const Filter &filter) const {
     auto result = p->object->invoke_method_synchronously<MediaStoreInterface::ListAlbums, std::vector<Album>>(filter);
     if (result.is_error())
@@ -129,5 +146,93 @@ bool ServiceStub::hasMedia(MediaType type) const {
     return result.value();
 }
 
+Folder ServiceStub::listFolder(const std::string &path, const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::ListFolder, Folder>(path, filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+int64_t ServiceStub::getChangeSequence() const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::GetChangeSequence, int64_t>();
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+std::vector<MediaChange> ServiceStub::getChangesSince(int64_t sequence) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::GetChangesSince, std::vector<MediaChange>>(sequence);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+std::vector<MediaFile> ServiceStub::queryBoundingBox(double min_latitude, double min_longitude,
+                                                     double max_latitude, double max_longitude,
+                                                     MediaType type, const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::QueryBoundingBox, std::vector<MediaFile>>(min_latitude, min_longitude, max_latitude, max_longitude, (int32_t)type, filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+std::vector<TimelineEntry> ServiceStub::timeline(MediaType type, TimelineInterval interval,
+                                                 const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::Timeline, std::vector<TimelineEntry>>((int32_t)type, static_cast<int32_t>(interval), filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+std::vector<MediaFile> ServiceStub::queryNearest(double latitude, double longitude,
+                                                 MediaType type, const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::QueryNearest, std::vector<MediaFile>>(latitude, longitude, (int32_t)type, filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+std::vector<MediaFile> ServiceStub::listMedia(MediaType type, const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::ListMedia, std::vector<MediaFile>>((int32_t)type, filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+MediaFileBatch ServiceStub::listMediaBatch(MediaType type, const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::ListMedia, MediaFileBatch>((int32_t)type, filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+int64_t ServiceStub::count(MediaType type, const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::Count, int64_t>((int32_t)type, filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+Aggregate ServiceStub::aggregate(const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::Aggregate, Aggregate>(filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+std::vector<Facet> ServiceStub::facets(FacetField field, const Filter &filter) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::Facets, std::vector<Facet>>(static_cast<int32_t>(field), filter);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
+std::vector<MediaFile> ServiceStub::lookupMany(const std::vector<std::string> &filenames) const {
+    auto result = p->object->invoke_method_synchronously<MediaStoreInterface::LookupMany, std::vector<MediaFile>>(filenames);
+    if (result.is_error())
+        throw std::runtime_error(result.error().print());
+    return result.value();
+}
+
 }
 }
@@ -33,7 +33,10 @@ namespace mediascanner {
 
 class Album;
 class Filter;
+class Folder;
 class MediaFile;
+class MediaFileBatch;
+class MediaChange;
 
 namespace dbus {
 
@@ -54,6 +57,24 @@ public:
     virtual std::vector<std::string> listAlbumArtists(const Filter &filter) const override;
     virtual std::vector<std::string> listGenres(const Filter &filter) const override;
     virtual bool hasMedia(MediaType type) const override;
+    virtual Folder listFolder(const std::string &path, const Filter &filter) const override;
+    virtual MediaFileBatch queryBatch(const std::string &q, MediaType type, const Filter &filter) const override;
+    virtual MediaFileBatch listSongsBatch(const Filter &filter) const override;
+    virtual int64_t getChangeSequence() const override;
+    virtual std::vector<MediaChange> getChangesSince(int64_t sequence) const override;
+    virtual std::vector<MediaFile> queryBoundingBox(double min_latitude, double min_longitude,
+                                                    double max_latitude, double max_longitude,
+                                                    MediaType type, const Filter &filter) const override;
+    virtual std::vector<MediaFile> queryNearest(double latitude, double longitude,
+                                                MediaType type, const Filter &filter) const override;
+    virtual std::vector<TimelineEntry> timeline(MediaType type, TimelineInterval interval,
+                                                const Filter &filter) const override;
+    virtual std::vector<MediaFile> listMedia(MediaType type, const Filter &filter) const override;
+    virtual MediaFileBatch listMediaBatch(MediaType type, const Filter &filter) const override;
+    virtual int64_t count(MediaType type, const Filter &filter) const override;
+    virtual Aggregate aggregate(const Filter &filter) const override;
+    virtual std::vector<Facet> facets(FacetField field, const Filter &filter) const override;
+    virtual std::vector<MediaFile> lookupMany(const std::vector<std::string> &filenames) const override;
 
 private:
     struct Private;
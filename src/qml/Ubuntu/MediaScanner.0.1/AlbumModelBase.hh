@@ -24,6 +24,7 @@
 #include <QString>
 
 #include <mediascanner/Album.hh>
+#include <mediascanner/Filter.hh>
 #include "StreamingModel.hh"
 
 namespace mediascanner {
@@ -53,6 +54,11 @@ public:
         AlbumRowData(std::vector<mediascanner::Album> &&rows) : rows(std::move(rows)) {}
         ~AlbumRowData() {}
         size_t size() const override { return rows.size(); }
+        std::string cursorAfter() const override {
+            mediascanner::Filter filter;
+            filter.setCursorAfter(rows.back());
+            return filter.getCursor();
+        }
         std::vector<mediascanner::Album> rows;
     };
 
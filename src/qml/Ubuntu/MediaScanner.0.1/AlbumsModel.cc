@@ -97,10 +97,11 @@ void AlbumsModel::setLimit(int) {
     qWarning() << "Setting limit on AlbumsModel is deprecated";
 }
 
-std::unique_ptr<StreamingModel::RowData> AlbumsModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset) const {
+std::unique_ptr<StreamingModel::RowData> AlbumsModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset, const std::string &cursor) const {
     auto limit_filter = filter;
     limit_filter.setLimit(limit);
     limit_filter.setOffset(offset);
+    limit_filter.setCursor(cursor);
     return std::unique_ptr<StreamingModel::RowData>(
         new AlbumRowData(store->listAlbums(limit_filter)));
 }
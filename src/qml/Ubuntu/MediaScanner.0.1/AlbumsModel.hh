@@ -38,7 +38,7 @@ class AlbumsModel : public AlbumModelBase {
 public:
     explicit AlbumsModel(QObject *parent=0);
 
-    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset) const override;
+    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset, const std::string &cursor) const override;
 
 protected:
     QVariant getArtist();
@@ -26,6 +26,9 @@ ArtistsModel::ArtistsModel(QObject *parent)
     : StreamingModel(parent),
       album_artists(false) {
     roles[Roles::RoleArtist] = "artist";
+    roles[Roles::RoleTrackCount] = "trackCount";
+    roles[Roles::RoleAlbumCount] = "albumCount";
+    roles[Roles::RoleDuration] = "duration";
 }
 
 int ArtistsModel::rowCount(const QModelIndex &) const {
@@ -38,7 +41,13 @@ QVariant ArtistsModel::data(const QModelIndex &index, int role) const {
     }
     switch (role) {
     case RoleArtist:
-        return QString::fromStdString(results[index.row()]);
+        return QString::fromStdString(results[index.row()].value);
+    case RoleTrackCount:
+        return static_cast<int>(results[index.row()].track_count);
+    case RoleAlbumCount:
+        return static_cast<int>(results[index.row()].album_count);
+    case RoleDuration:
+        return static_cast<int>(results[index.row()].duration);
     default:
         return QVariant();
     }
@@ -91,23 +100,25 @@ void ArtistsModel::setLimit(int) {
 namespace {
 class ArtistRowData : public StreamingModel::RowData {
 public:
-    ArtistRowData(std::vector<std::string> &&rows) : rows(std::move(rows)) {}
+    ArtistRowData(std::vector<mediascanner::Facet> &&rows) : rows(std::move(rows)) {}
     ~ArtistRowData() {}
     size_t size() const override { return rows.size(); }
-    std::vector<std::string> rows;
+    std::string cursorAfter() const override {
+        mediascanner::Filter filter;
+        filter.setCursorAfterName(rows.back().value);
+        return filter.getCursor();
+    }
+    std::vector<mediascanner::Facet> rows;
 };
 }
 
-std::unique_ptr<StreamingModel::RowData> ArtistsModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset) const {
+std::unique_ptr<StreamingModel::RowData> ArtistsModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset, const std::string &cursor) const {
     auto limit_filter = filter;
     limit_filter.setLimit(limit);
     limit_filter.setOffset(offset);
-    std::vector<std::string> artists;
-    if (album_artists) {
-        artists = store->listAlbumArtists(limit_filter);
-    } else {
-        artists = store->listArtists(limit_filter);
-    }
+    limit_filter.setCursor(cursor);
+    auto artists = store->facets(
+        album_artists ? FacetField::AlbumArtist : FacetField::Artist, limit_filter);
     return std::unique_ptr<StreamingModel::RowData>(
         new ArtistRowData(std::move(artists)));
 }
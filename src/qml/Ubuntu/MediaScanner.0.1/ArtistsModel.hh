@@ -39,6 +39,9 @@ class ArtistsModel : public StreamingModel {
 public:
     enum Roles {
         RoleArtist,
+        RoleTrackCount,
+        RoleAlbumCount,
+        RoleDuration,
     };
 
     explicit ArtistsModel(QObject *parent = 0);
@@ -46,7 +49,7 @@ public:
     int rowCount(const QModelIndex &parent=QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role) const override;
 
-    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset) const override;
+    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset, const std::string &cursor) const override;
     void appendRows(std::unique_ptr<RowData> &&row_data) override;
     void clearBacking() override;
 
@@ -62,7 +65,7 @@ protected:
 
 private:
     QHash<int, QByteArray> roles;
-    std::vector<std::string> results;
+    std::vector<mediascanner::Facet> results;
     Filter filter;
     bool album_artists;
 };
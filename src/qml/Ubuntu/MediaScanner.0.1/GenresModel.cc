@@ -25,6 +25,9 @@ using namespace mediascanner::qml;
 GenresModel::GenresModel(QObject *parent)
     : StreamingModel(parent) {
     roles[Roles::RoleGenre] = "genre";
+    roles[Roles::RoleTrackCount] = "trackCount";
+    roles[Roles::RoleAlbumCount] = "albumCount";
+    roles[Roles::RoleDuration] = "duration";
 }
 
 int GenresModel::rowCount(const QModelIndex &) const {
@@ -37,7 +40,13 @@ QVariant GenresModel::data(const QModelIndex &index, int role) const {
     }
     switch (role) {
     case RoleGenre:
-        return QString::fromStdString(results[index.row()]);
+        return QString::fromStdString(results[index.row()].value);
+    case RoleTrackCount:
+        return static_cast<int>(results[index.row()].track_count);
+    case RoleAlbumCount:
+        return static_cast<int>(results[index.row()].album_count);
+    case RoleDuration:
+        return static_cast<int>(results[index.row()].duration);
     default:
         return QVariant();
     }
@@ -58,19 +67,25 @@ void GenresModel::setLimit(int) {
 namespace {
 class GenreRowData : public StreamingModel::RowData {
 public:
-    GenreRowData(std::vector<std::string> &&rows) : rows(std::move(rows)) {}
+    GenreRowData(std::vector<mediascanner::Facet> &&rows) : rows(std::move(rows)) {}
     ~GenreRowData() {}
     size_t size() const override { return rows.size(); }
-    std::vector<std::string> rows;
+    std::string cursorAfter() const override {
+        mediascanner::Filter filter;
+        filter.setCursorAfterName(rows.back().value);
+        return filter.getCursor();
+    }
+    std::vector<mediascanner::Facet> rows;
 };
 }
 
-std::unique_ptr<StreamingModel::RowData> GenresModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset) const {
+std::unique_ptr<StreamingModel::RowData> GenresModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset, const std::string &cursor) const {
     auto limit_filter = filter;
     limit_filter.setLimit(limit);
     limit_filter.setOffset(offset);
+    limit_filter.setCursor(cursor);
     return std::unique_ptr<StreamingModel::RowData>(
-        new GenreRowData(store->listGenres(limit_filter)));
+        new GenreRowData(store->facets(FacetField::Genre, limit_filter)));
 }
 
 void GenresModel::appendRows(std::unique_ptr<StreamingModel::RowData> &&row_data) {
@@ -38,13 +38,16 @@ class GenresModel : public StreamingModel {
 public:
     enum Roles {
         RoleGenre,
+        RoleTrackCount,
+        RoleAlbumCount,
+        RoleDuration,
     };
 
     explicit GenresModel(QObject *parent = 0);
     int rowCount(const QModelIndex &parent=QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role) const override;
 
-    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset) const override;
+    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset, const std::string &cursor) const override;
     void appendRows(std::unique_ptr<RowData> &&row_data) override;
     void clearBacking() override;
 
@@ -56,7 +59,7 @@ protected:
 
 private:
     QHash<int, QByteArray> roles;
-    std::vector<std::string> results;
+    std::vector<mediascanner::Facet> results;
     mediascanner::Filter filter;
 };
 
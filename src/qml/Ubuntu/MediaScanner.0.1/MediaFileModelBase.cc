@@ -21,6 +21,7 @@
 #include "MediaFileWrapper.hh"
 
 using namespace mediascanner::qml;
+using mediascanner::MediaFileBatch;
 
 MediaFileModelBase::MediaFileModelBase(QObject *parent)
     : StreamingModel(parent) {
@@ -49,50 +50,55 @@ int MediaFileModelBase::rowCount(const QModelIndex &) const {
     return results.size();
 }
 
+QString MediaFileModelBase::text(int row, MediaFileBatch::Field field) const {
+    return QString::fromUtf8(results.getText(row, field),
+                             results.getTextLength(row, field));
+}
+
 QVariant MediaFileModelBase::data(const QModelIndex &index, int role) const {
     if (index.row() < 0 || index.row() >= (ptrdiff_t)results.size()) {
         return QVariant();
     }
-    const mediascanner::MediaFile &media = results[index.row()];
+    const int row = index.row();
     switch (role) {
     case RoleModelData:
-        return QVariant::fromValue(new MediaFileWrapper(media));
+        return QVariant::fromValue(new MediaFileWrapper(results.getMediaFile(row)));
     case RoleFilename:
-        return QString::fromStdString(media.getFileName());
+        return text(row, MediaFileBatch::FileName);
     case RoleUri:
-        return QString::fromStdString(media.getUri());
+        return QString::fromStdString(results.getUri(row));
     case RoleContentType:
-        return QString::fromStdString(media.getContentType());
+        return text(row, MediaFileBatch::ContentType);
     case RoleETag:
-        return QString::fromStdString(media.getETag());
+        return text(row, MediaFileBatch::ETag);
     case RoleTitle:
-        return QString::fromStdString(media.getTitle());
+        return text(row, MediaFileBatch::Title);
     case RoleAuthor:
-        return QString::fromStdString(media.getAuthor());
+        return text(row, MediaFileBatch::Author);
     case RoleAlbum:
-        return QString::fromStdString(media.getAlbum());
+        return text(row, MediaFileBatch::Album);
     case RoleAlbumArtist:
-        return QString::fromStdString(media.getAlbumArtist());
+        return text(row, MediaFileBatch::AlbumArtist);
     case RoleDate:
-        return QString::fromStdString(media.getDate());
+        return text(row, MediaFileBatch::Date);
     case RoleGenre:
-        return QString::fromStdString(media.getGenre());
+        return text(row, MediaFileBatch::Genre);
     case RoleDiscNumber:
-        return media.getDiscNumber();
+        return results.getDiscNumber(row);
     case RoleTrackNumber:
-        return media.getTrackNumber();
+        return results.getTrackNumber(row);
     case RoleDuration:
-        return media.getDuration();
+        return results.getDuration(row);
     case RoleWidth:
-        return media.getWidth();
+        return results.getWidth(row);
     case RoleHeight:
-        return media.getHeight();
+        return results.getHeight(row);
     case RoleLatitude:
-        return media.getLatitude();
+        return results.getLatitude(row);
     case RoleLongitude:
-        return media.getLongitude();
+        return results.getLongitude(row);
     case RoleArt:
-        return QString::fromStdString(media.getArtUri());
+        return QString::fromStdString(results.getArtUri(row));
     default:
         return QVariant();
     }
@@ -105,7 +111,11 @@ QHash<int, QByteArray> MediaFileModelBase::roleNames() const {
 
 void MediaFileModelBase::appendRows(std::unique_ptr<RowData> &&row_data) {
     MediaFileRowData *data = static_cast<MediaFileRowData*>(row_data.get());
-    std::move(data->rows.begin(), data->rows.end(), std::back_inserter(results));
+    if (results.empty()) {
+        results = std::move(data->rows);
+    } else {
+        results.append(data->rows);
+    }
 }
 
 void MediaFileModelBase::clearBacking() {
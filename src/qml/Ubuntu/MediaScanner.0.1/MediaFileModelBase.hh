@@ -23,7 +23,9 @@
 #include <QAbstractListModel>
 #include <QString>
 
+#include <mediascanner/Filter.hh>
 #include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBatch.hh>
 #include "StreamingModel.hh"
 
 namespace mediascanner {
@@ -65,19 +67,25 @@ public:
 
     class MediaFileRowData : public RowData {
     public:
-        MediaFileRowData(std::vector<mediascanner::MediaFile> &&rows) : rows(std::move(rows)) {}
+        MediaFileRowData(mediascanner::MediaFileBatch &&rows) : rows(std::move(rows)) {}
         ~MediaFileRowData() {}
         size_t size() const override { return rows.size(); }
-        std::vector<mediascanner::MediaFile> rows;
+        std::string cursorAfter() const override {
+            mediascanner::Filter filter;
+            filter.setCursorAfter(rows.getMediaFile(rows.size() - 1));
+            return filter.getCursor();
+        }
+        mediascanner::MediaFileBatch rows;
     };
 
 protected:
     QHash<int, QByteArray> roleNames() const override;
-    void updateResults(const std::vector<mediascanner::MediaFile> &results);
 
 private:
+    QString text(int row, mediascanner::MediaFileBatch::Field field) const;
+
     QHash<int, QByteArray> roles;
-    std::vector<mediascanner::MediaFile> results;
+    mediascanner::MediaFileBatch results;
 };
 
 }
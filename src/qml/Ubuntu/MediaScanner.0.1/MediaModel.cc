@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MediaModel.hh"
+
+using namespace mediascanner::qml;
+
+MediaModel::MediaModel(QObject *parent)
+    : MediaFileModelBase(parent), type(MediaStoreWrapper::ImageMedia) {
+}
+
+MediaStoreWrapper::MediaType MediaModel::getMediaType() {
+    return type;
+}
+
+void MediaModel::setMediaType(MediaStoreWrapper::MediaType type) {
+    if (this->type != type) {
+        this->type = type;
+        invalidate();
+    }
+}
+
+MediaModel::Order MediaModel::getOrder() {
+    return static_cast<Order>(filter.getOrder());
+}
+
+void MediaModel::setOrder(Order order) {
+    if (filter.getOrder() != static_cast<MediaOrder>(order)) {
+        filter.setOrder(static_cast<MediaOrder>(order));
+        invalidate();
+    }
+}
+
+bool MediaModel::getReverse() {
+    return filter.getReverse();
+}
+
+void MediaModel::setReverse(bool reverse) {
+    if (filter.getReverse() != reverse) {
+        filter.setReverse(reverse);
+        invalidate();
+    }
+}
+
+int MediaModel::getTotalCount() {
+    return getTotals().count;
+}
+
+std::unique_ptr<StreamingModel::RowData> MediaModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset, const std::string &cursor) const {
+    auto limit_filter = filter;
+    limit_filter.setLimit(limit);
+    limit_filter.setOffset(offset);
+    limit_filter.setCursor(cursor);
+    return std::unique_ptr<StreamingModel::RowData>(
+        new MediaFileRowData(store->listMediaBatch(static_cast<MediaType>(type), limit_filter)));
+}
+
+mediascanner::Aggregate MediaModel::retrieveTotals(std::shared_ptr<MediaStoreBase> store) const {
+    mediascanner::Aggregate totals;
+    totals.count = store->count(static_cast<MediaType>(type), filter);
+    return totals;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEDIASCANNER_QML_MEDIAMODEL_H
+#define MEDIASCANNER_QML_MEDIAMODEL_H
+
+#include <mediascanner/Filter.hh>
+#include "MediaStoreWrapper.hh"
+#include "MediaFileModelBase.hh"
+
+namespace mediascanner {
+namespace qml {
+
+// All the media of one type, such as every photo newest first.
+class MediaModel : public MediaFileModelBase {
+    Q_OBJECT
+    Q_ENUMS(Order)
+    Q_PROPERTY(mediascanner::qml::MediaStoreWrapper::MediaType mediaType READ getMediaType WRITE setMediaType)
+    Q_PROPERTY(Order order READ getOrder WRITE setOrder)
+    Q_PROPERTY(bool reverse READ getReverse WRITE setReverse)
+    Q_PROPERTY(int totalCount READ getTotalCount NOTIFY totalsChanged)
+public:
+    enum Order {
+        Default = static_cast<int>(mediascanner::MediaOrder::Default),
+        Title = static_cast<int>(mediascanner::MediaOrder::Title),
+        Date = static_cast<int>(mediascanner::MediaOrder::Date),
+        Modified = static_cast<int>(mediascanner::MediaOrder::Modified),
+    };
+
+    explicit MediaModel(QObject *parent=0);
+
+    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset, const std::string &cursor) const override;
+    mediascanner::Aggregate retrieveTotals(std::shared_ptr<mediascanner::MediaStoreBase> store) const override;
+
+protected:
+    MediaStoreWrapper::MediaType getMediaType();
+    void setMediaType(MediaStoreWrapper::MediaType type);
+    Order getOrder();
+    void setOrder(Order order);
+    bool getReverse();
+    void setReverse(bool reverse);
+    int getTotalCount();
+
+private:
+    MediaStoreWrapper::MediaType type;
+    Filter filter;
+};
+
+}
+}
+
+#endif
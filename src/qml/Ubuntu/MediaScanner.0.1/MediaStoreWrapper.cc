@@ -99,6 +99,35 @@ MediaFileWrapper *MediaStoreWrapper::lookup(const QString &filename) {
     return wrapper;
 }
 
+QList<QObject*> MediaStoreWrapper::lookupMany(const QStringList &filenames) {
+    if (!store) {
+        qWarning() << "lookupMany() called on invalid MediaStore";
+        return QList<QObject*>();
+    }
+
+    std::vector<std::string> names;
+    names.reserve(filenames.size());
+    for (const auto &filename : filenames) {
+        names.push_back(filename.toStdString());
+    }
+    QList<QObject*> result;
+    try {
+        for (const auto &media : store->lookupMany(names)) {
+            if (media.getFileName().empty()) {
+                result.append(nullptr);
+                continue;
+            }
+            auto wrapper = new MediaFileWrapper(media);
+            QQmlEngine::setObjectOwnership(wrapper, QQmlEngine::JavaScriptOwnership);
+            result.append(wrapper);
+        }
+    } catch (const std::exception &e) {
+        qWarning() << "Failed to look up media:" << e.what();
+        return QList<QObject*>();
+    }
+    return result;
+}
+
 void MediaStoreWrapper::resultsInvalidated() {
     Q_EMIT updated();
 }
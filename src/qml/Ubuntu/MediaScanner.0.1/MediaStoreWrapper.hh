@@ -25,6 +25,7 @@
 #include <QList>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 
 #include <mediascanner/MediaStoreBase.hh>
 #include "MediaFileWrapper.hh"
@@ -47,6 +48,8 @@ public:
 
     Q_INVOKABLE QList<QObject*> query(const QString &q, MediaType type);
     Q_INVOKABLE mediascanner::qml::MediaFileWrapper *lookup(const QString &filename);
+    // Files not in the store are null in the result.
+    Q_INVOKABLE QList<QObject*> lookupMany(const QStringList &filenames);
 
     std::shared_ptr<mediascanner::MediaStoreBase> store;
 
@@ -118,10 +118,31 @@ void SongsModel::setLimit(int) {
     qWarning() << "Setting limit on SongsModel is deprecated";
 }
 
-std::unique_ptr<StreamingModel::RowData> SongsModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset) const {
+int SongsModel::getTotalCount() {
+    return getTotals().count;
+}
+
+int SongsModel::getTotalDuration() {
+    return getTotals().duration;
+}
+
+int SongsModel::getAlbumCount() {
+    return getTotals().albums;
+}
+
+int SongsModel::getArtistCount() {
+    return getTotals().artists;
+}
+
+std::unique_ptr<StreamingModel::RowData> SongsModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset, const std::string &cursor) const {
     auto limit_filter = filter;
     limit_filter.setLimit(limit);
     limit_filter.setOffset(offset);
+    limit_filter.setCursor(cursor);
     return std::unique_ptr<StreamingModel::RowData>(
-        new MediaFileRowData(store->listSongs(limit_filter)));
+        new MediaFileRowData(store->listSongsBatch(limit_filter)));
+}
+
+mediascanner::Aggregate SongsModel::retrieveTotals(std::shared_ptr<MediaStoreBase> store) const {
+    return store->aggregate(filter);
 }
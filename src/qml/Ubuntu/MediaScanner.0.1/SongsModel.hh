@@ -36,10 +36,15 @@ class SongsModel : public MediaFileModelBase {
     Q_PROPERTY(QVariant albumArtist READ getAlbumArtist WRITE setAlbumArtist)
     Q_PROPERTY(QVariant genre READ getGenre WRITE setGenre)
     Q_PROPERTY(int limit READ getLimit WRITE setLimit)
+    Q_PROPERTY(int totalCount READ getTotalCount NOTIFY totalsChanged)
+    Q_PROPERTY(int totalDuration READ getTotalDuration NOTIFY totalsChanged)
+    Q_PROPERTY(int albumCount READ getAlbumCount NOTIFY totalsChanged)
+    Q_PROPERTY(int artistCount READ getArtistCount NOTIFY totalsChanged)
 public:
     explicit SongsModel(QObject *parent=0);
 
-    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset) const override;
+    std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset, const std::string &cursor) const override;
+    mediascanner::Aggregate retrieveTotals(std::shared_ptr<mediascanner::MediaStoreBase> store) const override;
 
 protected:
     QVariant getArtist();
@@ -52,6 +57,10 @@ protected:
     void setGenre(const QVariant genre);
     int getLimit();
     void setLimit(int limit);
+    int getTotalCount();
+    int getTotalDuration();
+    int getAlbumCount();
+    int getArtistCount();
 
 private:
     Filter filter;
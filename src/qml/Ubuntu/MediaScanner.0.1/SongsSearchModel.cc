@@ -38,11 +38,11 @@ void SongsSearchModel::setQuery(const QString query) {
     }
 }
 
-std::unique_ptr<StreamingModel::RowData> SongsSearchModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset) const {
-    std::vector<mediascanner::MediaFile> songs;
+std::unique_ptr<StreamingModel::RowData> SongsSearchModel::retrieveRows(std::shared_ptr<MediaStoreBase> store, int limit, int offset, const std::string &cursor) const {
     mediascanner::Filter limit_filter;
     limit_filter.setLimit(limit);
     limit_filter.setOffset(offset);
+    limit_filter.setCursor(cursor);
     return std::unique_ptr<StreamingModel::RowData>(
-        new MediaFileRowData(store->query(query.toStdString(), mediascanner::AudioMedia, limit_filter)));
+        new MediaFileRowData(store->queryBatch(query.toStdString(), mediascanner::AudioMedia, limit_filter)));
 }
@@ -37,6 +37,8 @@ class AdditionEvent : public QEvent {
 private:
     std::unique_ptr<StreamingModel::RowData> rows;
     bool error = false;
+    bool has_totals = false;
+    mediascanner::Aggregate totals;
     int generation;
 
 public:
@@ -50,8 +52,14 @@ public:
     void setError(bool e) {
         error = e;
     }
+    void setTotals(const mediascanner::Aggregate &t) {
+        totals = t;
+        has_totals = true;
+    }
     std::unique_ptr<StreamingModel::RowData>& getRows() { return rows; }
     bool getError() const { return error; }
+    bool hasTotals() const { return has_totals; }
+    const mediascanner::Aggregate& getTotals() const { return totals; }
     int getGeneration() const { return generation; }
 
     static QEvent::Type additionEventType()
@@ -65,7 +73,10 @@ void runQuery(int generation, StreamingModel *model, std::shared_ptr<mediascanne
     if (!store) {
         return;
     }
+    // The offset is only used by orderings that can not be resumed
+    // from a cursor, such as search rank.
     int offset = 0;
+    std::string cursor;
     int cursize;
     do {
         if(model->shouldWorkerStop()) {
@@ -73,13 +84,19 @@ void runQuery(int generation, StreamingModel *model, std::shared_ptr<mediascanne
         }
         QScopedPointer<AdditionEvent> e(new AdditionEvent(generation));
         try {
-            e->setRows(model->retrieveRows(store, BATCH_SIZE, offset));
+            e->setRows(model->retrieveRows(store, BATCH_SIZE, offset, cursor));
+            if (offset == 0 && cursor.empty()) {
+                e->setTotals(model->retrieveTotals(store));
+            }
         } catch (const std::exception &exc) {
             qWarning() << "Failed to retrieve rows:" << exc.what();
             e->setError(true);
             return;
         }
         cursize = e->getRows()->size();
+        if (cursize > 0) {
+            cursor = e->getRows()->cursorAfter();
+        }
         if (model->shouldWorkerStop()) {
             return;
         }
@@ -136,6 +153,11 @@ bool StreamingModel::event(QEvent *e) {
         return true;
     }
 
+    if (ae->hasTotals()) {
+        totals = ae->getTotals();
+        Q_EMIT totalsChanged();
+    }
+
     auto &newrows = ae->getRows();
     bool lastBatch = newrows->size() < BATCH_SIZE;
     beginInsertRows(QModelIndex(), rowCount(), rowCount()+newrows->size()-1);
@@ -148,6 +170,10 @@ bool StreamingModel::event(QEvent *e) {
     return true;
 }
 
+mediascanner::Aggregate StreamingModel::retrieveTotals(std::shared_ptr<mediascanner::MediaStoreBase>) const {
+    return mediascanner::Aggregate();
+}
+
 MediaStoreWrapper *StreamingModel::getStore() const {
     return store.data();
 }
@@ -167,6 +193,10 @@ void StreamingModel::setStore(MediaStoreWrapper *store) {
     }
 }
 
+const mediascanner::Aggregate &StreamingModel::getTotals() const {
+    return totals;
+}
+
 StreamingModel::ModelStatus StreamingModel::getStatus() const {
     return status;
 }
@@ -187,5 +217,7 @@ void StreamingModel::invalidate() {
     clearBacking();
     endResetModel();
     Q_EMIT countChanged();
+    totals = mediascanner::Aggregate();
+    Q_EMIT totalsChanged();
     updateModel();
 }
@@ -22,6 +22,7 @@
 
 #include <atomic>
 #include <memory>
+#include <string>
 
 #include <QAbstractListModel>
 #include <QFuture>
@@ -59,8 +60,13 @@ public:
     public:
         virtual ~RowData() {}
         virtual size_t size() const = 0;
+        // A Filter cursor that continues after the last row.
+        virtual std::string cursorAfter() const = 0;
     };
-    virtual std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset) const = 0;
+    virtual std::unique_ptr<RowData> retrieveRows(std::shared_ptr<mediascanner::MediaStoreBase> store, int limit, int offset, const std::string &cursor) const = 0;
+    // Totals over all the rows, read along with the first batch.
+    // The default implementation reads nothing and returns zeros.
+    virtual mediascanner::Aggregate retrieveTotals(std::shared_ptr<mediascanner::MediaStoreBase> store) const;
     virtual void appendRows(std::unique_ptr<RowData> &&row_data) = 0;
     virtual void clearBacking() = 0;
 
@@ -71,6 +77,8 @@ protected:
     ModelStatus getStatus() const;
     void setStatus(ModelStatus status);
 
+    const mediascanner::Aggregate &getTotals() const;
+
 private:
     void updateModel();
     void setWorkerStop(bool new_stop_status) noexcept { stopflag.store(new_stop_status, std::memory_order_release); }
@@ -80,9 +88,11 @@ private:
     int generation;
     std::atomic<bool> stopflag;
     ModelStatus status;
+    mediascanner::Aggregate totals;
 
 Q_SIGNALS:
     void countChanged();
+    void totalsChanged();
     void statusChanged();
     // This next signal is here for backwards compatibility
     void filled();
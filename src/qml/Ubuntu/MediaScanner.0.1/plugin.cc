@@ -23,6 +23,7 @@
 #include "AlbumsModel.hh"
 #include "ArtistsModel.hh"
 #include "GenresModel.hh"
+#include "MediaModel.hh"
 #include "SongsModel.hh"
 #include "SongsSearchModel.hh"
 
@@ -35,6 +36,7 @@ void MediaScannerPlugin::registerTypes(const char *uri) {
     qmlRegisterType<AlbumsModel>(uri, 0, 1, "AlbumsModel");
     qmlRegisterType<ArtistsModel>(uri, 0, 1, "ArtistsModel");
     qmlRegisterType<GenresModel>(uri, 0, 1, "GenresModel");
+    qmlRegisterType<MediaModel>(uri, 0, 1, "MediaModel");
     qmlRegisterType<SongsModel>(uri, 0, 1, "SongsModel");
     qmlRegisterType<SongsSearchModel>(uri, 0, 1, "SongsSearchModel");
 }
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of version 3 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmarks for MediaStore.  Not run as part of the test
+ * suite; invoke manually:
+ *
+ *   ./bench_mediastore [rows]
+ */
+
+#include <mediascanner/Album.hh>
+#include <mediascanner/Filter.hh>
+#include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBuilder.hh>
+#include <mediascanner/MediaStore.hh>
+#include <mediascanner/internal/sqliteutils.hh>
+#include <mediascanner/mozilla/fts3_tokenizer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "test_config.h"
+
+extern "C" void sqlite3Fts3PorterTokenizerModule(
+    sqlite3_tokenizer_module const**ppModule);
+
+using namespace std;
+using namespace mediascanner;
+
+namespace {
+
+const char *const DB_FILE = TEST_DIR "/bench-mediastore.db";
+const char *const SNAPSHOT_FILE = TEST_DIR "/bench-mediastore.db-snapshot";
+const char *const FTS4_FILE = TEST_DIR "/bench-fts4.db";
+const char *const FTS5_FILE = TEST_DIR "/bench-fts5.db";
+
+string song_name(int i) {
+    return "/home/user/Music/Artist " + to_string(i % 500) +
+        "/Album " + to_string(i % 5000) + "/track" + to_string(i) + ".ogg";
+}
+
+MediaFile make_song(int i) {
+    return MediaFileBuilder(song_name(i))
+        .setType(AudioMedia)
+        .setContentType("audio/ogg")
+        .setETag("etag" + to_string(i))
+        .setTitle("Track " + to_string(i))
+        .setAuthor("Artist " + to_string(i % 500))
+        .setAlbum("Album " + to_string(i % 5000))
+        .setAlbumArtist("Artist " + to_string(i % 500))
+        .setGenre("Genre " + to_string(i % 20))
+        .setDate("2016-01-01")
+        .setTrackNumber(i % 12)
+        .setDuration(180);
+}
+
+// Runs func count times and prints the mean latency per call.
+void report(const char *name, int count, const function<void(int)> &func) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        func(i);
+    }
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - start).count();
+    printf("%-40s %10.2f us/call\n", name, elapsed / 1000.0 / count);
+}
+
+void bench_insert(MediaStore &store, int rows) {
+    MediaStoreTransaction txn = store.beginTransaction();
+    report("insert (cached statement)", rows, [&](int i) {
+            store.insert(make_song(i));
+        });
+    txn.commit();
+
+    const int batch_size = 100;
+    vector<MediaFile> batch;
+    report("insertBatch (per file)", rows, [&](int i) {
+            batch.push_back(make_song(rows + i));
+            if (batch.size() == batch_size) {
+                store.insertBatch(batch);
+                batch.clear();
+            }
+        });
+    store.insertBatch(batch);
+}
+
+void bench_getetag(MediaStore &store, int rows) {
+    const int calls = 100000;
+    report("getETag (cached statement)", calls, [&](int i) {
+            store.getETag(song_name((i * 7919) % rows));
+        });
+
+    // Reproduce the old prepare-per-call behaviour on a separate
+    // connection for comparison.
+    sqlite3 *db;
+    if (sqlite3_open_v2(DB_FILE, &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        throw runtime_error(sqlite3_errmsg(db));
+    }
+    const char *sql = "SELECT etag FROM media WHERE filename = ?";
+    report("getETag (prepare per call)", calls, [&](int i) {
+            Statement query(db, sql);
+            query.bind(1, song_name((i * 7919) % rows));
+            query.step();
+        });
+    StatementCache cache(db);
+    report("getETag (StatementCache)", calls, [&](int i) {
+            Statement query(cache, sql);
+            query.bind(1, song_name((i * 7919) % rows));
+            query.step();
+        });
+    cache.clear();
+    sqlite3_close(db);
+}
+
+void bench_lists(MediaStore &store) {
+    const int calls = 20;
+    Filter filter;
+    report("listAlbums (summary table)", calls, [&](int) {
+            store.listAlbums(filter);
+        });
+    report("listArtists (summary table)", calls, [&](int) {
+            store.listArtists(filter);
+        });
+    report("listGenres (summary table)", calls, [&](int) {
+            store.listGenres(filter);
+        });
+
+    // The equivalent GROUP BY queries over the media table, as used
+    // before the summary tables were added.
+    sqlite3 *db;
+    if (sqlite3_open_v2(DB_FILE, &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        throw runtime_error(sqlite3_errmsg(db));
+    }
+    const struct {
+        const char *name;
+        const char *sql;
+    } queries[] = {
+        {"listAlbums (GROUP BY media)", "SELECT album, album_artist, min(date), min(genre), min(filename), min(has_thumbnail), count(distinct album_artist) FROM media WHERE type = 1 GROUP BY album ORDER BY album"},
+        {"listArtists (GROUP BY media)", "SELECT artist FROM media WHERE type = 1 GROUP BY artist ORDER BY artist"},
+        {"listGenres (GROUP BY media)", "SELECT genre FROM media WHERE type = 1 GROUP BY genre ORDER BY genre"},
+    };
+    for (const auto &q : queries) {
+        report(q.name, calls, [&](int) {
+                Statement query(db, q.sql);
+                while (query.step()) {
+                }
+            });
+    }
+    sqlite3_close(db);
+}
+
+// The FTS4 rank() function used before the move to FTS5, scoring
+// each column hit by its share of the hits across the table.
+void fts4_rank(sqlite3_context *ctx, int nargs, sqlite3_value **args) {
+    const int32_t *info = static_cast<const int32_t*>(sqlite3_value_blob(args[0]));
+    const int32_t num_phrases = info[0];
+    const int32_t num_columns = info[1];
+    double score = 0.0;
+    for (int32_t phrase = 0; phrase < num_phrases; phrase++) {
+        const int32_t *phrase_info = &info[2 + phrase * num_columns * 3];
+        for (int32_t col = 0; col < num_columns && col + 1 < nargs; col++) {
+            if (phrase_info[3 * col] > 0) {
+                score += (double)phrase_info[3 * col] / phrase_info[3 * col + 1] *
+                    sqlite3_value_double(args[col + 1]);
+            }
+        }
+    }
+    sqlite3_result_double(ctx, score);
+}
+
+// Size in bytes of the full text index tables of a database.
+string fts_index_size(sqlite3 *db) {
+    try {
+        Statement query(db, "SELECT sum(pgsize) FROM dbstat WHERE name LIKE 'media_fts%'");
+        query.step();
+        return to_string(query.getInt64(0) / 1024) + " KiB";
+    } catch (const std::exception &e) {
+        return "unknown (no dbstat)";
+    }
+}
+
+void bench_search(MediaStore &store) {
+    // As typed into a search box, a character at a time.
+    const vector<string> terms = {"t", "tr", "tra", "track 1", "track 12", "artist 4", "alb"};
+    Filter filter;
+    filter.setLimit(50);
+    for (const auto &term : terms) {
+        report(("query \"" + term + "\"").c_str(), 10, [&](int) {
+                store.query(term, AudioMedia, filter);
+            });
+    }
+}
+
+// Compare against the FTS4 table used before, on a smaller library
+// since ranking all FTS4 matches takes seconds at larger sizes.
+void bench_fts4(int rows) {
+    const vector<string> terms = {"t", "tra", "track 12", "artist 4"};
+    const int calls = 3;
+    unlink(FTS5_FILE);
+    unlink(FTS4_FILE);
+    MediaStore store(FTS5_FILE, MS_READ_WRITE);
+    vector<MediaFile> batch;
+    for (int i = 0; i < rows; i++) {
+        batch.push_back(make_song(i));
+    }
+    store.insertBatch(batch);
+
+    // Copy the media into an FTS4 table as it was indexed before.
+    sqlite3 *db;
+    if (sqlite3_open(FTS4_FILE, &db) != SQLITE_OK) {
+        throw runtime_error(sqlite3_errmsg(db));
+    }
+    sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 1, nullptr);
+    {
+        const sqlite3_tokenizer_module *module = nullptr;
+        sqlite3Fts3PorterTokenizerModule(&module);
+        Statement query(db, "SELECT fts3_tokenizer('mozporter', ?)");
+        query.bind(1, &module, sizeof(module));
+        query.step();
+    }
+    sqlite3_create_function(db, "rank", -1, SQLITE_ANY, nullptr, fts4_rank, nullptr, nullptr);
+    {
+        Statement attach(db, "ATTACH ? AS src");
+        attach.bind(1, FTS5_FILE);
+        attach.step();
+    }
+    const char *copy = R"(
+CREATE TABLE media AS SELECT * FROM src.media;
+DETACH src;
+CREATE VIRTUAL TABLE media_fts USING fts4(content='media', title, artist, album, tokenize=mozporter);
+INSERT INTO media_fts(docid, title, artist, album) SELECT id, title, artist, album FROM media;
+)";
+    char *errmsg = nullptr;
+    if (sqlite3_exec(db, copy, nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        throw runtime_error(errmsg);
+    }
+
+    printf("Comparing with FTS4 at %d rows\n", rows);
+    Filter filter;
+    filter.setLimit(50);
+    const char *fts4_query = R"(
+SELECT filename, title FROM media
+  JOIN (SELECT docid, rank(matchinfo(media_fts), 1.0, 0.5, 0.75) AS rank
+    FROM media_fts WHERE media_fts MATCH ?) AS ranktable ON (media.id = ranktable.docid)
+  WHERE type = 1 ORDER BY ranktable.rank DESC LIMIT 50
+)";
+    for (const auto &term : terms) {
+        report(("query \"" + term + "\" (FTS4)").c_str(), calls, [&](int) {
+                Statement query(db, fts4_query);
+                query.bind(1, term + "*");
+                while (query.step()) {
+                }
+            });
+        report(("query \"" + term + "\" (FTS5)").c_str(), calls, [&](int) {
+                store.query(term, AudioMedia, filter);
+            });
+    }
+    printf("%-40s %20s\n", "index size (FTS4)", fts_index_size(db).c_str());
+    sqlite3_close(db);
+
+    if (sqlite3_open_v2(FTS5_FILE, &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        throw runtime_error(sqlite3_errmsg(db));
+    }
+    printf("%-40s %20s\n", "index size (FTS5)", fts_index_size(db).c_str());
+    sqlite3_close(db);
+    unlink(FTS4_FILE);
+    unlink(FTS5_FILE);
+    unlink((string(FTS5_FILE) + "-snapshot").c_str());
+}
+
+}
+
+int main(int argc, char **argv) {
+    int rows = 100000;
+    if (argc > 1) {
+        rows = atoi(argv[1]);
+    }
+    unlink(DB_FILE);
+    {
+        MediaStore store(DB_FILE, MS_READ_WRITE);
+        printf("Populating %d rows\n", rows);
+        bench_insert(store, rows);
+        bench_getetag(store, rows);
+        bench_lists(store);
+        bench_search(store);
+    }
+    bench_fts4(5000);
+    unlink(DB_FILE);
+    unlink(SNAPSHOT_FILE);
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of version 3 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Memory benchmark for MediaFile results, as held by the QML models
+ * and the D-Bus service.  Not run as part of the test suite; invoke
+ * manually:
+ *
+ *   ./bench_memory [songs]
+ */
+
+#include <mediascanner/Filter.hh>
+#include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBatch.hh>
+#include <mediascanner/MediaFileBuilder.hh>
+#include <mediascanner/MediaStore.hh>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "test_config.h"
+
+using namespace std;
+using namespace mediascanner;
+
+namespace {
+
+const char *const DB_FILE = TEST_DIR "/bench-memory.db";
+const char *const SNAPSHOT_FILE = TEST_DIR "/bench-memory.db-snapshot";
+
+// A library of 1000 artists with 10 albums each.  Names are long
+// enough not to fit in std::string's inline buffer.
+MediaFile make_song(int i) {
+    const string artist = "The Artist Formerly Known As " + to_string(i % 1000);
+    const string album = "Greatest Hits Volume " + to_string(i % 10000);
+    return MediaFileBuilder("/home/user/Music/" + artist + "/" + album +
+                            "/track" + to_string(i) + ".mp3")
+        .setType(AudioMedia)
+        .setContentType("audio/mpeg")
+        .setETag("etag" + to_string(i))
+        .setTitle("Track number " + to_string(i))
+        .setAuthor(artist)
+        .setAlbum(album)
+        .setAlbumArtist(artist)
+        .setGenre("Progressive Rock " + to_string(i % 20))
+        .setDate("2016-01-01")
+        .setTrackNumber(i % 12)
+        .setDuration(180);
+}
+
+// What each result used to hold: a copy of every string.
+struct UninternedFile {
+    string filename, content_type, etag, title, date;
+    string author, album, album_artist, genre;
+    int disc_number, track_number, duration, width, height;
+    double latitude, longitude;
+    bool has_thumbnail;
+    uint64_t modification_time;
+    MediaType type;
+};
+
+// Heap memory in use.  Unlike RSS, this goes down when memory is
+// freed, so the results can be measured one after the other.
+long heap_bytes() {
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    // Large blocks are mapped separately from the arena.
+    return long(info.uordblks) + long(info.hblkhd);
+}
+
+void report(const char *name, long bytes, size_t count) {
+    printf("%-40s %10.1f MiB %8.0f bytes/file\n", name,
+           bytes / 1048576.0, double(bytes) / count);
+}
+
+}
+
+int main(int argc, char **argv) {
+    int songs = 50000;
+    if (argc > 1) {
+        songs = atoi(argv[1]);
+    }
+    unlink(DB_FILE);
+    {
+        MediaStore store(DB_FILE, MS_READ_WRITE);
+        printf("Populating %d songs\n", songs);
+        MediaStoreTransaction txn = store.beginTransaction();
+        for (int i = 0; i < songs; i++) {
+            store.insert(make_song(i));
+        }
+        txn.commit();
+    }
+    {
+        MediaStore store(DB_FILE, MS_READ_ONLY);
+        Filter filter;
+        filter.setLimit(-1);
+        long before = heap_bytes();
+        vector<MediaFile> result = store.listSongs(filter);
+        // This includes SQLite's page cache.
+        report("listSongs result", heap_bytes() - before, result.size());
+
+        // Copies of the result, as the models and the D-Bus codec
+        // make, only add the per-file data.
+        before = heap_bytes();
+        vector<MediaFile> files(result);
+        report("MediaFile copies", heap_bytes() - before, files.size());
+
+        before = heap_bytes();
+        MediaFileBatch batch = store.listSongsBatch(filter);
+        report("MediaFileBatch", heap_bytes() - before, batch.size());
+
+        // Streaming holds one row at a time.
+        before = heap_bytes();
+        long peak = 0;
+        size_t count = 0;
+        store.forEachSong(filter, [&](const MediaFile &) {
+                peak = max(peak, heap_bytes() - before);
+                count++;
+                return true;
+            });
+        report("forEachSong peak", peak, count);
+
+        before = heap_bytes();
+        vector<UninternedFile> copies;
+        copies.reserve(result.size());
+        for (const auto &file : result) {
+            copies.push_back(UninternedFile{
+                    file.getFileName(), file.getContentType(),
+                    file.getETag(), file.getTitle(), file.getDate(),
+                    file.getAuthor(), file.getAlbum(),
+                    file.getAlbumArtist(), file.getGenre(),
+                    file.getDiscNumber(), file.getTrackNumber(),
+                    file.getDuration(), file.getWidth(), file.getHeight(),
+                    file.getLatitude(), file.getLongitude(),
+                    file.getHasThumbnail(), file.getModificationTime(),
+                    file.getType()});
+        }
+        report("same data without interning", heap_bytes() - before, copies.size());
+    }
+    unlink(DB_FILE);
+    unlink(SNAPSHOT_FILE);
+    return 0;
+}
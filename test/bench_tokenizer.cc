@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of version 3 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmark for the mozporter tokenizer on its own, comparing
+ * the ASCII fast path with the general Unicode path over a synthetic
+ * corpus of titles.  Not run as part of the test suite; invoke
+ * manually:
+ *
+ *   ./bench_tokenizer [titles]
+ */
+
+#include <mediascanner/mozilla/fts3_tokenizer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C" void sqlite3Fts3PorterTokenizerModule(
+    sqlite3_tokenizer_module const**ppModule);
+
+using namespace std;
+
+namespace {
+
+const char *const WORDS[] = {
+    "the", "love", "song", "night", "Live", "at", "Wembley", "Remastered",
+    "Symphony", "No", "in", "Minor", "Part", "feat", "DJ", "Mix", "Radio",
+    "Edit", "Dancing", "Queen", "Highway", "to", "Hell", "Bohemian",
+    "Rhapsody", "Greatest", "Hits", "Vol", "Original", "Soundtrack",
+    "Extended", "Version", "Acoustic", "Demo", "Bonus", "Track", "Disc",
+};
+
+// Mostly ASCII, as our libraries are, with some accented Latin,
+// Cyrillic and CJK words so the general path is exercised too.
+const char *const OTHER_WORDS[] = {
+    "Café", "Motörhead", "Björk", "Sigur", "Rós", "Пикник", "東京事変",
+    "きゃりーぱみゅぱみゅ", "花火", "Beyoncé", "Déjà", "vu",
+};
+
+const char *const SEPARATORS[] = {
+    " ", " ", " ", " - ", " (", ") ", ", ", " / ", ": ", " & ", "'s ",
+};
+
+vector<string> make_corpus(int count) {
+    mt19937 rng(1234);
+    const int n_words = sizeof(WORDS) / sizeof(WORDS[0]);
+    const int n_other = sizeof(OTHER_WORDS) / sizeof(OTHER_WORDS[0]);
+    const int n_separators = sizeof(SEPARATORS) / sizeof(SEPARATORS[0]);
+    vector<string> corpus;
+    corpus.reserve(count);
+    for (int i = 0; i < count; i++) {
+        string title;
+        int length = 2 + rng() % 8;
+        for (int j = 0; j < length; j++) {
+            if (j > 0) {
+                title += SEPARATORS[rng() % n_separators];
+            }
+            if (rng() % 20 == 0) {
+                title += OTHER_WORDS[rng() % n_other];
+            } else if (rng() % 10 == 0) {
+                title += to_string(rng() % 2000);
+            } else {
+                title += WORDS[rng() % n_words];
+            }
+        }
+        corpus.push_back(move(title));
+    }
+    return corpus;
+}
+
+class Tokenizer final {
+public:
+    Tokenizer(bool fast_path) {
+        sqlite3Fts3PorterTokenizerModule(&module);
+        const char *args[] = {"no_ascii_fastpath"};
+        if (module->xCreate(fast_path ? 0 : 1, args, &tokenizer) != SQLITE_OK) {
+            throw runtime_error("Could not create mozporter tokenizer");
+        }
+        tokenizer->pModule = module;
+    }
+    ~Tokenizer() {
+        module->xDestroy(tokenizer);
+    }
+    Tokenizer(const Tokenizer &other) = delete;
+    Tokenizer& operator=(const Tokenizer &other) = delete;
+
+    // Returns the number of tokens, appending them to out if given.
+    int tokenize(const string &input, string *out) const {
+        sqlite3_tokenizer_cursor *cursor;
+        if (module->xOpen(tokenizer, input.data(), input.size(), &cursor) != SQLITE_OK) {
+            throw runtime_error("Could not open tokenizer cursor");
+        }
+        cursor->pTokenizer = tokenizer;
+        const char *token;
+        int length, start, end, position, count = 0;
+        while (module->xNext(cursor, &token, &length, &start, &end, &position) == SQLITE_OK) {
+            if (out) {
+                out->append(token, length);
+                *out += '|' + to_string(start) + '|' + to_string(end) + ' ';
+            }
+            count++;
+        }
+        module->xClose(cursor);
+        return count;
+    }
+
+private:
+    const sqlite3_tokenizer_module *module = nullptr;
+    sqlite3_tokenizer *tokenizer = nullptr;
+};
+
+void bench(const char *name, const Tokenizer &tokenizer,
+           const vector<string> &corpus, size_t bytes) {
+    const int rounds = 10;
+    long tokens = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        for (const auto &title : corpus) {
+            tokens += tokenizer.tokenize(title, nullptr);
+        }
+    }
+    double elapsed = chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - start).count() / 1e9;
+    printf("%-30s %8.1f ns/title %8.1f MB/s %8.1f Mtokens/s\n", name,
+           elapsed * 1e9 / (rounds * corpus.size()),
+           rounds * bytes / elapsed / 1e6, tokens / elapsed / 1e6);
+}
+
+}
+
+int main(int argc, char **argv) {
+    int titles = 200000;
+    if (argc > 1) {
+        titles = atoi(argv[1]);
+    }
+    vector<string> corpus = make_corpus(titles);
+    size_t bytes = 0;
+    for (const auto &title : corpus) {
+        bytes += title.size();
+    }
+    printf("Tokenizing %d titles (%zu bytes)\n", titles, bytes);
+
+    Tokenizer fast(true), general(false);
+    // Both paths must produce exactly the same tokens.
+    for (const auto &title : corpus) {
+        string a, b;
+        fast.tokenize(title, &a);
+        general.tokenize(title, &b);
+        if (a != b) {
+            fprintf(stderr, "Token mismatch for \"%s\":\n  %s\n  %s\n",
+                    title.c_str(), a.c_str(), b.c_str());
+            return 1;
+        }
+    }
+    bench("general path", general, corpus, bytes);
+    bench("ASCII fast path", fast, corpus, bytes);
+    return 0;
+}
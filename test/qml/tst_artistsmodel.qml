@@ -46,6 +46,16 @@ Item {
             compare(model.get(1, ArtistsModel.RoleArtist), "The John Butler Trio");
         }
 
+        function test_counts() {
+            waitForReady();
+            compare(model.get(0, ArtistsModel.RoleTrackCount), 3);
+            compare(model.get(0, ArtistsModel.RoleAlbumCount), 2);
+            compare(model.get(0, ArtistsModel.RoleDuration), 559);
+            compare(model.get(1, ArtistsModel.RoleTrackCount), 4);
+            compare(model.get(1, ArtistsModel.RoleAlbumCount), 2);
+            compare(model.get(1, ArtistsModel.RoleDuration), 1134);
+        }
+
         function test_limit() {
             // The limit property is deprecated now, but we need to
             // keep it until music-app stops using it.
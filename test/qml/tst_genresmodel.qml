@@ -40,6 +40,16 @@ Item {
             compare(model.get(1, ArtistsModel.RoleGenre), "roots");
         }
 
+        function test_counts() {
+            waitForReady();
+            compare(model.get(0, GenresModel.RoleTrackCount), 3);
+            compare(model.get(0, GenresModel.RoleAlbumCount), 2);
+            compare(model.get(0, GenresModel.RoleDuration), 559);
+            compare(model.get(1, GenresModel.RoleTrackCount), 4);
+            compare(model.get(1, GenresModel.RoleAlbumCount), 2);
+            compare(model.get(1, GenresModel.RoleDuration), 1134);
+        }
+
         function test_limit() {
             // The limit property is deprecated now, but we need to
             // keep it until music-app stops using it.
@@ -0,0 +1,62 @@
+import QtQuick 2.0
+import QtTest 1.0
+import Ubuntu.MediaScanner 0.1
+
+Item {
+    id: root
+
+    MediaStore {
+        id: store
+    }
+
+    MediaModel {
+        id: model
+        store: store
+    }
+
+    SignalSpy {
+        id: modelStatus
+        target: model
+        signalName: "statusChanged"
+    }
+
+    TestCase {
+        name: "MediaModelTests"
+
+        function waitForReady() {
+            while (model.status == MediaModel.Loading) {
+                modelStatus.wait();
+            }
+            compare(model.status, MediaModel.Ready);
+        }
+
+        function cleanup() {
+            model.mediaType = MediaStore.ImageMedia;
+            model.order = MediaModel.Default;
+            model.reverse = false;
+        }
+
+        function test_media_type() {
+            // By default, the model lists images, of which there are none.
+            waitForReady();
+            compare(model.count, 0, "model.count == 0");
+
+            model.mediaType = MediaStore.AudioMedia;
+            waitForReady();
+            compare(model.count, 7, "model.count == 7");
+            compare(model.totalCount, 7);
+            compare(model.get(0, MediaModel.RoleTitle), "Buy Me a Pony");
+            compare(model.get(6, MediaModel.RoleTitle), "Zebra");
+        }
+
+        function test_order() {
+            model.mediaType = MediaStore.AudioMedia;
+            model.order = MediaModel.Date;
+            model.reverse = true;
+            waitForReady();
+            compare(model.count, 7, "model.count == 7");
+            compare(model.get(0, MediaModel.RoleTitle), "It's Beautiful");
+            compare(model.get(6, MediaModel.RoleTitle), "Buy Me a Pony");
+        }
+    }
+}
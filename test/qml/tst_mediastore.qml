@@ -42,6 +42,17 @@ Item {
             checkAttr("art", "image://albumart/artist=Spiderbait&album=Spiderbait");
         }
 
+        function test_lookupMany() {
+            var songs = store.lookupMany(["/path/foo3.ogg", "/unknown.ogg", "/path/foo1.ogg"]);
+            compare(songs.length, 3, "songs.length == 3");
+            compare(songs[0].title, "Buy Me a Pony");
+            compare(songs[1], null, "songs[1] == null");
+            compare(songs[2].title, "Straight Through The Sun");
+
+            songs = store.lookupMany([]);
+            compare(songs.length, 0, "songs.length == 0");
+        }
+
         function test_query() {
             var songs = store.query("unknown", MediaStore.AudioMedia);
             compare(songs.length, 0, "songs.length == 0");
@@ -56,6 +56,21 @@ Item {
             compare(model.get(6, SongsModel.RoleTitle), "Zebra");
         }
 
+        function test_totals() {
+            waitForReady();
+            compare(model.totalCount, 7);
+            compare(model.totalDuration, 1693);
+            compare(model.albumCount, 4);
+            compare(model.artistCount, 2);
+
+            model.artist = "The John Butler Trio";
+            waitForReady();
+            compare(model.totalCount, 4);
+            compare(model.totalDuration, 1134);
+            compare(model.albumCount, 2);
+            compare(model.artistCount, 1);
+        }
+
         function test_limit() {
             // The limit property is deprecated now, but we need to
             // keep it until music-app stops using it.
@@ -4,9 +4,13 @@
 #include <core/dbus/types/object_path.h>
 
 #include <mediascanner/Album.hh>
+#include <mediascanner/MediaChange.hh>
 #include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBatch.hh>
 #include <mediascanner/MediaFileBuilder.hh>
+#include <mediascanner/MediaStoreBase.hh>
 #include <mediascanner/Filter.hh>
+#include <mediascanner/Folder.hh>
 #include <ms-dbus/dbus-codec.hh>
 
 class MediaStoreDBusTests : public ::testing::Test {
@@ -52,6 +56,95 @@ TEST_F(MediaStoreDBusTests, mediafile_codec) {
     EXPECT_EQ(media, media2);
 }
 
+TEST_F(MediaStoreDBusTests, mediafilebatch_codec) {
+    std::vector<mediascanner::MediaFile> files {
+        mediascanner::MediaFileBuilder("/music/a.ogg")
+            .setContentType("audio/ogg")
+            .setETag("etag")
+            .setDate("1900")
+            .setTitle("b")
+            .setAuthor("c")
+            .setAlbum("d")
+            .setAlbumArtist("e")
+            .setGenre("f")
+            .setDiscNumber(1)
+            .setTrackNumber(2)
+            .setDuration(5)
+            .setHasThumbnail(true)
+            .setModificationTime(4200)
+            .setType(mediascanner::AudioMedia),
+        mediascanner::MediaFileBuilder("/pictures/b.jpg")
+            .setWidth(640)
+            .setHeight(480)
+            .setLatitude(20.42)
+            .setLongitude(-30.67)
+            .setType(mediascanner::ImageMedia),
+    };
+    mediascanner::MediaFileBatch batch(files);
+    message->writer() << batch;
+
+    EXPECT_EQ("a(sssssssssiiiiiddbti)", message->signature());
+    EXPECT_EQ(core::dbus::helper::TypeMapper<mediascanner::MediaFileBatch>::signature(), message->signature());
+
+    mediascanner::MediaFileBatch batch2;
+    message->reader() >> batch2;
+    EXPECT_EQ(batch, batch2);
+
+    // The wire format is the same as a list of MediaFile.
+    std::vector<mediascanner::MediaFile> files2;
+    message->reader() >> files2;
+    EXPECT_EQ(files, files2);
+}
+
+TEST_F(MediaStoreDBusTests, mediachange_codec) {
+    mediascanner::MediaChange change(42, mediascanner::ChangeKind::Delete,
+                                     "/music/a.ogg", mediascanner::AudioMedia);
+    message->writer() << change;
+
+    EXPECT_EQ("(xisi)", message->signature());
+    EXPECT_EQ(core::dbus::helper::TypeMapper<mediascanner::MediaChange>::signature(), message->signature());
+
+    mediascanner::MediaChange change2;
+    message->reader() >> change2;
+    EXPECT_EQ(change, change2);
+}
+
+TEST_F(MediaStoreDBusTests, timelineentry_codec) {
+    mediascanner::TimelineEntry entry(1356998400, 42);
+    message->writer() << entry;
+
+    EXPECT_EQ("(xi)", message->signature());
+    EXPECT_EQ(core::dbus::helper::TypeMapper<mediascanner::TimelineEntry>::signature(), message->signature());
+
+    mediascanner::TimelineEntry entry2;
+    message->reader() >> entry2;
+    EXPECT_EQ(entry, entry2);
+}
+
+TEST_F(MediaStoreDBusTests, aggregate_codec) {
+    mediascanner::Aggregate aggregate(1234, 5000000000, 56, 78);
+    message->writer() << aggregate;
+
+    EXPECT_EQ("(xxxx)", message->signature());
+    EXPECT_EQ(core::dbus::helper::TypeMapper<mediascanner::Aggregate>::signature(), message->signature());
+
+    mediascanner::Aggregate aggregate2;
+    message->reader() >> aggregate2;
+    EXPECT_EQ(aggregate, aggregate2);
+}
+
+TEST_F(MediaStoreDBusTests, facet_codec) {
+    mediascanner::Facet facet("rock", 312, 25, 72000);
+    message->writer() << facet;
+
+    EXPECT_EQ("(sxxx)", message->signature());
+    EXPECT_EQ(core::dbus::helper::TypeMapper<mediascanner::Facet>::signature(), message->signature());
+
+    mediascanner::Facet facet2;
+    message->reader() >> facet2;
+    EXPECT_EQ(facet, facet2);
+}
+
 TEST_F(MediaStoreDBusTests, album_codec) {
     mediascanner::Album album("title", "artist", "date", "genre", "art_file", true, 1);
     message->writer() << album;
@@ -70,6 +163,23 @@ TEST_F(MediaStoreDBusTests, album_codec) {
     EXPECT_EQ(album, album2);
 }
 
+TEST_F(MediaStoreDBusTests, folder_codec) {
+    mediascanner::MediaFile media = mediascanner::MediaFileBuilder("/music/a.ogg")
+        .setType(mediascanner::AudioMedia);
+    mediascanner::Folder folder("/music", 3,
+                                {mediascanner::Folder("/music/one", 1),
+                                 mediascanner::Folder("/music/two", 1)},
+                                {media});
+    message->writer() << folder;
+
+    EXPECT_EQ("(sia(si)a(sssssssssiiiiiddbti))", message->signature());
+    EXPECT_EQ(core::dbus::helper::TypeMapper<mediascanner::Folder>::signature(), message->signature());
+
+    mediascanner::Folder folder2;
+    message->reader() >> folder2;
+    EXPECT_EQ(folder, folder2);
+}
+
 TEST_F(MediaStoreDBusTests, filter_codec) {
     mediascanner::Filter filter;
     filter.setArtist("Artist1");
@@ -78,6 +188,9 @@ TEST_F(MediaStoreDBusTests, filter_codec) {
     filter.setGenre("Genre");
     filter.setOffset(42);
     filter.setLimit(100);
+    filter.setCursorAfterName("Artist0");
+    filter.setDateRange(1356998400, 1388534400);
+    filter.setModifiedRange(-86400, 86400);
     message->writer() << filter;
 
     EXPECT_EQ("a{sv}", message->signature());
@@ -17,18 +17,35 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <mediascanner/MediaChange.hh>
 #include <mediascanner/MediaFile.hh>
+#include <mediascanner/MediaFileBatch.hh>
 #include <mediascanner/MediaFileBuilder.hh>
 #include <mediascanner/Album.hh>
 #include <mediascanner/Filter.hh>
+#include <mediascanner/Folder.hh>
 #include <mediascanner/MediaStore.hh>
+#include <mediascanner/internal/KnownFiles.hh>
 #include <mediascanner/internal/utils.hh>
+#include <mediascanner/mozilla/fts3_tokenizer.h>
 
 #include <algorithm>
+#include <set>
 #include <stdexcept>
 #include <cstdio>
+#include <cstdlib>
 #include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
+#include <sqlite3.h>
+
+#include "test_config.h"
+
+extern "C" void sqlite3Fts3PorterTokenizerModule(
+    sqlite3_tokenizer_module const**ppModule);
 
 using namespace std;
 using namespace mediascanner;
@@ -158,6 +175,65 @@ TEST_F(MediaStoreTest, lookup) {
     EXPECT_THROW(store.lookup("not found"), std::runtime_error);
 }
 
+TEST_F(MediaStoreTest, lookupMany) {
+    MediaFile one = MediaFileBuilder("/one.ogg")
+        .setTitle("One")
+        .setType(AudioMedia);
+    MediaFile two = MediaFileBuilder("/two.jpg")
+        .setWidth(640)
+        .setHeight(480)
+        .setType(ImageMedia);
+    MediaStore store(":memory:", MS_READ_WRITE);
+    store.insert(one);
+    store.insert(two);
+
+    // Results are in the order asked for, with duplicates repeated
+    // and misses left empty.
+    auto result = store.lookupMany({"/two.jpg", "/missing.ogg", "/one.ogg", "/two.jpg"});
+    ASSERT_EQ(4, result.size());
+    EXPECT_EQ(two, result[0]);
+    EXPECT_EQ("", result[1].getFileName());
+    EXPECT_EQ(MediaFile(), result[1]);
+    EXPECT_EQ(one, result[2]);
+    EXPECT_EQ(two, result[3]);
+
+    // Nothing is left over from the last call.
+    result = store.lookupMany({"/one.ogg"});
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(one, result[0]);
+    EXPECT_TRUE(store.lookupMany({}).empty());
+
+    // Read only stores can look up many files too.
+    const string dbname("lookupmany-mediastore.db");
+    const string snapshot = dbname + "-snapshot";
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+    {
+        MediaStore writer(dbname, MS_READ_WRITE);
+        vector<string> filenames;
+        {
+            MediaStoreTransaction txn = writer.beginTransaction();
+            for (int i = 0; i < 2000; i++) {
+                string filename = "/queue/track" + std::to_string(i) + ".ogg";
+                if (i % 2 == 0) {
+                    writer.insert(MediaFileBuilder(filename).setType(AudioMedia));
+                }
+                filenames.push_back(filename);
+            }
+            txn.commit();
+        }
+        writer.publishSnapshot();
+        MediaStore reader(dbname, MS_READ_ONLY);
+        result = reader.lookupMany(filenames);
+        ASSERT_EQ(2000, result.size());
+        for (int i = 0; i < 2000; i++) {
+            EXPECT_EQ(i % 2 == 0 ? filenames[i] : "", result[i].getFileName());
+        }
+    }
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+}
+
 TEST_F(MediaStoreTest, roundtrip) {
     MediaFile audio = MediaFileBuilder("/aaa")
         .setContentType("type")
@@ -350,6 +426,34 @@ TEST_F(MediaStoreTest, query_short) {
     EXPECT_EQ(result.size(), 1);
 }
 
+TEST_F(MediaStoreTest, query_syntax) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    store.insert(MediaFileBuilder("/path/one.ogg")
+                 .setType(AudioMedia)
+                 .setTitle("Highway to Hell")
+                 .setAuthor("AC/DC"));
+    store.insert(MediaFileBuilder("/path/two.ogg")
+                 .setType(AudioMedia)
+                 .setTitle("Don't \"Stop\" Me Now")
+                 .setAuthor("Queen"));
+    store.insert(MediaFileBuilder("/path/three.ogg")
+                 .setType(AudioMedia)
+                 .setTitle("\xe6\x9d\xb1\xe4\xba\xac\xe9\x83\xbd")  // Tokyo
+                 .setAuthor("Artist"));
+
+    // Characters that are FTS5 query syntax are searched for as text.
+    Filter filter;
+    EXPECT_EQ(1, store.query("to/hell", AudioMedia, filter).size());
+    EXPECT_EQ(1, store.query("highway hel", AudioMedia, filter).size());
+    EXPECT_EQ(0, store.query("highway queen", AudioMedia, filter).size());
+    EXPECT_EQ(1, store.query("\"stop\"", AudioMedia, filter).size());
+    EXPECT_EQ(1, store.query("don't stop", AudioMedia, filter).size());
+    EXPECT_EQ(1, store.query("(stop) queen", AudioMedia, filter).size());
+    EXPECT_EQ(1, store.query("\xe4\xba\xac\xe9\x83\xbd", AudioMedia, filter).size());
+    EXPECT_EQ(0, store.query("*:(", AudioMedia, filter).size());
+    EXPECT_EQ(1, store.queryArtists("que", filter).size());
+}
+
 TEST_F(MediaStoreTest, query_empty) {
     MediaFile audio1 = MediaFileBuilder("/path/foo5.ogg")
         .setType(AudioMedia)
@@ -541,6 +645,30 @@ TEST_F(MediaStoreTest, utils) {
     string unquoted(R"(It's a living.)");
     string quoted(R"('It''s a living.')");
     EXPECT_EQ(sqlQuote(unquoted), quoted);
+
+    int64_t seconds;
+    EXPECT_TRUE(parse_date("2013", seconds));
+    EXPECT_EQ(1356998400, seconds);
+    EXPECT_TRUE(parse_date("2013-06", seconds));
+    EXPECT_EQ(1370044800, seconds);
+    EXPECT_TRUE(parse_date("2013-06-15", seconds));
+    EXPECT_EQ(1371254400, seconds);
+    EXPECT_TRUE(parse_date("2013-06-15T10:20:30", seconds));
+    EXPECT_EQ(1371291630, seconds);
+    EXPECT_TRUE(parse_date("2013-06-15T10:20:30.5Z", seconds));
+    EXPECT_EQ(1371291630, seconds);
+    EXPECT_TRUE(parse_date("2013-06-15T10:20:30+0100", seconds));
+    EXPECT_EQ(1371288030, seconds);
+    EXPECT_TRUE(parse_date("2013-06-15 10:20-05:30", seconds));
+    EXPECT_EQ(1371311400, seconds);
+    EXPECT_TRUE(parse_date("1900-03-01", seconds));
+    EXPECT_EQ(-2203891200, seconds);
+    EXPECT_FALSE(parse_date("", seconds));
+    EXPECT_FALSE(parse_date("13", seconds));
+    EXPECT_FALSE(parse_date("2013-13", seconds));
+    EXPECT_FALSE(parse_date("2013:06:15 10:20:30", seconds));
+    EXPECT_FALSE(parse_date("2013-06-15T10", seconds));
+    EXPECT_FALSE(parse_date("2013-06-15T10:20+01:", seconds));
 }
 
 TEST_F(MediaStoreTest, queryAlbums) {
@@ -1244,6 +1372,144 @@ TEST_F(MediaStoreTest, listArtists) {
     EXPECT_EQ("Various Artists", artists[2]);
 }
 
+TEST_F(MediaStoreTest, summaries) {
+    MediaFile audio1 = MediaFileBuilder("/home/username/Music/track1.ogg")
+        .setType(AudioMedia)
+        .setTitle("TitleOne")
+        .setAuthor("ArtistOne")
+        .setAlbum("AlbumOne")
+        .setAlbumArtist("ArtistOne")
+        .setGenre("GenreOne")
+        .setDate("2001")
+        .setTrackNumber(2);
+    MediaFile audio2 = MediaFileBuilder("/home/username/Music/track2.ogg")
+        .setType(AudioMedia)
+        .setTitle("TitleTwo")
+        .setAuthor("ArtistTwo")
+        .setAlbum("AlbumOne")
+        .setAlbumArtist("ArtistOne")
+        .setGenre("GenreTwo")
+        .setDate("2002")
+        .setTrackNumber(1);
+
+    MediaStore store(":memory:", MS_READ_WRITE);
+    store.insert(audio1);
+    store.insert(audio2);
+
+    Filter filter;
+    vector<Album> albums = store.listAlbums(filter);
+    ASSERT_EQ(1, albums.size());
+    // Album details come from the first track
+    EXPECT_EQ("2002", albums[0].getDate());
+    EXPECT_EQ("GenreTwo", albums[0].getGenre());
+    EXPECT_EQ(vector<string>({"ArtistOne", "ArtistTwo"}), store.listArtists(filter));
+    EXPECT_EQ(vector<string>({"GenreOne", "GenreTwo"}), store.listGenres(filter));
+
+    // Replacing a track moves it between summaries
+    store.insert(MediaFileBuilder(audio2).setAlbum("AlbumTwo").setGenre("GenreOne"));
+    albums = store.listAlbums(filter);
+    ASSERT_EQ(2, albums.size());
+    EXPECT_EQ("2001", albums[0].getDate());
+    EXPECT_EQ("AlbumTwo", albums[1].getTitle());
+    EXPECT_EQ(vector<string>({"GenreOne"}), store.listGenres(filter));
+    filter.setGenre("GenreOne");
+    EXPECT_EQ(vector<string>({"ArtistOne", "ArtistTwo"}), store.listArtists(filter));
+    filter.clear();
+
+    store.remove(audio1.getFileName());
+    albums = store.listAlbums(filter);
+    ASSERT_EQ(1, albums.size());
+    EXPECT_EQ("AlbumTwo", albums[0].getTitle());
+    EXPECT_EQ(vector<string>({"ArtistTwo"}), store.listArtists(filter));
+    EXPECT_EQ(vector<string>({"ArtistOne"}), store.listAlbumArtists(filter));
+
+    store.archiveItems("/home/username");
+    EXPECT_EQ(0, store.listAlbums(filter).size());
+    EXPECT_EQ(0, store.listGenres(filter).size());
+    store.restoreItems("/home/username");
+    EXPECT_EQ(1, store.listAlbums(filter).size());
+    EXPECT_EQ(vector<string>({"GenreOne"}), store.listGenres(filter));
+}
+
+TEST_F(MediaStoreTest, cursor) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    for (int i = 0; i < 6; i++) {
+        store.insert(MediaFileBuilder("/home/username/Music/track" + std::to_string(i) + ".ogg")
+                     .setType(AudioMedia)
+                     .setTitle("Title" + std::to_string(i))
+                     .setAuthor("Artist" + std::to_string(i % 3))
+                     .setAlbum("Album" + std::to_string(i % 2))
+                     .setAlbumArtist("Artist")
+                     .setTrackNumber(i / 2));
+    }
+
+    Filter filter;
+    filter.setLimit(2);
+    vector<MediaFile> songs = store.listSongs(filter);
+    ASSERT_EQ(2, songs.size());
+    EXPECT_EQ("Title0", songs[0].getTitle());
+    EXPECT_EQ("Title2", songs[1].getTitle());
+
+    // Rows added before the cursor do not shift the next page.
+    store.insert(MediaFileBuilder("/home/username/Music/early.ogg")
+                 .setType(AudioMedia)
+                 .setTitle("Early")
+                 .setAlbum("Album0")
+                 .setAlbumArtist("Artist"));
+    filter.setCursorAfter(songs.back());
+    songs = store.listSongs(filter);
+    ASSERT_EQ(2, songs.size());
+    EXPECT_EQ("Title4", songs[0].getTitle());
+    EXPECT_EQ("Title1", songs[1].getTitle());
+
+    filter.setCursorAfter(songs.back());
+    songs = store.listSongs(filter);
+    ASSERT_EQ(2, songs.size());
+    EXPECT_EQ("Title3", songs[0].getTitle());
+    EXPECT_EQ("Title5", songs[1].getTitle());
+
+    filter.setCursorAfter(songs.back());
+    EXPECT_EQ(0, store.listSongs(filter).size());
+
+    // A cursor replaces the offset.
+    filter.setOffset(100);
+    filter.setCursorAfterName("Artist0");
+    vector<string> artists = store.listArtists(filter);
+    ASSERT_EQ(2, artists.size());
+    EXPECT_EQ("Artist1", artists[0]);
+    EXPECT_EQ("Artist2", artists[1]);
+    filter.setOffset(0);
+
+    Filter album_filter;
+    album_filter.setLimit(1);
+    vector<Album> albums = store.listAlbums(album_filter);
+    ASSERT_EQ(1, albums.size());
+    EXPECT_EQ("Album0", albums[0].getTitle());
+    album_filter.setCursorAfter(albums.back());
+    albums = store.listAlbums(album_filter);
+    ASSERT_EQ(1, albums.size());
+    EXPECT_EQ("Album1", albums[0].getTitle());
+
+    filter.unsetCursor();
+    filter.setOrder(MediaOrder::Title);
+    filter.setReverse(true);
+    songs = store.query("", AudioMedia, filter);
+    ASSERT_EQ(2, songs.size());
+    EXPECT_EQ("Title5", songs[0].getTitle());
+    EXPECT_EQ("Title4", songs[1].getTitle());
+    filter.setCursorAfter(songs.back());
+    songs = store.query("", AudioMedia, filter);
+    ASSERT_EQ(2, songs.size());
+    EXPECT_EQ("Title3", songs[0].getTitle());
+    EXPECT_EQ("Title2", songs[1].getTitle());
+
+    // Cursors only apply to the kind of row they were made from.
+    filter.setCursorAfterName("Artist0");
+    EXPECT_THROW(store.listSongs(filter), std::runtime_error);
+    filter.setCursor("garbage");
+    EXPECT_THROW(store.listGenres(filter), std::runtime_error);
+}
+
 TEST_F(MediaStoreTest, hasMedia) {
     MediaStore store(":memory:", MS_READ_WRITE);
     EXPECT_FALSE(store.hasMedia(AudioMedia));
@@ -1263,6 +1529,337 @@ TEST_F(MediaStoreTest, hasMedia) {
     EXPECT_TRUE(store.hasMedia(AllMedia));
 }
 
+static vector<string> filenames(const vector<MediaFile> &files) {
+    vector<string> names;
+    for (const auto &f : files) {
+        names.push_back(f.getFileName());
+    }
+    return names;
+}
+
+TEST_F(MediaStoreTest, location) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    auto image = [](const string &name, double latitude, double longitude) {
+        return MediaFileBuilder("/pictures/" + name).setType(ImageMedia)
+            .setTitle(name).setLatitude(latitude).setLongitude(longitude).build();
+    };
+    store.insert(image("london.jpg", 51.5074, -0.1278));
+    store.insert(image("paris.jpg", 48.8566, 2.3522));
+    store.insert(image("brussels.jpg", 50.8503, 4.3517));
+    store.insert(image("fiji.jpg", -17.7134, 178.0650));
+    store.insert(image("samoa.jpg", -13.7590, -172.1046));
+    store.insert(image("pole.jpg", 89.9, 10.0));
+    // No location.
+    store.insert(image("unknown.jpg", 0, 0));
+    store.insert(MediaFileBuilder("/videos/paris.mp4").setType(VideoMedia)
+                 .setLatitude(48.8584).setLongitude(2.2945));
+
+    Filter filter;
+    filter.setOrder(MediaOrder::Title);
+    EXPECT_EQ(vector<string>({"/pictures/brussels.jpg", "/pictures/london.jpg", "/pictures/paris.jpg"}),
+              filenames(store.queryBoundingBox(45, -5, 55, 10, ImageMedia, filter)));
+    EXPECT_EQ(vector<string>({"/pictures/brussels.jpg", "/pictures/london.jpg", "/videos/paris.mp4", "/pictures/paris.jpg"}),
+              filenames(store.queryBoundingBox(45, -5, 55, 10, AllMedia, filter)));
+    // Crossing the 180th meridian.
+    EXPECT_EQ(vector<string>({"/pictures/fiji.jpg", "/pictures/samoa.jpg"}),
+              filenames(store.queryBoundingBox(-20, 170, -10, -170, ImageMedia, filter)));
+    EXPECT_EQ(0, store.queryBoundingBox(-20, -170, -10, 170, ImageMedia, filter).size());
+    EXPECT_EQ(0, store.queryBoundingBox(-1, -1, 1, 1, ImageMedia, filter).size());
+    EXPECT_THROW(store.queryBoundingBox(55, -5, 45, 10, ImageMedia, filter), std::invalid_argument);
+    EXPECT_THROW(store.queryBoundingBox(45, -5, 95, 10, ImageMedia, filter), std::invalid_argument);
+
+    // Limit, offset and cursor.
+    filter.setLimit(2);
+    auto page = store.queryBoundingBox(45, -5, 55, 10, ImageMedia, filter);
+    EXPECT_EQ(vector<string>({"/pictures/brussels.jpg", "/pictures/london.jpg"}), filenames(page));
+    filter.setCursorAfter(page.back());
+    EXPECT_EQ(vector<string>({"/pictures/paris.jpg"}),
+              filenames(store.queryBoundingBox(45, -5, 55, 10, ImageMedia, filter)));
+
+    // Nearest first, however far away.
+    Filter nearest;
+    nearest.setLimit(3);
+    EXPECT_EQ(vector<string>({"/pictures/paris.jpg", "/pictures/brussels.jpg", "/pictures/london.jpg"}),
+              filenames(store.queryNearest(48.85, 2.35, ImageMedia, nearest)));
+    nearest.setOffset(1);
+    nearest.setLimit(1);
+    EXPECT_EQ(vector<string>({"/pictures/samoa.jpg"}),
+              filenames(store.queryNearest(-17.7, 179.9, ImageMedia, nearest)));
+    nearest.setOffset(0);
+    nearest.setLimit(-1);
+    EXPECT_EQ(6, store.queryNearest(-89, 0, ImageMedia, nearest).size());
+    EXPECT_EQ("/pictures/pole.jpg", store.queryNearest(89, -170, AllMedia, nearest)[0].getFileName());
+
+    // Moving and removing media updates the index.
+    store.insert(image("london.jpg", 0, 0));
+    store.remove("/pictures/paris.jpg");
+    filter.setLimit(-1);
+    filter.unsetCursor();
+    EXPECT_EQ(vector<string>({"/pictures/brussels.jpg"}),
+              filenames(store.queryBoundingBox(45, -5, 55, 10, ImageMedia, filter)));
+}
+
+TEST_F(MediaStoreTest, dates) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    auto image = [](const string &name, const string &date, time_t mtime) {
+        return MediaFileBuilder("/pictures/" + name).setType(ImageMedia)
+            .setDate(date).setModificationTime(mtime).build();
+    };
+    store.insert(image("a.jpg", "2012-12-31T23:59:59", 100));
+    store.insert(image("b.jpg", "2013-01-01T00:00:00", 200));
+    store.insert(image("c.jpg", "2013-01-01T13:00:00+02:00", 300));
+    store.insert(image("d.jpg", "2013-02", 400));
+    store.insert(image("e.jpg", "2014", 500));
+    store.insert(image("f.jpg", "", 600));
+    store.insert(image("g.jpg", "unknown", 700));
+    store.insert(MediaFileBuilder("/music/song.ogg").setType(AudioMedia).setDate("2013-01-01"));
+
+    EXPECT_EQ(vector<TimelineEntry>({{1356912000, 1}, {1356998400, 2}, {1359676800, 1}, {1388534400, 1}}),
+              store.timeline(ImageMedia, TimelineInterval::Day, Filter()));
+    EXPECT_EQ(vector<TimelineEntry>({{1354320000, 1}, {1356998400, 2}, {1359676800, 1}, {1388534400, 1}}),
+              store.timeline(ImageMedia, TimelineInterval::Month, Filter()));
+    EXPECT_EQ(vector<TimelineEntry>({{1325376000, 1}, {1356998400, 4}, {1388534400, 1}}),
+              store.timeline(AllMedia, TimelineInterval::Year, Filter()));
+
+    // Ranges are half open.
+    Filter filter;
+    filter.setDateRange(1356998400, 1388534400);
+    EXPECT_EQ(vector<TimelineEntry>({{1356998400, 3}}),
+              store.timeline(ImageMedia, TimelineInterval::Year, filter));
+    filter.setOrder(MediaOrder::Date);
+    EXPECT_EQ(vector<string>({"/pictures/b.jpg", "/pictures/c.jpg", "/pictures/d.jpg"}),
+              filenames(store.query("", ImageMedia, filter)));
+    filter.setModifiedRange(300, 500);
+    EXPECT_EQ(vector<string>({"/pictures/c.jpg", "/pictures/d.jpg"}),
+              filenames(store.query("", ImageMedia, filter)));
+    filter.unsetDateRange();
+    filter.unsetModifiedRange();
+
+    // Date order pages through undated media, which come first.
+    for (bool reverse : {false, true}) {
+        filter.setReverse(reverse);
+        filter.setLimit(-1);
+        filter.unsetCursor();
+        auto all = filenames(store.query("", ImageMedia, filter));
+        vector<string> expected({"/pictures/f.jpg", "/pictures/g.jpg", "/pictures/a.jpg",
+                    "/pictures/b.jpg", "/pictures/c.jpg", "/pictures/d.jpg", "/pictures/e.jpg"});
+        if (reverse) {
+            std::reverse(expected.begin(), expected.end());
+        }
+        EXPECT_EQ(expected, all);
+
+        vector<string> paged;
+        filter.setLimit(2);
+        while (true) {
+            auto page = store.query("", ImageMedia, filter);
+            if (page.empty()) {
+                break;
+            }
+            for (const auto &f : page) {
+                paged.push_back(f.getFileName());
+            }
+            filter.setCursorAfter(page.back());
+        }
+        EXPECT_EQ(expected, paged);
+    }
+}
+
+// The details of the plan SQLite picks for a query.
+static string query_plan(const string &dbname, const string &sql) {
+    sqlite3 *db = nullptr;
+    EXPECT_EQ(SQLITE_OK, sqlite3_open(dbname.c_str(), &db));
+    sqlite3_stmt *stmt = nullptr;
+    EXPECT_EQ(SQLITE_OK, sqlite3_prepare_v2(db, ("EXPLAIN QUERY PLAN " + sql).c_str(), -1, &stmt, nullptr));
+    string plan;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        plan += reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        plan += "\n";
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return plan;
+}
+
+TEST_F(MediaStoreTest, listMedia) {
+    const string dbname("list-mediastore.db");
+    unlink(dbname.c_str());
+    {
+        MediaStore store(dbname, MS_READ_WRITE);
+        store.insert(MediaFileBuilder("/pictures/a.jpg").setType(ImageMedia)
+                     .setTitle("Beach").setDate("2014-06-01").setModificationTime(300));
+        store.insert(MediaFileBuilder("/pictures/b.jpg").setType(ImageMedia)
+                     .setTitle("Airport").setDate("2015-01-10").setModificationTime(100));
+        store.insert(MediaFileBuilder("/pictures/c.jpg").setType(ImageMedia)
+                     .setTitle("Cat").setDate("2013-03-03").setModificationTime(200));
+        store.insert(MediaFileBuilder("/videos/d.mp4").setType(VideoMedia)
+                     .setTitle("Dog").setDate("2016"));
+
+        Filter filter;
+        // Title is the default order.
+        EXPECT_EQ(vector<string>({"/pictures/b.jpg", "/pictures/a.jpg", "/pictures/c.jpg"}),
+                  filenames(store.listMedia(ImageMedia, filter)));
+        filter.setOrder(MediaOrder::Rank);
+        EXPECT_EQ(vector<string>({"/pictures/b.jpg", "/pictures/a.jpg", "/pictures/c.jpg"}),
+                  filenames(store.listMedia(ImageMedia, filter)));
+        filter.setOrder(MediaOrder::Modified);
+        EXPECT_EQ(vector<string>({"/pictures/b.jpg", "/pictures/c.jpg", "/pictures/a.jpg"}),
+                  filenames(store.listMedia(ImageMedia, filter)));
+        EXPECT_EQ(vector<string>({"/videos/d.mp4"}),
+                  filenames(store.listMedia(VideoMedia, filter)));
+
+        // Newest first, a page at a time.
+        filter.setOrder(MediaOrder::Date);
+        filter.setReverse(true);
+        filter.setLimit(2);
+        auto page = store.listMedia(ImageMedia, filter);
+        EXPECT_EQ(vector<string>({"/pictures/b.jpg", "/pictures/a.jpg"}), filenames(page));
+        EXPECT_EQ(MediaFileBatch(page), store.listMediaBatch(ImageMedia, filter));
+        filter.setCursorAfter(page.back());
+        EXPECT_EQ(vector<string>({"/pictures/c.jpg"}),
+                  filenames(store.listMedia(ImageMedia, filter)));
+    }
+
+    // Each order walks an index rather than sorting.
+    const string select = "SELECT filename, title FROM media WHERE type = 2 ORDER BY ";
+    for (const string column : {"title", "date_epoch", "mtime"}) {
+        for (const string direction : {"", " DESC"}) {
+            string plan = query_plan(dbname, select + column + direction + ", filename" + direction + " LIMIT 50");
+            EXPECT_EQ(string::npos, plan.find("TEMP B-TREE")) << column << direction << ": " << plan;
+        }
+    }
+    unlink(dbname.c_str());
+}
+
+// The totals aggregate() should give, worked out from listSongs().
+static Aggregate aggregate_songs(const MediaStore &store, const Filter &filter) {
+    Aggregate result;
+    std::set<string> albums, artists;
+    for (const auto &song : store.listSongs(filter)) {
+        result.count++;
+        result.duration += song.getDuration();
+        albums.insert(song.getAlbum());
+        artists.insert(song.getAuthor());
+    }
+    result.albums = albums.size();
+    result.artists = artists.size();
+    return result;
+}
+
+TEST_F(MediaStoreTest, count) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    EXPECT_EQ(0, store.count(AudioMedia, Filter()));
+    EXPECT_EQ(Aggregate(), store.aggregate(Filter()));
+
+    auto song = [](const string &name, const string &artist, const string &album,
+                   const string &album_artist, const string &genre, int duration) {
+        return MediaFileBuilder("/music/" + name).setType(AudioMedia)
+            .setAuthor(artist).setAlbum(album).setAlbumArtist(album_artist)
+            .setGenre(genre).setDuration(duration).setDate("2010").build();
+    };
+    store.insert(song("a.ogg", "Artist1", "Album1", "Artist1", "rock", 100));
+    store.insert(song("b.ogg", "Artist1", "Album1", "Artist1", "pop", 200));
+    store.insert(song("c.ogg", "Artist2", "Album1", "Artist1", "rock", 300));
+    store.insert(song("d.ogg", "Artist2", "Album2", "Artist2", "rock", 400));
+    store.insert(song("e.ogg", "Artist3", "Album3", "Various", "jazz", 500));
+    store.insert(MediaFileBuilder("/pictures/a.jpg").setType(ImageMedia).setDate("2012"));
+    store.insert(MediaFileBuilder("/pictures/b.jpg").setType(ImageMedia).setDate("2014"));
+    store.insert(MediaFileBuilder("/videos/a.mp4").setType(VideoMedia).setDuration(60));
+
+    EXPECT_EQ(5, store.count(AudioMedia, Filter()));
+    EXPECT_EQ(2, store.count(ImageMedia, Filter()));
+    EXPECT_EQ(1, store.count(VideoMedia, Filter()));
+    EXPECT_EQ(8, store.count(AllMedia, Filter()));
+    EXPECT_EQ(Aggregate(5, 1500, 3, 3), store.aggregate(Filter()));
+
+    Filter filter;
+    filter.setDateRange(1325376000, 1356998400); // 2012
+    EXPECT_EQ(1, store.count(ImageMedia, filter));
+    EXPECT_EQ(0, store.count(AudioMedia, filter));
+    EXPECT_EQ(1, store.count(AllMedia, filter));
+
+    // Each combination of filters agrees with listing the songs.
+    auto check = [&](const string &where) {
+        for (int artist = 0; artist < 2; artist++) {
+            for (int album_artist = 0; album_artist < 2; album_artist++) {
+                for (int genre = 0; genre < 2; genre++) {
+                    for (int album = 0; album < 2; album++) {
+                        Filter f;
+                        if (artist) {
+                            f.setArtist("Artist2");
+                        }
+                        if (album_artist) {
+                            f.setAlbumArtist("Artist1");
+                        }
+                        if (genre) {
+                            f.setGenre("rock");
+                        }
+                        if (album) {
+                            f.setAlbum("Album1");
+                        }
+                        EXPECT_EQ(aggregate_songs(store, f), store.aggregate(f))
+                            << where << " " << artist << album_artist << genre << album;
+                        EXPECT_EQ(store.listSongs(f).size(), store.count(AudioMedia, f));
+                    }
+                }
+            }
+        }
+    };
+    check("inserted");
+
+    // The summaries follow changes to the songs.
+    store.insert(song("c.ogg", "Artist2", "Album1", "Artist1", "pop", 350));
+    store.remove("/music/a.ogg");
+    check("changed");
+    EXPECT_EQ(Aggregate(4, 1450, 3, 3), store.aggregate(Filter()));
+    EXPECT_EQ(7, store.count(AllMedia, Filter()));
+}
+
+TEST_F(MediaStoreTest, facets) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    auto song = [](const string &name, const string &artist, const string &album,
+                   const string &genre, const string &date, int duration) {
+        return MediaFileBuilder("/music/" + name).setType(AudioMedia)
+            .setAuthor(artist).setAlbum(album).setAlbumArtist(artist)
+            .setGenre(genre).setDate(date).setDuration(duration).build();
+    };
+    store.insert(song("a.ogg", "Artist1", "Album1", "rock", "2001-05-01", 100));
+    store.insert(song("b.ogg", "Artist1", "Album1", "rock", "2001-05-01", 200));
+    store.insert(song("c.ogg", "Artist1", "Album2", "pop", "2003", 300));
+    store.insert(song("d.ogg", "Artist2", "Album3", "rock", "2003-12-31T23:00:00-02:00", 400));
+    store.insert(song("e.ogg", "Artist3", "Album4", "jazz", "", 500));
+    store.insert(MediaFileBuilder("/videos/a.mp4").setType(VideoMedia).setDate("2001").setDuration(60));
+
+    Filter filter;
+    EXPECT_EQ(vector<Facet>({{"Artist1", 3, 2, 600}, {"Artist2", 1, 1, 400}, {"Artist3", 1, 1, 500}}),
+              store.facets(FacetField::Artist, filter));
+    EXPECT_EQ(store.facets(FacetField::Artist, filter), store.facets(FacetField::AlbumArtist, filter));
+    EXPECT_EQ(vector<Facet>({{"jazz", 1, 1, 500}, {"pop", 1, 1, 300}, {"rock", 3, 2, 700}}),
+              store.facets(FacetField::Genre, filter));
+    // Dates are bucketed in UTC, and undated songs left out.
+    EXPECT_EQ(vector<Facet>({{"2001", 2, 1, 300}, {"2003", 1, 1, 300}, {"2004", 1, 1, 400}}),
+              store.facets(FacetField::Year, filter));
+
+    // The values are those of the songs matching the filter.
+    filter.setGenre("rock");
+    EXPECT_EQ(vector<Facet>({{"Artist1", 2, 1, 300}, {"Artist2", 1, 1, 400}}),
+              store.facets(FacetField::Artist, filter));
+    filter.setDateRange(978307200, 1009843200); // 2001
+    EXPECT_EQ(vector<Facet>({{"Artist1", 2, 1, 300}}),
+              store.facets(FacetField::Artist, filter));
+    filter.clear();
+
+    // Paging by cursor or offset.
+    filter.setLimit(2);
+    auto page = store.facets(FacetField::Genre, filter);
+    ASSERT_EQ(2, page.size());
+    filter.setCursorAfterName(page.back().value);
+    EXPECT_EQ(vector<Facet>({{"rock", 3, 2, 700}}), store.facets(FacetField::Genre, filter));
+    filter.unsetCursor();
+    filter.setOffset(1);
+    EXPECT_EQ(vector<Facet>({{"pop", 1, 1, 300}, {"rock", 3, 2, 700}}),
+              store.facets(FacetField::Genre, filter));
+}
+
 TEST_F(MediaStoreTest, brokenFiles) {
     MediaStore store(":memory:", MS_READ_WRITE);
     std::string file = "/foo/bar/baz.mp3";
@@ -1288,6 +1885,378 @@ TEST_F(MediaStoreTest, brokenFiles) {
     ASSERT_FALSE(store.is_broken_file(other_file, broken_etag));
 }
 
+TEST_F(MediaStoreTest, extractionJournal) {
+    const string dbname("extraction-mediastore.db");
+    const string snapshot = dbname + "-snapshot";
+    const string journal = dbname + "-extracting";
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+    unlink(journal.c_str());
+
+    {
+        MediaStore store(dbname, MS_READ_WRITE);
+        store.beginExtraction("/done.ogg", "1");
+        store.endExtraction("/done.ogg");
+        EXPECT_FALSE(store.is_broken_file("/done.ogg", "1"));
+    }
+    // A process that dies while extracting leaves the file behind.
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        MediaStore store(dbname, MS_READ_WRITE);
+        store.beginExtraction("/crash.ogg", "2");
+        _exit(0);
+    }
+    int status;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    {
+        MediaStore store(dbname, MS_READ_WRITE);
+        EXPECT_TRUE(store.is_broken_file("/crash.ogg", "2"));
+        EXPECT_FALSE(store.is_broken_file("/done.ogg", "1"));
+    }
+
+    // In memory stores keep the journal in memory.
+    MediaStore store(":memory:", MS_READ_WRITE);
+    store.beginExtraction("/file.ogg", "3");
+    store.endExtraction("/file.ogg");
+    EXPECT_FALSE(store.is_broken_file("/file.ogg", "3"));
+
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+    unlink(journal.c_str());
+}
+
+TEST_F(MediaStoreTest, knownFiles) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    store.insert(MediaFileBuilder("/music/a.ogg").setType(AudioMedia).setETag("1"));
+    store.insert(MediaFileBuilder("/music/sub/b.ogg").setType(AudioMedia).setETag("2"));
+    store.insert(MediaFileBuilder("/music/sub/c.ogg").setType(AudioMedia).setETag("3"));
+    store.insert(MediaFileBuilder("/music2/d.ogg").setType(AudioMedia).setETag("4"));
+    store.insert_broken_file("/music/sub/c.ogg", "5");
+    store.insert_broken_file("/music/e.ogg", "6");
+    store.insert_broken_file("/music2/f.ogg", "7");
+
+    KnownFiles known = getKnownFiles(store, "/music/");
+    EXPECT_EQ(4, known.size());
+    EXPECT_EQ(KnownFiles::Unchanged, known.check("/music/a.ogg", "1"));
+    EXPECT_EQ(KnownFiles::Changed, known.check("/music/sub/c.ogg", "4"));
+    EXPECT_EQ(KnownFiles::Broken, known.check("/music/e.ogg", "6"));
+    EXPECT_EQ(KnownFiles::New, known.check("/music/g.ogg", "8"));
+    // Files below other directories are not loaded.
+    EXPECT_EQ(KnownFiles::New, known.check("/music2/d.ogg", "4"));
+    EXPECT_EQ(vector<string>{"/music/sub/b.ogg"}, known.getUnseen());
+
+    known = getKnownFiles(store, "/");
+    EXPECT_EQ(6, known.size());
+    EXPECT_EQ(KnownFiles::Broken, known.check("/music/sub/c.ogg", "5"));
+    EXPECT_EQ(KnownFiles::Broken, known.check("/music2/f.ogg", "7"));
+    EXPECT_EQ(3, known.getUnseen().size());
+
+    EXPECT_EQ(0, getKnownFiles(store, "/nowhere").size());
+    EXPECT_THROW(known.add("/a", "1", nullptr), std::invalid_argument);
+}
+
+TEST_F(MediaStoreTest, insertBatch) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    vector<MediaFile> files;
+    for (int i = 0; i < 1200; i++) {
+        string fname = "/path/file" + to_string(i) + ".ogg";
+        files.emplace_back(MediaFileBuilder(fname)
+                           .setETag("etag" + to_string(i))
+                           .setType(AudioMedia));
+        store.insert_broken_file(fname, "etag" + to_string(i));
+    }
+    store.insertBatch(files);
+    EXPECT_EQ(1200, store.size());
+    EXPECT_EQ("etag42", store.getETag("/path/file42.ogg"));
+    EXPECT_EQ(files[1100], store.lookup("/path/file1100.ogg"));
+    EXPECT_FALSE(store.is_broken_file("/path/file0.ogg", "etag0"));
+    EXPECT_FALSE(store.is_broken_file("/path/file1199.ogg", "etag1199"));
+
+    // Batches can be nested inside a transaction.
+    {
+        MediaStoreTransaction txn = store.beginTransaction();
+        store.insertBatch({MediaFileBuilder("/path/new.ogg").setType(AudioMedia)});
+    }
+    EXPECT_EQ(1200, store.size());
+
+    // A failing row aborts the whole batch.
+    EXPECT_THROW(store.insertBatch({
+                MediaFileBuilder("/path/ok.ogg").setType(AudioMedia),
+                MediaFileBuilder("relative.ogg").setType(AudioMedia)}),
+        std::runtime_error);
+    EXPECT_EQ(1200, store.size());
+}
+
+TEST_F(MediaStoreTest, mediaFileBatch) {
+    MediaFile audio = MediaFileBuilder("/path/foo_bar.ogg")
+        .setType(AudioMedia)
+        .setContentType("audio/ogg")
+        .setETag("etag")
+        .setAuthor("Artist")
+        .setAlbum("Album")
+        .setGenre("Rock")
+        .setDate("2016-01-01")
+        .setDiscNumber(1)
+        .setTrackNumber(3)
+        .setDuration(180)
+        .setHasThumbnail(true)
+        .setModificationTime(42);
+    MediaFile image = MediaFileBuilder("/path/image.jpg")
+        .setType(ImageMedia)
+        .setTitle("Image")
+        .setWidth(640)
+        .setHeight(480)
+        .setLatitude(1.5)
+        .setLongitude(-2.5);
+
+    MediaFileBatch batch;
+    EXPECT_TRUE(batch.empty());
+    batch.append(audio);
+    batch.append(image);
+    ASSERT_EQ(2, batch.size());
+
+    // Empty titles and album artists get the MediaFile fallbacks.
+    EXPECT_EQ(audio.getTitle(), batch.getString(0, MediaFileBatch::Title));
+    EXPECT_EQ("foo bar", batch.getString(0, MediaFileBatch::Title));
+    EXPECT_EQ("Artist", batch.getString(0, MediaFileBatch::AlbumArtist));
+    EXPECT_EQ(0, batch.getTextLength(1, MediaFileBatch::Album));
+    EXPECT_STREQ("", batch.getText(1, MediaFileBatch::Album));
+    EXPECT_STREQ("/path/image.jpg", batch.getText(1, MediaFileBatch::FileName));
+    EXPECT_EQ(480, batch.getHeight(1));
+    EXPECT_EQ(ImageMedia, batch.getType(1));
+    EXPECT_EQ(audio.getUri(), batch.getUri(0));
+    EXPECT_EQ(audio.getArtUri(), batch.getArtUri(0));
+    EXPECT_EQ(image.getArtUri(), batch.getArtUri(1));
+    EXPECT_EQ(audio, batch.getMediaFile(0));
+    EXPECT_EQ(image, batch.getMediaFile(1));
+    EXPECT_EQ(MediaFileBatch({audio, image}), batch);
+
+    MediaFileBatch other({image});
+    other.append(batch);
+    other.append(other);
+    ASSERT_EQ(6, other.size());
+    EXPECT_EQ(image, other.getMediaFile(0));
+    EXPECT_EQ(audio, other.getMediaFile(1));
+    EXPECT_EQ(image, other.getMediaFile(5));
+    EXPECT_NE(batch, other);
+    other.clear();
+    EXPECT_TRUE(other.empty());
+
+    MediaStore store(":memory:", MS_READ_WRITE);
+    store.insertBatch({audio, image,
+                MediaFileBuilder("/path/other.ogg")
+                    .setType(AudioMedia)
+                    .setTitle("Other")
+                    .setAuthor("Artist")
+                    .setAlbumArtist("Someone")});
+    Filter filter;
+    EXPECT_EQ(MediaFileBatch(store.listSongs(filter)), store.listSongsBatch(filter));
+    EXPECT_EQ(2, store.listSongsBatch(filter).size());
+    EXPECT_EQ(MediaFileBatch(store.query("artist", AudioMedia, filter)),
+              store.queryBatch("artist", AudioMedia, filter));
+    EXPECT_EQ(MediaFileBatch({image}), store.queryBatch("", ImageMedia, filter));
+}
+
+TEST_F(MediaStoreTest, forEach) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    vector<MediaFile> files;
+    for (int i = 0; i < 20; i++) {
+        files.emplace_back(MediaFileBuilder("/path/song" + to_string(i) + ".ogg")
+                           .setType(AudioMedia)
+                           .setTitle("Song " + to_string(i))
+                           .setAuthor("Artist")
+                           .setAlbum("Album")
+                           .setTrackNumber(i));
+    }
+    store.insertBatch(files);
+
+    Filter filter;
+    filter.setLimit(-1);
+    vector<MediaFile> songs;
+    store.forEachSong(filter, [&](const MediaFile &song) {
+            songs.push_back(song);
+            return true;
+        });
+    EXPECT_EQ(store.listSongs(filter), songs);
+    EXPECT_EQ(20, songs.size());
+
+    vector<MediaFile> results;
+    store.forEachMedia("song", AudioMedia, filter, [&](const MediaFile &media) {
+            results.push_back(media);
+            return true;
+        });
+    EXPECT_EQ(store.query("song", AudioMedia, filter), results);
+
+    // Returning false stops the iteration.
+    int count = 0;
+    store.forEachSong(filter, [&](const MediaFile &) {
+            return ++count < 5;
+        });
+    EXPECT_EQ(5, count);
+
+    // Exceptions from the callback propagate, and leave the store usable.
+    EXPECT_THROW(store.forEachSong(filter, [](const MediaFile &) -> bool {
+                throw std::runtime_error("stop");
+            }), std::runtime_error);
+    EXPECT_EQ(songs, store.listSongs(filter));
+}
+
+static void execute_sql(const string &dbname, const string &sql) {
+    sqlite3 *db = nullptr;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(dbname.c_str(), &db));
+    char *errmsg = nullptr;
+    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errmsg);
+    EXPECT_EQ(SQLITE_OK, rc) << errmsg;
+    sqlite3_free(errmsg);
+    sqlite3_close(db);
+}
+
+// The first value returned by a query, run with a connection of its own.
+static string read_value(const string &dbname, const string &sql) {
+    sqlite3 *db = nullptr;
+    string value;
+    if (sqlite3_open(dbname.c_str(), &db) == SQLITE_OK) {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+    return value;
+}
+
+static string read_pragma(const string &dbname, const string &pragma) {
+    return read_value(dbname, "PRAGMA " + pragma);
+}
+
+TEST_F(MediaStoreTest, maintenance) {
+    const string dbname("maintenance-mediastore.db");
+    const string snapshot = dbname + "-snapshot";
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+    {
+        MediaStore store(dbname, MS_READ_WRITE);
+        // A new file is set up for incremental vacuum, despite WAL.
+        EXPECT_EQ("wal", read_pragma(dbname, "journal_mode"));
+        EXPECT_EQ("2", read_pragma(dbname, "auto_vacuum"));
+        // Each commit adds a segment to the search index.
+        for (int i = 0; i < 20; i++) {
+            MediaStoreTransaction txn = store.beginTransaction();
+            for (int j = 0; j < 50; j++) {
+                store.insert(MediaFileBuilder("/music/" + to_string(i) + "/" + to_string(j) + ".ogg")
+                             .setType(AudioMedia).setTitle("Song " + to_string(j)));
+            }
+            txn.commit();
+        }
+        for (int i = 0; i < 10; i++) {
+            store.removeSubtree("/music/" + to_string(i));
+        }
+        DatabaseStats before = store.getDatabaseStats();
+        EXPECT_GT(before.size, 0);
+        EXPECT_GT(before.fts_segments, 1);
+        EXPECT_GT(before.freelist_pages, 0);
+
+        int slices = 0;
+        while (!store.runMaintenance(1)) {
+            ASSERT_LT(++slices, 1000);
+        }
+        DatabaseStats after = store.getDatabaseStats();
+        EXPECT_EQ(1, after.fts_segments);
+        EXPECT_EQ(0, after.freelist_pages);
+        EXPECT_LT(after.size, before.size);
+        Filter all;
+        all.setLimit(-1);
+        EXPECT_EQ(500, store.query("song", AudioMedia, all).size());
+
+        // The next call starts over.
+        EXPECT_TRUE(store.runMaintenance(1000));
+    }
+
+    // Maintenance does not rewrite a file made without incremental
+    // vacuum.
+    execute_sql(dbname, "PRAGMA auto_vacuum = NONE; VACUUM;");
+    ASSERT_EQ("0", read_pragma(dbname, "auto_vacuum"));
+    {
+        MediaStore store(dbname, MS_READ_WRITE);
+        EXPECT_EQ("0", read_pragma(dbname, "auto_vacuum"));
+        for (int i = 10; i < 15; i++) {
+            store.removeSubtree("/music/" + to_string(i));
+        }
+        EXPECT_GT(store.getDatabaseStats().freelist_pages, 0);
+        while (!store.runMaintenance(1000)) {
+        }
+        EXPECT_EQ("0", read_pragma(dbname, "auto_vacuum"));
+        EXPECT_GT(store.getDatabaseStats().freelist_pages, 0);
+        EXPECT_EQ(250, store.size());
+    }
+
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+}
+
+TEST_F(MediaStoreTest, removeBatch) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    store.insertBatch({
+            MediaFileBuilder("/path/one.ogg").setType(AudioMedia),
+            MediaFileBuilder("/path/two.ogg").setType(AudioMedia),
+            MediaFileBuilder("/path/three.ogg").setType(AudioMedia)});
+    EXPECT_EQ(3, store.size());
+    store.removeBatch({"/path/one.ogg", "/path/three.ogg", "/path/missing.ogg"});
+    EXPECT_EQ(1, store.size());
+    EXPECT_EQ("/path/two.ogg", store.lookup("/path/two.ogg").getFileName());
+}
+
+TEST_F(MediaStoreTest, pruneDeleted) {
+    const string root = TEST_DIR "/prunedir";
+    const vector<string> existing = {
+        root + "/keep/keep.ogg",
+        root + "/blocked/.nomedia",
+        root + "/blocked/sub/blocked.ogg",
+    };
+    const vector<string> known = {
+        root + "/keep/keep.ogg",
+        root + "/keep/link.ogg",
+        root + "/keep/deleted.ogg",
+        root + "/blocked/sub/blocked.ogg",
+        root + "/missing/one.ogg",
+        root + "/missing/sub/two.ogg",
+    };
+    ASSERT_EQ(0, system(("rm -rf " + root).c_str()));
+    ASSERT_EQ(0, mkdir(root.c_str(), 0700));
+    ASSERT_EQ(0, mkdir((root + "/keep").c_str(), 0700));
+    ASSERT_EQ(0, mkdir((root + "/blocked").c_str(), 0700));
+    ASSERT_EQ(0, mkdir((root + "/blocked/sub").c_str(), 0700));
+    for (const auto &filename : existing) {
+        FILE *f = fopen(filename.c_str(), "w");
+        ASSERT_NE(nullptr, f);
+        fclose(f);
+    }
+    // A dangling symlink counts as deleted.
+    ASSERT_EQ(0, symlink("nowhere.ogg", (root + "/keep/link.ogg").c_str()));
+
+    MediaStore store(":memory:", MS_READ_WRITE);
+    for (const auto &filename : known) {
+        store.insert(MediaFileBuilder(filename).setType(AudioMedia));
+    }
+    store.insert(MediaFileBuilder("/notmounted/song.ogg").setType(AudioMedia));
+    store.pruneDeleted();
+
+    EXPECT_EQ(1, store.size());
+    EXPECT_EQ(root + "/keep/keep.ogg", store.lookup(root + "/keep/keep.ogg").getFileName());
+
+    // Files below skipped directories are left to the caller.
+    store.insert(MediaFileBuilder(root + "/missing/one.ogg").setType(AudioMedia));
+    store.insert(MediaFileBuilder(root + "/missing/sub/two.ogg").setType(AudioMedia));
+    store.insert(MediaFileBuilder(root + "/missingno.ogg").setType(AudioMedia));
+    store.pruneDeleted({root + "/missing/"});
+    EXPECT_EQ(3, store.size());
+    EXPECT_THROW(store.lookup(root + "/missingno.ogg"), std::runtime_error);
+    ASSERT_EQ(0, system(("rm -rf " + root).c_str()));
+}
+
 TEST_F(MediaStoreTest, removeSubtree) {
     MediaStore store(":memory:", MS_READ_WRITE);
 
@@ -1320,6 +2289,98 @@ TEST_F(MediaStoreTest, removeSubtree) {
     }
 }
 
+TEST_F(MediaStoreTest, removeSubtreeDirectories) {
+    const string dbname("directories-mediastore.db");
+    const string snapshot = dbname + "-snapshot";
+    const string count = "SELECT count(*) FROM directories";
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+    {
+        MediaStore store(dbname, MS_READ_WRITE);
+        store.insert(MediaFileBuilder("/music/keep/song.ogg").setType(AudioMedia));
+        store.insert(MediaFileBuilder("/music/gone/a/song.ogg").setType(AudioMedia));
+        store.insert(MediaFileBuilder("/music/gone/b/c/song.ogg").setType(AudioMedia));
+        store.insert(MediaFileBuilder("/other/x/song.ogg").setType(AudioMedia));
+        // The root, music, keep, gone, a, b, c, other and x.
+        EXPECT_EQ("9", read_value(dbname, count));
+
+        store.removeSubtree("/music/gone");
+        EXPECT_EQ("5", read_value(dbname, count));
+        // Directories left holding nothing but the removed one go too.
+        store.removeSubtree("/other/x");
+        EXPECT_EQ("3", read_value(dbname, count));
+        // Including the last one a file was inserted into.
+        store.insert(MediaFileBuilder("/other/x/again.ogg").setType(AudioMedia));
+        EXPECT_EQ("5", read_value(dbname, count));
+        EXPECT_EQ("/other/x/again.ogg", store.listFolder("/other/x", Filter()).getMedia()[0].getFileName());
+
+        // Archived media keeps its directories.
+        store.archiveItems("/music");
+        EXPECT_EQ("5", read_value(dbname, count));
+        store.restoreItems("/music");
+        EXPECT_EQ("5", read_value(dbname, count));
+        EXPECT_EQ(2, store.size());
+
+        store.removeSubtree("/");
+        EXPECT_EQ("1", read_value(dbname, count));
+    }
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+}
+
+TEST_F(MediaStoreTest, listFolder) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    MediaFile one = MediaFileBuilder("/home/username/Music/one.ogg").setType(AudioMedia);
+    MediaFile two = MediaFileBuilder("/home/username/Music/two.ogg").setType(AudioMedia);
+    store.insert(two);
+    store.insert(one);
+    store.insert(MediaFileBuilder("/home/username/Music/Album/track.ogg").setType(AudioMedia));
+    store.insert(MediaFileBuilder("/home/username/Music/Artist/Album/track1.ogg").setType(AudioMedia));
+    store.insert(MediaFileBuilder("/home/username/Music/Artist/Album/track2.ogg").setType(AudioMedia));
+    store.insert(MediaFileBuilder("/home/username/Music/Empty/gone.ogg").setType(AudioMedia));
+    store.remove("/home/username/Music/Empty/gone.ogg");
+    store.insert(MediaFileBuilder("/home/username2/Music/other.ogg").setType(AudioMedia));
+
+    Filter filter;
+    Folder folder = store.listFolder("/home/username/Music/", filter);
+    EXPECT_EQ("/home/username/Music", folder.getPath());
+    EXPECT_EQ("Music", folder.getName());
+    EXPECT_EQ(5, folder.getMediaCount());
+    ASSERT_EQ(2, folder.getSubfolders().size());
+    EXPECT_EQ(Folder("/home/username/Music/Album", 1), folder.getSubfolders()[0]);
+    EXPECT_EQ(Folder("/home/username/Music/Artist", 2), folder.getSubfolders()[1]);
+    ASSERT_EQ(2, folder.getMedia().size());
+    EXPECT_EQ(one, folder.getMedia()[0]);
+    EXPECT_EQ(two, folder.getMedia()[1]);
+
+    folder = store.listFolder("/", filter);
+    EXPECT_EQ("/", folder.getPath());
+    EXPECT_EQ(6, folder.getMediaCount());
+    ASSERT_EQ(1, folder.getSubfolders().size());
+    EXPECT_EQ(Folder("/home", 6), folder.getSubfolders()[0]);
+    EXPECT_EQ(0, folder.getMedia().size());
+
+    filter.setLimit(1);
+    filter.setCursorAfter(one);
+    folder = store.listFolder("/home/username/Music", filter);
+    ASSERT_EQ(1, folder.getMedia().size());
+    EXPECT_EQ(two, folder.getMedia()[0]);
+
+    folder = store.listFolder("/no/such/folder", Filter());
+    EXPECT_EQ(Folder("/no/such/folder", 0), folder);
+
+    // Subtree operations only touch the named directory, not
+    // siblings sharing its name as a prefix.
+    store.archiveItems("/home/username");
+    EXPECT_EQ(1, store.size());
+    EXPECT_EQ(1, store.listFolder("/", Filter()).getMediaCount());
+    store.restoreItems("/home/username/");
+    EXPECT_EQ(6, store.size());
+    store.removeSubtree("/home/username/Music/Artist");
+    EXPECT_EQ(4, store.size());
+    EXPECT_EQ(3, store.listFolder("/home/username", Filter()).getMediaCount());
+}
+
 TEST_F(MediaStoreTest, transaction) {
     MediaStore store(":memory:", MS_READ_WRITE);
 
@@ -1349,6 +2410,397 @@ TEST_F(MediaStoreTest, transaction) {
     EXPECT_THROW(store.lookup("/four.mp3"), std::runtime_error);
 }
 
+TEST_F(MediaStoreTest, snapshot) {
+    const string dbname("snapshot-mediastore.db");
+    const string snapshot = dbname + "-snapshot";
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+
+    {
+        MediaStore writer(dbname, MS_READ_WRITE);
+        // An empty database is published when the writer is opened.
+        ASSERT_EQ(0, access(snapshot.c_str(), F_OK));
+        MediaStore reader(dbname, MS_READ_ONLY);
+        EXPECT_EQ(0, reader.size());
+
+        // Uncommitted changes are not published.
+        {
+            MediaStoreTransaction txn = writer.beginTransaction();
+            writer.insert(MediaFileBuilder("/one.mp3").setType(AudioMedia));
+            writer.publishSnapshot();
+            EXPECT_EQ(0, reader.size());
+            txn.commit();
+            // Nor is a commit on its own, but the transaction can
+            // publish what it committed.
+            EXPECT_EQ(0, reader.size());
+            txn.commitAndPublish();
+            EXPECT_EQ(1, reader.size());
+        }
+
+        writer.insert(MediaFileBuilder("/two.mp3").setType(AudioMedia));
+        EXPECT_EQ(1, reader.size());
+        writer.publishSnapshot();
+        EXPECT_EQ(2, reader.size());
+        EXPECT_EQ("/two.mp3", reader.lookup("/two.mp3").getFileName());
+    }
+
+    // The snapshot does not need a WAL or shared memory file.
+    char header[20];
+    FILE *f = fopen(snapshot.c_str(), "rb");
+    ASSERT_NE(nullptr, f);
+    ASSERT_EQ(1, fread(header, sizeof(header), 1, f));
+    fclose(f);
+    EXPECT_EQ(1, header[18]);
+    EXPECT_EQ(1, header[19]);
+
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+}
+
+TEST_F(MediaStoreTest, changeJournal) {
+    MediaStore store(":memory:", MS_READ_WRITE);
+    EXPECT_EQ(0, store.getChangeSequence());
+    EXPECT_TRUE(store.getChangesSince(0).empty());
+
+    store.insert(MediaFileBuilder("/path/song.ogg").setType(AudioMedia));
+    store.insert(MediaFileBuilder("/path/image.jpg").setType(ImageMedia));
+    // Replacing a file is an update.
+    store.insert(MediaFileBuilder("/path/song.ogg").setType(AudioMedia).setTitle("Song"));
+    store.remove("/path/image.jpg");
+    const int64_t seq = store.getChangeSequence();
+    EXPECT_EQ((vector<MediaChange>{
+                MediaChange(1, ChangeKind::Insert, "/path/song.ogg", AudioMedia),
+                MediaChange(2, ChangeKind::Insert, "/path/image.jpg", ImageMedia),
+                MediaChange(4, ChangeKind::Update, "/path/song.ogg", AudioMedia),
+                MediaChange(5, ChangeKind::Delete, "/path/image.jpg", ImageMedia),
+            }), store.getChangesSince(0));
+    EXPECT_EQ(5, seq);
+    EXPECT_TRUE(store.getChangesSince(seq).empty());
+
+    // Removing a subtree journals each file.
+    store.insert(MediaFileBuilder("/other/video.mp4").setType(VideoMedia));
+    store.removeSubtree("/path");
+    auto changes = store.getChangesSince(seq);
+    ASSERT_EQ(2, changes.size());
+    EXPECT_EQ(ChangeKind::Insert, changes[0].getKind());
+    EXPECT_EQ("/other/video.mp4", changes[0].getFileName());
+    EXPECT_EQ(ChangeKind::Delete, changes[1].getKind());
+    EXPECT_EQ("/path/song.ogg", changes[1].getFileName());
+    EXPECT_EQ(changes[1].getSequence(), store.getChangeSequence());
+    // Which types changed can be asked without reading the changes.
+    EXPECT_EQ(vector<MediaType>({AudioMedia, VideoMedia, ImageMedia}), store.getChangedTypesSince(0));
+    EXPECT_EQ(vector<MediaType>({AudioMedia, VideoMedia}), store.getChangedTypesSince(seq));
+    EXPECT_TRUE(store.getChangedTypesSince(store.getChangeSequence()).empty());
+
+    // Trimming drops the oldest changes, after which older sequence
+    // numbers can not be caught up from.
+    store.trimChanges(1, 3600);
+    EXPECT_EQ(changes[1].getSequence(), store.getChangeSequence());
+    EXPECT_EQ(vector<MediaChange>({changes[1]}), store.getChangesSince(changes[0].getSequence()));
+    EXPECT_THROW(store.getChangesSince(seq), std::runtime_error);
+    EXPECT_THROW(store.getChangedTypesSince(seq), std::runtime_error);
+    EXPECT_THROW(store.getChangesSince(store.getChangeSequence() + 1), std::runtime_error);
+    store.trimChanges(0, 3600);
+    EXPECT_TRUE(store.getChangesSince(store.getChangeSequence()).empty());
+    EXPECT_THROW(store.getChangesSince(changes[0].getSequence()), std::runtime_error);
+
+    // Sequence numbers keep increasing once the journal is empty.
+    const int64_t last = store.getChangeSequence();
+    store.insert(MediaFileBuilder("/path/new.ogg").setType(AudioMedia));
+    EXPECT_EQ(last + 1, store.getChangeSequence());
+    EXPECT_EQ(1, store.getChangesSince(last).size());
+}
+
+// The schema as written by version 10, the oldest that can be
+// migrated, before any of the later steps existed.
+static const char version_10_schema[] = R"(
+CREATE TABLE schemaVersion (version INTEGER);
+
+CREATE TABLE media (
+    id INTEGER PRIMARY KEY,
+    filename TEXT UNIQUE NOT NULL CHECK (filename LIKE '/%'),
+    content_type TEXT,
+    etag TEXT,
+    title TEXT,
+    date TEXT,
+    artist TEXT,          -- Only relevant to audio
+    album TEXT,           -- Only relevant to audio
+    album_artist TEXT,    -- Only relevant to audio
+    genre TEXT,           -- Only relevant to audio
+    disc_number INTEGER,  -- Only relevant to audio
+    track_number INTEGER, -- Only relevant to audio
+    duration INTEGER,
+    width INTEGER,        -- Only relevant to video/images
+    height INTEGER,       -- Only relevant to video/images
+    latitude DOUBLE,
+    longitude DOUBLE,
+    has_thumbnail INTEGER CHECK (has_thumbnail IN (0, 1)),
+    mtime INTEGER,
+    type INTEGER CHECK (type IN (1, 2, 3)) -- MediaType enum
+);
+
+CREATE INDEX media_type_idx ON media(type);
+CREATE INDEX media_song_info_idx ON media(type, album_artist, album, disc_number, track_number, title) WHERE type = 1;
+CREATE INDEX media_artist_idx ON media(type, artist) WHERE type = 1;
+CREATE INDEX media_genre_idx ON media(type, genre) WHERE type = 1;
+CREATE INDEX media_mtime_idx ON media(type, mtime);
+
+CREATE TABLE media_attic (
+    filename TEXT UNIQUE NOT NULL,
+    content_type TEXT,
+    etag TEXT,
+    title TEXT,
+    date TEXT,
+    artist TEXT,          -- Only relevant to audio
+    album TEXT,           -- Only relevant to audio
+    album_artist TEXT,    -- Only relevant to audio
+    genre TEXT,           -- Only relevant to audio
+    disc_number INTEGER,  -- Only relevant to audio
+    track_number INTEGER, -- Only relevant to audio
+    duration INTEGER,
+    width INTEGER,        -- Only relevant to video/images
+    height INTEGER,       -- Only relevant to video/images
+    latitude DOUBLE,
+    longitude DOUBLE,
+    has_thumbnail INTEGER,
+    mtime INTEGER,
+    type INTEGER   -- 0=Audio, 1=Video
+);
+
+CREATE VIRTUAL TABLE media_fts
+USING fts4(content='media', title, artist, album, tokenize=mozporter);
+
+CREATE TRIGGER media_bu BEFORE UPDATE ON media BEGIN
+  DELETE FROM media_fts WHERE docid=old.id;
+END;
+
+CREATE TRIGGER media_au AFTER UPDATE ON media BEGIN
+  INSERT INTO media_fts(docid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);
+END;
+
+CREATE TRIGGER media_bd BEFORE DELETE ON media BEGIN
+  DELETE FROM media_fts WHERE docid=old.id;
+END;
+
+CREATE TRIGGER media_ai AFTER INSERT ON media BEGIN
+  INSERT INTO media_fts(docid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);
+END;
+
+CREATE TABLE broken_files (
+    filename TEXT PRIMARY KEY NOT NULL,
+    etag TEXT NOT NULL
+);
+
+INSERT INTO schemaVersion (version) VALUES (10);
+)";
+
+// Write a database as version 10 did, then run sql on it.
+static void create_version_10_database(const string &dbname, const string &sql) {
+    unlink(dbname.c_str());
+    sqlite3 *db = nullptr;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(dbname.c_str(), &db));
+    sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 1, nullptr);
+    sqlite3_stmt *stmt = nullptr;
+    ASSERT_EQ(SQLITE_OK, sqlite3_prepare_v2(db, "SELECT fts3_tokenizer('mozporter', ?)", -1, &stmt, nullptr));
+    const sqlite3_tokenizer_module *module = nullptr;
+    sqlite3Fts3PorterTokenizerModule(&module);
+    sqlite3_bind_blob(stmt, 1, &module, sizeof(module), SQLITE_TRANSIENT);
+    EXPECT_EQ(SQLITE_ROW, sqlite3_step(stmt));
+    sqlite3_finalize(stmt);
+    char *errmsg = nullptr;
+    int rc = sqlite3_exec(db, (string(version_10_schema) + sql).c_str(), nullptr, nullptr, &errmsg);
+    EXPECT_EQ(SQLITE_OK, rc) << errmsg;
+    sqlite3_free(errmsg);
+    sqlite3_close(db);
+}
+
+TEST_F(MediaStoreTest, migrateSchema) {
+    const string dbname("migrate-mediastore.db");
+    const string snapshot = dbname + "-snapshot";
+    unlink(snapshot.c_str());
+    create_version_10_database(dbname, R"(
+INSERT INTO media (filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type)
+  VALUES ('/music/one.ogg', 'audio/ogg', 'e1', 'Bat Country', '', 'Artist', 'Album', 'Artist', 'rock', 1, 1, 200, 0, 0, 0, 0, 0, 100, 1),
+         ('/music/two.ogg', 'audio/ogg', 'e2', 'Hammer Time', '1990-02-20', 'Artist', 'Album', 'Artist', 'rock', 1, 2, 100, 0, 0, 0, 0, 0, 100, 1),
+         ('/videos/three.mp4', 'video/mp4', 'e3', 'Three', '', '', '', '', '', 0, 0, 30, 640, 480, 48.8584, 2.2945, 0, 100, 2);
+)");
+    ASSERT_EQ("0", read_pragma(dbname, "auto_vacuum"));
+
+    {
+        // Every step runs in turn, and the rows and etags survive
+        // rather than the database being rebuilt empty.
+        MediaStore store(dbname, MS_READ_WRITE);
+        EXPECT_EQ(3, store.size());
+        // The file was converted for incremental vacuum on the way.
+        EXPECT_EQ("2", read_pragma(dbname, "auto_vacuum"));
+        EXPECT_EQ("e1", store.getETag("/music/one.ogg"));
+        EXPECT_EQ("e3", store.getETag("/videos/three.mp4"));
+        Filter filter;
+        // The search index was rebuilt.
+        auto result = store.query("hammer", AudioMedia, filter);
+        ASSERT_EQ(1, result.size());
+        EXPECT_EQ("/music/two.ogg", result[0].getFileName());
+        EXPECT_EQ(2, store.listFolder("/music", filter).getMedia().size());
+        // The summaries were filled, with totals.
+        auto albums = store.listAlbums(filter);
+        ASSERT_EQ(1, albums.size());
+        EXPECT_EQ("Album", albums[0].getTitle());
+        EXPECT_EQ(vector<string>({"Artist"}), store.listArtists(filter));
+        EXPECT_EQ(vector<string>({"rock"}), store.listGenres(filter));
+        EXPECT_EQ(vector<Facet>({Facet("rock", 2, 1, 300)}), store.facets(FacetField::Genre, filter));
+        EXPECT_EQ(3, store.count(AllMedia, filter));
+        EXPECT_EQ(1, store.count(VideoMedia, filter));
+        EXPECT_EQ(Aggregate(2, 300, 1, 1), store.aggregate(filter));
+        // The location index was filled.
+        EXPECT_EQ(1, store.queryBoundingBox(48, 2, 49, 3, VideoMedia, filter).size());
+        // So were the dates, without journaling a change.
+        EXPECT_EQ(vector<TimelineEntry>({{631152000, 1}}),
+                  store.timeline(AudioMedia, TimelineInterval::Year, filter));
+        // Changes from now on are journaled, and keep the summaries
+        // up to date.
+        store.remove("/music/one.ogg");
+        EXPECT_EQ(vector<MediaChange>({MediaChange(1, ChangeKind::Delete, "/music/one.ogg", AudioMedia)}),
+                  store.getChangesSince(0));
+        EXPECT_EQ(Aggregate(1, 100, 1, 1), store.aggregate(filter));
+    }
+    // Readers accept the migrated database.
+    EXPECT_EQ(2, MediaStore(dbname, MS_READ_ONLY).size());
+
+    // A version with no way to migrate from is rebuilt empty.
+    execute_sql(dbname, "UPDATE schemaVersion SET version = 9");
+    EXPECT_EQ(0, MediaStore(dbname, MS_READ_WRITE).size());
+    // Including one whose search index still uses the old tokenizer.
+    create_version_10_database(dbname, R"(
+INSERT INTO media (filename, content_type, etag, title, date, artist, album, album_artist, genre, disc_number, track_number, duration, width, height, latitude, longitude, has_thumbnail, mtime, type)
+  VALUES ('/music/one.ogg', 'audio/ogg', 'e1', 'Bat Country', '', 'Artist', 'Album', 'Artist', 'rock', 1, 1, 200, 0, 0, 0, 0, 0, 100, 1);
+UPDATE schemaVersion SET version = 9;
+)");
+    EXPECT_EQ(0, MediaStore(dbname, MS_READ_WRITE).size());
+
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+}
+
+TEST_F(MediaStoreTest, resultCache) {
+    const string dbname("cache-mediastore.db");
+    const string snapshot = dbname + "-snapshot";
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+
+    MediaStore writer(dbname, MS_READ_WRITE);
+    writer.insert(MediaFileBuilder("/one.mp3").setType(AudioMedia).setAuthor("One"));
+    writer.publishSnapshot();
+
+    MediaStore reader(dbname, MS_READ_ONLY);
+    Filter filter;
+    // Caching is off by default.
+    EXPECT_EQ(vector<string>({"One"}), reader.listArtists(filter));
+    EXPECT_EQ(vector<string>({"One"}), reader.listArtists(filter));
+    EXPECT_EQ(0, reader.getCacheHits());
+    EXPECT_EQ(0, reader.getCacheMisses());
+
+    reader.setCacheSize(2);
+    EXPECT_EQ(vector<string>({"One"}), reader.listArtists(filter));
+    EXPECT_EQ(vector<string>({"One"}), reader.listArtists(filter));
+    EXPECT_EQ(1, reader.getCacheHits());
+    EXPECT_EQ(1, reader.getCacheMisses());
+    // Different arguments are cached separately.
+    EXPECT_EQ(1, reader.listSongs(filter).size());
+    EXPECT_TRUE(reader.hasMedia(AudioMedia));
+    EXPECT_FALSE(reader.hasMedia(VideoMedia));
+    EXPECT_EQ(1, reader.getCacheHits());
+    EXPECT_EQ(4, reader.getCacheMisses());
+    EXPECT_FALSE(reader.hasMedia(VideoMedia));
+    EXPECT_EQ(2, reader.getCacheHits());
+    // The least recently used results were evicted.
+    EXPECT_EQ(vector<string>({"One"}), reader.listArtists(filter));
+    EXPECT_EQ(2, reader.getCacheHits());
+    EXPECT_EQ(5, reader.getCacheMisses());
+
+    // A new snapshot invalidates the cache.
+    writer.insert(MediaFileBuilder("/two.mp3").setType(AudioMedia).setAuthor("Two"));
+    EXPECT_EQ(vector<string>({"One"}), reader.listArtists(filter));
+    EXPECT_EQ(3, reader.getCacheHits());
+    writer.publishSnapshot();
+    EXPECT_EQ(vector<string>({"One", "Two"}), reader.listArtists(filter));
+    EXPECT_EQ(3, reader.getCacheHits());
+    EXPECT_EQ(6, reader.getCacheMisses());
+
+    // Without a snapshot, changes are seen through PRAGMA data_version.
+    unlink(snapshot.c_str());
+    MediaStore direct(dbname, MS_READ_ONLY);
+    direct.setCacheSize(10);
+    EXPECT_EQ(vector<string>({"One", "Two"}), direct.listArtists(filter));
+    EXPECT_EQ(vector<string>({"One", "Two"}), direct.listArtists(filter));
+    EXPECT_EQ(1, direct.getCacheHits());
+    writer.remove("/two.mp3");
+    EXPECT_EQ(vector<string>({"One"}), direct.listArtists(filter));
+    EXPECT_EQ(1, direct.getCacheHits());
+
+    // Read write stores never cache.
+    writer.setCacheSize(10);
+    EXPECT_EQ(vector<string>({"One"}), writer.listArtists(filter));
+    EXPECT_EQ(vector<string>({"One"}), writer.listArtists(filter));
+    EXPECT_EQ(0, writer.getCacheHits());
+    EXPECT_EQ(0, writer.getCacheMisses());
+
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+}
+
+TEST_F(MediaStoreTest, readerPool) {
+    const string dbname("pool-mediastore.db");
+    const string snapshot = dbname + "-snapshot";
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+
+    {
+        MediaStore writer(dbname, MS_READ_WRITE);
+        vector<MediaFile> files;
+        for (int i = 0; i < 100; i++) {
+            files.push_back(MediaFileBuilder("/music/track" + std::to_string(i) + ".ogg")
+                            .setType(AudioMedia)
+                            .setAuthor("Artist" + std::to_string(i % 10))
+                            .setAlbum("Album" + std::to_string(i % 20)));
+        }
+        writer.insertBatch(files);
+        writer.publishSnapshot();
+
+        MediaStore reader(dbname, MS_READ_ONLY);
+        auto run_queries = [&](int expected) {
+            vector<std::thread> threads;
+            vector<int> failures(8, 0);
+            for (int t = 0; t < 8; t++) {
+                threads.emplace_back([&, t]() {
+                        for (int i = 0; i < 20; i++) {
+                            Filter filter;
+                            if (reader.listSongs(filter).size() != (size_t)expected ||
+                                reader.listArtists(filter).size() != 10 ||
+                                reader.lookup("/music/track" + std::to_string(i) + ".ogg").getAuthor() != "Artist" + std::to_string(i % 10)) {
+                                failures[t]++;
+                            }
+                        }
+                    });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            return std::count(failures.begin(), failures.end(), 0);
+        };
+        EXPECT_EQ(8, run_queries(100));
+
+        // Every pooled connection picks up a new snapshot.
+        writer.insert(MediaFileBuilder("/music/extra.ogg")
+                      .setType(AudioMedia)
+                      .setAuthor("Artist0"));
+        writer.publishSnapshot();
+        EXPECT_EQ(8, run_queries(101));
+    }
+
+    unlink(dbname.c_str());
+    unlink(snapshot.c_str());
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
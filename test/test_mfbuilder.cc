@@ -212,6 +212,46 @@ TEST_F(MFBTest, fallback_album_artist) {
     EXPECT_EQ(mf.getAlbumArtist(), "author");
 }
 
+TEST_F(MFBTest, interned_strings) {
+    std::string artist = "A fairly long artist name";
+    MediaFile a = MediaFileBuilder("a.mp3")
+        .setContentType("audio/mpeg")
+        .setAuthor(artist)
+        .setGenre("Rock");
+    MediaFile b = MediaFileBuilder("b.mp3")
+        .setContentType("audio/mpeg")
+        .setAuthor(artist)
+        .setAlbumArtist("Someone else");
+    // Equal values share storage.
+    EXPECT_EQ(&a.getContentType(), &b.getContentType());
+    EXPECT_EQ(&a.getAuthor(), &b.getAuthor());
+    EXPECT_EQ(&a.getAuthor(), &a.getAlbumArtist());
+    EXPECT_EQ(artist, b.getAuthor());
+    EXPECT_EQ("Someone else", b.getAlbumArtist());
+    EXPECT_EQ("Rock", a.getGenre());
+    EXPECT_EQ("", b.getGenre());
+    EXPECT_NE(a, b);
+    EXPECT_EQ(a, MediaFile(a));
+
+    // Files are built and dropped concurrently by the scanner and
+    // the D-Bus service.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([] {
+                for (int i = 0; i < 10000; i++) {
+                    std::string genre = "Genre " + std::to_string(i % 7);
+                    MediaFile mf = MediaFileBuilder("file.ogg")
+                        .setGenre(genre);
+                    MediaFile copy(mf);
+                    EXPECT_EQ(genre, copy.getGenre());
+                }
+            });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
 TEST_F(MFBTest, faulty_usage) {
     MediaFileBuilder mfb("/foo/bar/baz.mp3");
     MediaFile m1(std::move(mfb));
@@ -84,6 +84,14 @@ TEST_F(SqliteTest, BindText) {
     stmt.finalize();
 }
 
+TEST_F(SqliteTest, BindNull) {
+    Statement stmt(db, "SELECT ? IS NULL");
+    stmt.bindNull(1);
+    EXPECT_EQ(true, stmt.step());
+    EXPECT_EQ(1, stmt.getInt(0));
+    stmt.finalize();
+}
+
 TEST_F(SqliteTest, Insert) {
     Statement create(db, "CREATE TABLE foo (id INT PRIMARY KEY)");
     EXPECT_FALSE(create.step());
@@ -101,6 +109,75 @@ TEST_F(SqliteTest, Insert) {
     select.finalize();
 }
 
+TEST_F(SqliteTest, CachedStatement) {
+    StatementCache cache(db);
+    {
+        Statement stmt(cache, "SELECT ?");
+        stmt.bind(1, 42);
+        EXPECT_EQ(true, stmt.step());
+        EXPECT_EQ(42, stmt.getInt(0));
+    }
+    EXPECT_EQ(1, cache.size());
+    {
+        // The statement is reused with its bindings cleared.
+        Statement stmt(cache, "SELECT ?");
+        EXPECT_EQ(true, stmt.step());
+        EXPECT_EQ(0, stmt.getInt(0));
+        stmt.finalize();
+    }
+    EXPECT_EQ(1, cache.size());
+}
+
+TEST_F(SqliteTest, CachedStatementInUse) {
+    StatementCache cache(db);
+    Statement outer(cache, "SELECT 1 UNION ALL SELECT 2");
+    EXPECT_EQ(true, outer.step());
+    EXPECT_EQ(1, outer.getInt(0));
+    {
+        // Same SQL while the first copy is still active.
+        Statement inner(cache, "SELECT 1 UNION ALL SELECT 2");
+        EXPECT_EQ(true, inner.step());
+        EXPECT_EQ(1, inner.getInt(0));
+    }
+    EXPECT_EQ(true, outer.step());
+    EXPECT_EQ(2, outer.getInt(0));
+    EXPECT_EQ(false, outer.step());
+    outer.finalize();
+    EXPECT_EQ(1, cache.size());
+}
+
+TEST_F(SqliteTest, CachedStatementError) {
+    StatementCache cache(db);
+    EXPECT_THROW(Statement(cache, "SELECT * FROM no_such_table"), std::runtime_error);
+    EXPECT_EQ(0, cache.size());
+}
+
+TEST_F(SqliteTest, CachedStatementEviction) {
+    StatementCache cache(db, 2);
+    Statement active(cache, "SELECT 1");
+    {
+        Statement stmt(cache, "SELECT 2");
+    }
+    {
+        Statement stmt(cache, "SELECT 3");
+    }
+    // "SELECT 2" was evicted, but the active statement was kept.
+    EXPECT_EQ(2, cache.size());
+    {
+        Statement stmt(cache, "SELECT 4");
+    }
+    EXPECT_EQ(2, cache.size());
+    EXPECT_EQ(true, active.step());
+    EXPECT_EQ(1, active.getInt(0));
+    active.finalize();
+
+    // Once released, the old statement can be evicted too.
+    {
+        Statement stmt(cache, "SELECT 5");
+    }
+    EXPECT_EQ(2, cache.size());
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of version 3 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <mediascanner/mozilla/fts3_tokenizer.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+extern "C" void sqlite3Fts3PorterTokenizerModule(
+    sqlite3_tokenizer_module const**ppModule);
+
+using namespace std;
+
+namespace {
+
+// Returns each token as "text|start|end".
+vector<string> tokenize(const string &input, bool fast_path) {
+    const sqlite3_tokenizer_module *module;
+    sqlite3Fts3PorterTokenizerModule(&module);
+    sqlite3_tokenizer *tokenizer;
+    const char *args[] = {"no_ascii_fastpath"};
+    if (module->xCreate(fast_path ? 0 : 1, args, &tokenizer) != SQLITE_OK) {
+        throw runtime_error("Could not create mozporter tokenizer");
+    }
+    tokenizer->pModule = module;
+    sqlite3_tokenizer_cursor *cursor;
+    if (module->xOpen(tokenizer, input.data(), input.size(), &cursor) != SQLITE_OK) {
+        module->xDestroy(tokenizer);
+        throw runtime_error("Could not open tokenizer cursor");
+    }
+    cursor->pTokenizer = tokenizer;
+    vector<string> tokens;
+    const char *token;
+    int length, start, end, position;
+    while (module->xNext(cursor, &token, &length, &start, &end, &position) == SQLITE_OK) {
+        tokens.push_back(string(token, length) + "|" + to_string(start) +
+                         "|" + to_string(end));
+    }
+    module->xClose(cursor);
+    module->xDestroy(tokenizer);
+    return tokens;
+}
+
+}
+
+TEST(TokenizerTest, ascii) {
+    vector<string> expected {"run|0|7", "dog|8|12", "track12|16|23"};
+    EXPECT_EQ(expected, tokenize("Running DOGS, a Track12", true));
+    EXPECT_EQ(expected, tokenize("Running DOGS, a Track12", false));
+
+    // Long words keep their first and last ten characters.
+    expected = {"_abcdefghiqrstuvwxyz|0|27"};
+    EXPECT_EQ(expected, tokenize("_ABCDEFGHIJklmnopQRSTUVWXYZ", true));
+    EXPECT_EQ(expected, tokenize("_ABCDEFGHIJklmnopQRSTUVWXYZ", false));
+
+    // A short final word is kept for prefix queries.
+    expected = {"queen|0|5", "ab|6|8"};
+    EXPECT_EQ(expected, tokenize("Queen AB*", true));
+}
+
+TEST(TokenizerTest, fast_path_matches_general_path) {
+    const vector<string> inputs {
+        "",
+        "   ...   ",
+        "Highway to Hell (Live at Donington 1990) - Remastered",
+        "The_Quick_Brown_Fox_Jumps_Over_The_Lazy_Dog_0123456789_AND_MORE",
+        "Café Motörhead Björk",
+        "ÉCOLE école ÀÉÎÕÜ",
+        "東京事変 Tokyo 京都abc東京",
+        "abc日本語def",
+        "ｻﾞｸﾞ サ゛ザ",
+        "word\xe2\x80\x83space\xe3\x80\x80ideo、comma。stop",
+        "invalid \x80\xff utf-8 \xc3",
+        "Пикник / Sigur Rós",
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_é",
+        "trailing wildcard ab*",
+        "ends with CJK 京*",
+        "@[`{\x7f\t\n mixed ascii punctuation _x_ ",
+    };
+    for (const auto &input : inputs) {
+        EXPECT_EQ(tokenize(input, false), tokenize(input, true)) << input;
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}